@@ -0,0 +1,50 @@
+#pragma once
+
+#include "benchmark.h"
+#include "legacy_word.h"
+#include "word.h"
+#include "address.h"
+
+void BenchmarkWord()
+{
+    constexpr std::size_t iterations = 1 << 24;
+    constexpr std::size_t mask = (1 << 12) - 1;
+
+    const auto raw = benchmark::RandomWords(mask + 1);
+    const std::vector<LegacyWord> legacy(raw.begin(), raw.end());
+    const std::vector<Word> native(raw.begin(), raw.end());
+
+    benchmark::PrintHeader("Word", "byte pair", "uint16_t");
+
+    {
+        LegacyWord l_acc = 0;
+        Word n_acc = 0;
+        benchmark::Compare("operator+=", iterations,
+            [&](std::size_t i) { l_acc += raw[i & mask]; benchmark::DoNotOptimize(l_acc); },
+            [&](std::size_t i) { n_acc += raw[i & mask]; benchmark::DoNotOptimize(n_acc); });
+    }
+
+    benchmark::Compare("operator+", iterations,
+        [&](std::size_t i) { benchmark::DoNotOptimize(legacy[i & mask] + legacy[(i+1) & mask]); },
+        [&](std::size_t i) { benchmark::DoNotOptimize(native[i & mask] + native[(i+1) & mask]); });
+
+    benchmark::Compare("operator*", iterations,
+        [&](std::size_t i) { benchmark::DoNotOptimize(legacy[i & mask] * legacy[(i+1) & mask]); },
+        [&](std::size_t i) { benchmark::DoNotOptimize(native[i & mask] * native[(i+1) & mask]); });
+
+    benchmark::Compare("operator<=>", iterations,
+        [&](std::size_t i) { benchmark::DoNotOptimize(legacy[i & mask] > legacy[(i+1) & mask]); },
+        [&](std::size_t i) { benchmark::DoNotOptimize(native[i & mask] > native[(i+1) & mask]); });
+
+    benchmark::Compare("get_raw", iterations,
+        [&](std::size_t i) { benchmark::DoNotOptimize(legacy[i & mask].get_raw()); },
+        [&](std::size_t i) { benchmark::DoNotOptimize(native[i & mask].get_raw()); });
+
+    {
+        LegacyWord l_ptr = 0;
+        Address n_ptr = 0;
+        benchmark::Compare("address increment", iterations,
+            [&](std::size_t) { ++l_ptr; benchmark::DoNotOptimize(l_ptr); },
+            [&](std::size_t) { ++n_ptr; benchmark::DoNotOptimize(n_ptr); });
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "word.h"
+
+namespace benchmark {
+
+/**
+ * @brief Times f(i) for i in [0, iterations) and returns the average nanoseconds per call.
+ */
+template<typename TFunction>
+double NanosecondsPerCall(std::size_t const iterations, TFunction&& f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for(std::size_t i=0; i < iterations; ++i)
+    {
+        f(i);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations);
+}
+
+/**
+ * @brief Prints how long the same operation takes with a baseline and a candidate implementation.
+ */
+template<typename TBaseline, typename TCandidate>
+void Compare(std::string_view name, std::size_t const iterations, TBaseline&& baseline, TCandidate&& candidate)
+{
+    const double t_baseline = NanosecondsPerCall(iterations, baseline);
+    const double t_candidate = NanosecondsPerCall(iterations, candidate);
+
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << t_baseline << " ns"
+              << std::setw(10) << t_candidate << " ns"
+              << std::setw(9) << std::setprecision(2) << t_baseline / t_candidate << "x\n";
+}
+
+inline void PrintHeader(std::string_view title, std::string_view baseline, std::string_view candidate)
+{
+    std::cout << "\n== " << title << " ==\n";
+    std::cout << std::left << std::setw(24) << "operation" << std::right
+              << std::setw(13) << baseline << std::setw(13) << candidate << std::setw(10) << "speedup" << '\n';
+}
+
+/**
+ * @brief Pseudo-random 15-bit integers, so that the compiler cannot fold the benchmarked operations.
+ */
+inline std::vector<raw_word_t> RandomWords(std::size_t const count)
+{
+    std::mt19937 engine(2022);
+    std::uniform_int_distribution<raw_word_t> distribution(0, 0x7FFF);
+
+    std::vector<raw_word_t> out(count);
+    for(auto& w: out) w = distribution(engine);
+    return out;
+}
+
+/**
+ * @brief Stops the compiler from optimizing away a computed value.
+ */
+template<typename T>
+void DoNotOptimize(T const& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}
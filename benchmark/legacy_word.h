@@ -0,0 +1,90 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <concepts>
+
+#include "word.h"
+
+/**
+ * Word as it was implemented before switching to a native 16-bit integer:
+ * two bytes with manual carry propagation. Kept only as a benchmark baseline.
+ */
+class LegacyWord
+{
+public:
+    enum byte{LO, HI};
+    static constexpr raw_word_t max_word = 0x8000;
+
+    raw_byte_t data[2] = {0, 0};
+
+    constexpr LegacyWord() = default;
+
+    constexpr LegacyWord(std::integral auto in) noexcept
+    {
+        lo() = (in & 0x00FF);
+        hi() = (in >> 8) & 0x00FF;
+    }
+
+    constexpr raw_byte_t& lo() noexcept { return data[LO];};
+    constexpr raw_byte_t& hi() noexcept { return data[HI];};
+
+    constexpr raw_byte_t lo() const noexcept { return data[LO];};
+    constexpr raw_byte_t hi() const noexcept { return data[HI];};
+
+    constexpr raw_word_t to_int() const noexcept
+    {
+        return (static_cast<raw_word_t>(hi()) << 8) | lo();
+    }
+
+    constexpr LegacyWord& operator+=(const raw_word_t jump) noexcept
+    {
+        const raw_byte_t jump_lo = jump & 0x00FF;
+        const raw_byte_t jump_hi = jump >> 8;
+
+        if(lo() > (0x00FF-jump_lo))
+        {
+            hi() += 1;
+        }
+
+        lo() += jump_lo;
+        hi() += jump_hi;
+
+        hi() %= (max_word>>8);
+
+        return *this;
+    }
+
+    constexpr LegacyWord& operator++() noexcept
+    {
+        return (*this) += 1u;
+    }
+
+    constexpr LegacyWord operator+(LegacyWord const& other) const noexcept
+    {
+        return LegacyWord(*this) += other.to_int();
+    }
+
+    constexpr LegacyWord operator*(LegacyWord const& other) const noexcept
+    {
+        return LegacyWord((this->to_int() * other.to_int()) % max_word);
+    }
+
+    constexpr std::strong_ordering operator<=>(LegacyWord const& other) const noexcept
+    {
+        if(this->hi() < other.hi()) return std::strong_ordering::less;
+        if(this->hi() > other.hi()) return std::strong_ordering::greater;
+
+        if(this->lo() < other.lo()) return std::strong_ordering::less;
+        if(this->lo() > other.lo()) return std::strong_ordering::greater;
+
+        return std::strong_ordering::equivalent;
+    }
+
+    constexpr bool operator==(LegacyWord const& other) const noexcept = default;
+
+    constexpr raw_word_t get_raw() const noexcept
+    {
+        return (static_cast<raw_word_t>(lo()) << 8) | hi();
+    }
+};
@@ -0,0 +1,7 @@
+#include "bench_word.h"
+
+int main()
+{
+    BenchmarkWord();
+    return EXIT_SUCCESS;
+}
@@ -48,6 +48,14 @@ ln -s "${PROJECT_DIR}/build/${BUILD_TYPE}/test/run_tests" "${EXECUTABLE}"
 
 echo "Created binary ${EXECUTABLE}"
 
+# Linking benchmarks
+export EXECUTABLE="${PROJECT_DIR}/bin/${BUILD_TYPE}/run_benchmarks"
+
+rm "${EXECUTABLE}"        2> /dev/null
+ln -s "${PROJECT_DIR}/build/${BUILD_TYPE}/benchmark/run_benchmarks" "${EXECUTABLE}"
+
+echo "Created binary ${EXECUTABLE}"
+
 # Linking Assembler
 export EXECUTABLE="${PROJECT_DIR}/bin/${BUILD_TYPE}/assemble"
 
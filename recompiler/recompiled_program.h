@@ -0,0 +1,40 @@
+#pragma once
+
+/**
+ * Support code for programs translated by the static recompiler.
+ * The generated source defines the native translation and includes this header.
+ */
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <utility>
+
+#include "address.h"
+#include "virtual_machine_impl.h" // WriteMemory is inline
+#include "word.h"
+
+/**
+ * @brief Loads the program image and runs its native translation, with the same
+ *        output as the synacor_vm executable.
+ * @param run is the translation. It may hand control over to the interpreter at any point,
+ *        and must leave the state of the virtual machine up to date when it returns.
+ */
+inline int RunRecompiled(std::span<raw_word_t const> const image, void (*run)(VirtualMachine&))
+{
+    auto vm = std::make_unique<VirtualMachine>();
+    vm->LoadMemory(image);
+    vm->Start();
+
+    std::cout << ">> Program output:\n";
+    run(*vm);
+    vm->FlushOutput();
+
+    std::cout << "\n>> VM exit state:\n";
+    vm->Print();
+
+    return EXIT_SUCCESS;
+}
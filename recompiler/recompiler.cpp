@@ -0,0 +1,37 @@
+#include "recompiler.h"
+
+using namespace recompiler;
+
+int main(int argc, char**argv)
+{
+	if(argc != 3)
+	{
+		PrintHelp();
+		exit(EXIT_FAILURE);
+	}
+
+	std::ifstream infile(argv[1], std::ios::binary);
+	if(!infile)
+	{
+		std::cerr << "Failed to open " << argv[1] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Memory memory;
+	Address program_end = 0;
+	memory.load(infile, program_end);
+
+	const ControlFlow flow = AnalyzeControlFlow(memory);
+
+	std::ofstream outfile(argv[2]);
+	Emitter(outfile, memory, flow).EmitProgram(argv[1], program_end.get().to_int());
+
+	if(!outfile)
+	{
+		std::cerr << "Failed to write " << argv[2] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "Recompiled program stored as " << argv[2] << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "decode_cache.h"
+#include "instruction.h"
+#include "virtual_memory.h"
+#include "word.h"
+
+namespace recompiler {
+
+void PrintHelp()
+{
+    std::cout << "SC static recompiler. Usage: \n\n";
+    std::cout << "recompiler INPUT OUTPUT\n\n";
+    std::cout << "Translates the program in INPUT into C++ source, stored in OUTPUT.\n";
+    std::cout << "Link it against synacor_vm_lib to obtain a native executable.\n";
+}
+
+/**
+ * Result of following every statically known control transfer from address 0.
+ */
+struct ControlFlow
+{
+    std::vector<bool> is_instruction = std::vector<bool>(Word::max_word); // An instruction starts at this address
+    std::vector<bool> is_code = std::vector<bool>(Word::max_word);        // Word belongs to some instruction
+    std::vector<bool> is_label = std::vector<bool>(Word::max_word);       // Start of a basic block
+    bool has_dynamic_jumps = false;                                        // Some JMP, JT, JF, CALL takes its target from a register, or there is a RET
+};
+
+constexpr bool IsDynamic(Operand const& target) noexcept
+{
+    return target.type != InstructionData::LITERAL;
+}
+
+/**
+ * @brief Finds the instructions reachable from address 0, and the basic blocks they form.
+ *        Blocks start at literal jump and call targets, and after every call (the return address).
+ *        Targets taken from registers can only be resolved at run time, so they are not followed.
+ */
+ControlFlow AnalyzeControlFlow(Memory const& memory)
+{
+    ControlFlow flow;
+    std::vector<raw_word_t> pending = {0};
+    flow.is_label[0] = true;
+
+    const auto add_target = [&](raw_word_t const target) {
+        flow.is_label[target] = true;
+        pending.push_back(target);
+    };
+
+    while(!pending.empty())
+    {
+        const raw_word_t ptr = pending.back();
+        pending.pop_back();
+        if(flow.is_instruction[ptr]) continue;
+
+        const DecodedInstruction instr = DecodeCache::Decode(memory, ptr);
+        flow.is_instruction[ptr] = true;
+        for(std::size_t i=0; i < instr.length && ptr + i < Word::max_word; ++i)
+        {
+            flow.is_code[ptr + i] = true;
+        }
+
+        const std::size_t next = ptr + instr.length;
+        const bool has_next = next < Word::max_word;
+        if(instr.may_fault)
+        {
+            // Raises an error, left to the interpreter
+            continue;
+        }
+
+        switch(instr.opcode)
+        {
+            case InstructionData::HALT:
+            case InstructionData::WRONG_OPCODE:
+                break;
+            case InstructionData::RET:
+                flow.has_dynamic_jumps = true;
+                break;
+            case InstructionData::JMP:
+                if(IsDynamic(instr.args[0])) flow.has_dynamic_jumps = true;
+                else add_target(instr.args[0].value.to_int());
+                break;
+            case InstructionData::JT:
+            case InstructionData::JF:
+                if(IsDynamic(instr.args[1])) flow.has_dynamic_jumps = true;
+                else add_target(instr.args[1].value.to_int());
+                if(has_next) pending.push_back(static_cast<raw_word_t>(next));
+                break;
+            case InstructionData::CALL:
+                if(IsDynamic(instr.args[0])) flow.has_dynamic_jumps = true;
+                else add_target(instr.args[0].value.to_int());
+                if(has_next) add_target(static_cast<raw_word_t>(next));
+                break;
+            default:
+                if(has_next) pending.push_back(static_cast<raw_word_t>(next));
+                break;
+        }
+    }
+
+    // Instructions not emitted right after the one before them need a label, and so does that one's
+    // fall-through, which is then reached through a goto. They differ when an instruction starts
+    // inside another one.
+    std::size_t expected = 0;
+    for(std::size_t ptr=0; ptr < Word::max_word; ++ptr)
+    {
+        if(!flow.is_instruction[ptr]) continue;
+        if(ptr != expected)
+        {
+            flow.is_label[ptr] = true;
+            if(expected != 0 && expected < Word::max_word && flow.is_instruction[expected]) flow.is_label[expected] = true;
+        }
+        expected = ptr + DecodeCache::Decode(memory, static_cast<raw_word_t>(ptr)).length;
+    }
+
+    return flow;
+}
+
+/**
+ * Writes the C++ translation of a program, one instruction at a time.
+ * Registers are kept in local variables; the virtual machine is only synchronized around
+ * the instructions that it runs on behalf of the native code. The stack is the machine's own.
+ */
+class Emitter
+{
+public:
+    Emitter(std::ostream& os, Memory const& memory, ControlFlow const& flow)
+        : m_os(os), m_memory(memory), m_flow(flow)
+    { }
+
+    void EmitProgram(std::string_view const source_name, std::size_t const program_size)
+    {
+        m_os << "// Generated by the Synacor static recompiler from " << source_name << ". Do not edit.\n";
+        m_os << "#include \"recompiled_program.h\"\n\n";
+        m_os << "#pragma GCC diagnostic ignored \"-Wunused-label\" // Labels are emitted for every basic block\n\n";
+        m_os << "namespace {\n\n";
+
+        EmitTable("raw_word_t", "image", program_size, [&](std::size_t i){ return std::to_string(m_memory[Address(i)].to_int()); });
+        EmitTable("std::uint64_t", "is_code", Word::max_word / 64, [&](std::size_t i){
+            std::uint64_t bits = 0;
+            for(std::size_t j=0; j < 64; ++j) bits |= std::uint64_t{m_flow.is_code[64*i + j]} << j;
+            return std::to_string(bits) + "u";
+        });
+
+        m_os << "void RunNative(VirtualMachine& vm)\n{\n";
+        m_os << "    [[maybe_unused]] Memory const& memory = std::as_const(vm).memory(); // Writes go through write below\n";
+        m_os << "    [[maybe_unused]] CallStack& stack = vm.stack();\n";
+        for(std::size_t i=0; i < InstructionData::num_registers; ++i)
+        {
+            m_os << "    std::uint16_t r" << i << " = vm.registers()[" << i << "].to_int();\n";
+        }
+        m_os << "    [[maybe_unused]] std::uint16_t ip = 0;\n\n";
+        m_os << "    [[maybe_unused]] const auto save = [&]{\n";
+        for(std::size_t i=0; i < InstructionData::num_registers; ++i)
+        {
+            m_os << "        vm.registers()[" << i << "] = r" << i << ";\n";
+        }
+        m_os << "    };\n";
+        m_os << "    [[maybe_unused]] const auto load = [&]{\n";
+        for(std::size_t i=0; i < InstructionData::num_registers; ++i)
+        {
+            m_os << "        r" << i << " = vm.registers()[" << i << "].to_int();\n";
+        }
+        m_os << "    };\n";
+        m_os << "    // Hands the rest of the run over to the interpreter\n";
+        m_os << "    [[maybe_unused]] const auto fallback = [&](std::uint16_t const ptr){\n";
+        m_os << "        save();\n";
+        m_os << "        vm.instr_ptr() = ptr;\n";
+        m_os << "        vm.Resume();\n";
+        m_os << "    };\n";
+        m_os << "    // Lets the interpreter run a single instruction\n";
+        m_os << "    [[maybe_unused]] const auto step = [&](std::uint16_t const ptr){\n";
+        m_os << "        save();\n";
+        m_os << "        vm.instr_ptr() = ptr;\n";
+        m_os << "        vm.Step();\n";
+        m_os << "        load();\n";
+        m_os << "        return vm.IsRunning();\n";
+        m_os << "    };\n";
+        m_os << "    // Writes to code go through the virtual machine. Returns whether code was overwritten\n";
+        m_os << "    [[maybe_unused]] const auto write = [&](std::uint16_t const address, std::uint16_t const value){\n";
+        m_os << "        if(((is_code[address / 64] >> (address % 64)) & 1) == 0)\n";
+        m_os << "        {\n";
+        m_os << "            vm.memory()[Address(address)] = Word(value);\n";
+        m_os << "            return false;\n";
+        m_os << "        }\n";
+        m_os << "        vm.WriteMemory(Address(address), Word(value));\n";
+        m_os << "        return true;\n";
+        m_os << "    };\n\n";
+
+        std::size_t expected = 0;
+        for(std::size_t ptr=0; ptr < Word::max_word; ++ptr)
+        {
+            if(!m_flow.is_instruction[ptr]) continue;
+            if(ptr != expected && expected != 0)
+            {
+                // Previous instruction falls through to an address that is not emitted next
+                EmitGoto(static_cast<raw_word_t>(expected));
+            }
+            expected = EmitInstruction(static_cast<raw_word_t>(ptr));
+        }
+        if(expected != 0) EmitGoto(static_cast<raw_word_t>(expected));
+
+        if(m_flow.has_dynamic_jumps)
+        {
+            m_os << "\ndispatch:\n";
+            m_os << "    switch(ip)\n    {\n";
+            for(std::size_t ptr=0; ptr < Word::max_word; ++ptr)
+            {
+                if(m_flow.is_label[ptr]) m_os << "        case " << ptr << ": goto " << Label(ptr) << ";\n";
+            }
+            m_os << "        default: return fallback(ip); // Not found statically\n";
+            m_os << "    }\n";
+        }
+
+        m_os << "}\n\n";
+        m_os << "}\n\n";
+        m_os << "int main()\n{\n";
+        m_os << "    return RunRecompiled(image, RunNative);\n";
+        m_os << "}\n";
+    }
+
+private:
+    template<typename TValue>
+    void EmitTable(std::string_view const type, std::string_view const name, std::size_t const size, TValue const& value)
+    {
+        m_os << "constexpr std::array<" << type << ", " << size << "> " << name << " = {";
+        for(std::size_t i=0; i < size; ++i)
+        {
+            if(i % 16 == 0) m_os << "\n   ";
+            m_os << ' ' << value(i) << ',';
+        }
+        m_os << "\n};\n\n";
+    }
+
+    static std::string Label(std::size_t const ptr)
+    {
+        std::string label = "a";
+        label += std::to_string(ptr);
+        return label;
+    }
+
+    static std::string Value(Operand const& arg)
+    {
+        if(arg.type != InstructionData::REGISTER) return std::to_string(arg.value.to_int());
+        std::string name = "r";
+        name += std::to_string(arg.value.to_int());
+        return name;
+    }
+
+    void EmitGoto(raw_word_t const ptr)
+    {
+        if(ptr >= Word::max_word) m_os << "    return fallback(" << ptr % Word::max_word << ");\n";
+        else                      m_os << "    goto " << Label(ptr) << ";\n";
+    }
+
+    /**
+     * @brief Emits a check that the operand is a valid address. Otherwise the instruction
+     *        at ip is left to the interpreter, which raises the error.
+     */
+    void EmitAddressCheck(Operand const& arg, raw_word_t const ip)
+    {
+        if(arg.type != InstructionData::REGISTER) return;
+        m_os << "    if(" << Value(arg) << " >= " << Word::max_word << ") return fallback(" << ip << ");\n";
+    }
+
+    void EmitStackCheck(raw_word_t const ip)
+    {
+        m_os << "    if(stack.empty()) return fallback(" << ip << "); // Stack underflow\n";
+    }
+
+    /**
+     * @brief Emits a push. Pushing onto a full stack is left to the interpreter, which raises the error.
+     */
+    void EmitPush(std::string const& value, raw_word_t const ip)
+    {
+        m_os << "    if(!stack.Push(Word(static_cast<raw_word_t>(" << value << ")))) return fallback(" << ip << ");\n";
+    }
+
+    void EmitDynamicJump(Operand const& target, raw_word_t const ip)
+    {
+        EmitAddressCheck(target, ip);
+        m_os << "    ip = " << Value(target) << ";\n";
+        m_os << "    goto dispatch;\n";
+    }
+
+    /**
+     * @brief Emits the instruction at ip.
+     * @returns the address the instruction falls through to, zero if it never does
+     */
+    std::size_t EmitInstruction(raw_word_t const ip)
+    {
+        const DecodedInstruction instr = DecodeCache::Decode(m_memory, ip);
+        const std::size_t next = ip + instr.length;
+        auto const& args = instr.args;
+
+        if(m_flow.is_label[ip]) m_os << Label(ip) << ":\n";
+        m_os << "    // " << ip << ": " << InstructionData::InstructionName(instr.opcode) << '\n';
+
+        if(instr.may_fault)
+        {
+            m_os << "    return fallback(" << ip << ");\n";
+            return 0;
+        }
+
+        switch(instr.opcode)
+        {
+            case InstructionData::HALT:
+            case InstructionData::WRONG_OPCODE:
+            case InstructionData::NATIVE_HOOK:
+                m_os << "    return fallback(" << ip << ");\n";
+                return 0;
+
+            case InstructionData::SET:
+                m_os << "    " << Value(args[0]) << " = " << Value(args[1]) << ";\n";
+                return next;
+
+            case InstructionData::ADD:
+                m_os << "    " << Value(args[0]) << " = (" << Value(args[1]) << " + " << Value(args[2]) << ") % " << Word::max_word << ";\n";
+                return next;
+
+            case InstructionData::MULT:
+                m_os << "    " << Value(args[0]) << " = static_cast<std::uint16_t>((std::uint32_t{" << Value(args[1]) << "} * "
+                     << Value(args[2]) << ") % " << Word::max_word << ");\n";
+                return next;
+
+            case InstructionData::MOD:
+                if(args[2].type == InstructionData::LITERAL && args[2].value.is_zero())
+                {
+                    m_os << "    return fallback(" << ip << "); // Division by zero\n";
+                    return 0;
+                }
+                if(args[2].type == InstructionData::REGISTER)
+                {
+                    m_os << "    if(" << Value(args[2]) << " == 0) return fallback(" << ip << "); // Division by zero\n";
+                }
+                m_os << "    " << Value(args[0]) << " = " << Value(args[1]) << " % " << Value(args[2]) << ";\n";
+                return next;
+
+            case InstructionData::AND:
+                m_os << "    " << Value(args[0]) << " = " << Value(args[1]) << " & " << Value(args[2]) << ";\n";
+                return next;
+
+            case InstructionData::OR:
+                m_os << "    " << Value(args[0]) << " = " << Value(args[1]) << " | " << Value(args[2]) << ";\n";
+                return next;
+
+            case InstructionData::NOT:
+                m_os << "    " << Value(args[0]) << " = ~" << Value(args[1]) << " & " << Word::max_word - 1 << ";\n";
+                return next;
+
+            case InstructionData::EQ:
+                m_os << "    " << Value(args[0]) << " = " << Value(args[1]) << " == " << Value(args[2]) << ";\n";
+                return next;
+
+            case InstructionData::GT:
+                m_os << "    " << Value(args[0]) << " = " << Value(args[1]) << " > " << Value(args[2]) << ";\n";
+                return next;
+
+            case InstructionData::RMEM:
+                EmitAddressCheck(args[1], ip);
+                m_os << "    " << Value(args[0]) << " = memory[Address(" << Value(args[1]) << ")].to_int();\n";
+                return next;
+
+            case InstructionData::WMEM:
+                EmitAddressCheck(args[0], ip);
+                m_os << "    if(write(" << Value(args[0]) << ", " << Value(args[1]) << ")) return fallback(" << next % Word::max_word << ");\n";
+                return next;
+
+            case InstructionData::PUSH:
+                EmitPush(Value(args[0]), ip);
+                return next;
+
+            case InstructionData::POP:
+                EmitStackCheck(ip);
+                m_os << "    " << Value(args[0]) << " = stack.Pop().to_int();\n";
+                return next;
+
+            case InstructionData::JMP:
+                if(IsDynamic(args[0])) EmitDynamicJump(args[0], ip);
+                else EmitGoto(args[0].value.to_int());
+                return 0;
+
+            case InstructionData::JT:
+            case InstructionData::JF:
+            {
+                const char* const condition = instr.opcode == InstructionData::JT ? "!= 0" : "== 0";
+                if(!IsDynamic(args[1]))
+                {
+                    m_os << "    if(" << Value(args[0]) << " " << condition << ") goto " << Label(args[1].value.to_int()) << ";\n";
+                    return next;
+                }
+                m_os << "    if(" << Value(args[0]) << " " << condition << ")\n";
+                m_os << "    {\n";
+                EmitAddressCheck(args[1], ip);
+                m_os << "        ip = " << Value(args[1]) << ";\n";
+                m_os << "        goto dispatch;\n";
+                m_os << "    }\n";
+                return next;
+            }
+
+            case InstructionData::CALL:
+            {
+                EmitAddressCheck(args[0], ip);
+                const std::string target = IsDynamic(args[0]) ? Value(args[0]) : std::to_string(args[0].value.to_int());
+                EmitPush(std::to_string(next % Word::max_word), ip);
+                if(IsDynamic(args[0])) m_os << "    ip = " << target << ";\n    goto dispatch;\n";
+                else                   m_os << "    goto " << Label(args[0].value.to_int()) << ";\n";
+                return 0;
+            }
+
+            case InstructionData::RET:
+                EmitStackCheck(ip);
+                m_os << "    ip = stack.top().to_int();\n";
+                m_os << "    if(ip >= " << Word::max_word << ") return fallback(" << ip << ");\n";
+                m_os << "    stack.Pop();\n";
+                m_os << "    goto dispatch;\n";
+                return 0;
+
+            case InstructionData::OUT:
+            case InstructionData::IN:
+                m_os << "    if(!step(" << ip << ")) return;\n";
+                return next;
+
+            case InstructionData::NOOP:
+                return next;
+        }
+
+        return next;
+    }
+
+    std::ostream& m_os;
+    Memory const& m_memory;
+    ControlFlow const& m_flow;
+};
+
+}
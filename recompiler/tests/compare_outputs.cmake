@@ -0,0 +1,11 @@
+# Runs PROGRAM through the recompiled executable NATIVE and the interpreter INTERPRETER,
+# and fails unless both print the same output and exit state
+execute_process(COMMAND ${NATIVE} OUTPUT_VARIABLE native_output RESULT_VARIABLE native_result)
+execute_process(COMMAND ${INTERPRETER} ${PROGRAM} OUTPUT_VARIABLE interpreter_output RESULT_VARIABLE interpreter_result)
+
+if(NOT native_output STREQUAL interpreter_output)
+    message(FATAL_ERROR "Recompiled program:\n${native_output}\nInterpreter:\n${interpreter_output}")
+endif()
+if(NOT native_result STREQUAL interpreter_result)
+    message(FATAL_ERROR "Recompiled program exited with ${native_result}, the interpreter with ${interpreter_result}")
+endif()
@@ -0,0 +1,24 @@
+;
+;   Jumps through registers and returns. 14 is a known block, reached through the switch
+;   over blocks; 24 is only reached through a register, so the recompiled program hands
+;   the rest of the run over to the interpreter there. Must print CKU.
+;
+call 30             ; 0:  returns through the switch
+jt 0 14             ; 2:  never taken, makes 14 a known block
+set ra 14           ; 5
+jmp ra              ; 8:  to the known block at 14
+out 88              ; 10: 'X', skipped
+halt                ; 12
+noop                ; 13
+out 75              ; 14: 'K'
+set rb 24           ; 16
+jmp rb              ; 19: to 24, not found statically
+halt                ; 21
+halt                ; 22
+halt                ; 23
+out 85              ; 24: 'U'
+out 10              ; 26: '\n'
+halt                ; 28
+noop                ; 29
+out 67              ; 30: 'C'
+ret                 ; 32
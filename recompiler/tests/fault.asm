@@ -0,0 +1,15 @@
+;
+;   Runs natively until popping an empty stack, which stops the machine with an error.
+;   Registers, stack and flags must then be the same as in the interpreter.
+;
+set ra 5            ; ra = 5
+push ra
+push 7
+pop rb              ; rb = 7
+mult rc ra rb       ; rc = 35
+pop rd              ; rd = 5
+out 70              ; 'F'
+out 10              ; '\n'
+pop re              ; empty stack: fault
+out 88              ; 'X', not reached
+halt
@@ -0,0 +1,7 @@
+;
+;   Jumps into the middle of an instruction, so that two instructions overlap. The one at 2
+;   falls through to 4, which is then no longer emitted right after it.
+;
+jmp 2               ; 0
+out 0               ; 2:  the operand at 3 is also a halt
+jmp 3               ; 4:  to the halt inside the out
@@ -0,0 +1,13 @@
+;
+;   Writes to data and to its own code. The recompiled program hands the rest of the run
+;   over to the interpreter once code is overwritten, and must print ACB.
+;
+out 65              ; 0:  'A'
+wmem 100 67         ; 2:  'C' to data, written natively
+rmem rb 100         ; 5
+out rb              ; 8:  'C'
+wmem 17 66          ; 10: 'B' over the operand of the out at 16
+set ra 7            ; 13
+out 90              ; 16: 'Z', or 'B' once overwritten
+out 10              ; 18: '\n'
+halt                ; 20
@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "machine_task.h"
+#include "output_sink.h"
+#include "virtual_machine.h"
+
+void Help()
+{
+    std::cout << "          SYNACOR CHALLENGE SERVER\n";
+    std::cout << "Listens on a Unix domain socket and runs a separate machine for every connection,\n";
+    std::cout << "all of them starting from the same program. Lines received are the machine's input.\n";
+    std::cout << "Usage: synacor_server [options] SOCKET PROGRAM\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --threads N  Number of worker threads (default: one per core)\n";
+    std::cout << "\nStops on SIGINT or SIGTERM, and removes the socket file.\n";
+    std::cout << std::endl;
+}
+
+/**
+ * One connection and its machine.
+ *
+ * The machine, its task and unsent output belong to whichever worker has the session scheduled,
+ * and only one ever has. The epoll thread appends received bytes to input, and is the only one
+ * to close the socket. Everything shared between the two is guarded by the mutex.
+ */
+struct Session
+{
+    static constexpr std::size_t max_input = 1 << 16; // Received bytes without a newline before the client is dropped
+
+    Session(int const socket, VirtualMachine&& machine, std::string_view const greeting)
+        : fd(socket)
+        , vm(std::move(machine))
+        , unsent(greeting)
+    {
+        vm.SetOutput(output);
+        task.emplace(vm.ResumeAsync()); // Suspends straight away, at the IN the program was left at
+    }
+
+    int const fd;
+    VirtualMachine vm;
+    CaptureSink output;
+    std::optional<MachineTask> task;
+    std::string unsent;
+
+    std::mutex mutex;
+    std::string input;          // Received, not handed over to the machine yet
+    bool input_ended = false;   // The client will not send anything else
+    bool scheduled = false;     // Queued or being served by a worker
+    bool again = false;         // Something happened while being served
+    bool writing = false;       // Waiting for the socket to accept more output
+    bool finished = false;      // Shut down, waiting for the epoll thread to close it
+    bool closed = false;
+};
+
+/**
+ * Fixed pool of threads serving sessions that have something to do, one at a time each.
+ */
+class Server
+{
+public:
+    Server(int const listen_fd, int const signal_fd, VirtualMachine const& base, std::string greeting, unsigned const num_threads)
+        : m_listen_fd(listen_fd)
+        , m_signal_fd(signal_fd)
+        , m_epoll_fd(epoll_create1(EPOLL_CLOEXEC))
+        , m_base(base)
+        , m_greeting(std::move(greeting))
+    {
+        Watch(m_listen_fd);
+        Watch(m_signal_fd);
+        for(unsigned i=0; i < num_threads; ++i) m_workers.emplace_back(&Server::Work, this);
+    }
+
+    ~Server()
+    {
+        {
+            std::lock_guard lock(m_queue_mutex);
+            m_stop = true;
+        }
+        m_queue_changed.notify_all();
+        for(std::thread& worker: m_workers) worker.join();
+        for(auto& [fd, session]: m_sessions) close(fd);
+        close(m_epoll_fd);
+    }
+
+    /**
+     * @brief Accepts connections and reads from them until signalled.
+     */
+    void Run()
+    {
+        std::vector<epoll_event> events(256);
+        while(true)
+        {
+            const int count = epoll_wait(m_epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+            if(count < 0)
+            {
+                if(errno == EINTR) continue;
+                std::cerr << "epoll_wait: " << std::strerror(errno) << std::endl;
+                return;
+            }
+
+            for(epoll_event const& event: std::span(events.data(), static_cast<std::size_t>(count)))
+            {
+                if(event.data.ptr == &m_signal_fd) return;
+                if(event.data.ptr == &m_listen_fd) Accept();
+                else OnEvent(*static_cast<Session*>(event.data.ptr), event.events);
+            }
+        }
+    }
+
+private:
+    void Watch(int const& fd)
+    {
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.ptr = const_cast<int*>(&fd);
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void Accept()
+    {
+        while(true)
+        {
+            const int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd < 0) return;
+
+            auto session = std::make_shared<Session>(fd, m_base.Fork(), m_greeting);
+            epoll_event event {};
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.ptr = session.get();
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            m_sessions.emplace(fd, session);
+            Schedule(std::move(session)); // To send the greeting
+        }
+    }
+
+    void OnEvent(Session& session, std::uint32_t const events)
+    {
+        std::unique_lock lock(session.mutex);
+
+        if(session.finished && (events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP | EPOLLIN)))
+        {
+            // The worker is done with it, and the client has seen the end of the output
+            session.closed = true;
+            close(session.fd);
+            lock.unlock();
+            m_sessions.erase(session.fd); // May destroy the session
+            return;
+        }
+
+        if(events & EPOLLOUT)
+        {
+            session.writing = false;
+            UpdateEvents(session);
+        }
+
+        if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            char chunk[4096];
+            while(!session.input_ended)
+            {
+                const ssize_t count = read(session.fd, chunk, sizeof(chunk));
+                if(count > 0)
+                {
+                    session.input.append(chunk, static_cast<std::size_t>(count));
+                    if(session.input.size() > Session::max_input && session.input.find('\n') == std::string::npos) session.input_ended = true;
+                }
+                else if(count < 0 && (errno == EAGAIN || errno == EINTR)) break;
+                else
+                {
+                    if(!session.input.empty() && !session.input.ends_with('\n')) session.input += '\n'; // Last line
+                    session.input_ended = true;
+                }
+            }
+            if(session.input_ended) UpdateEvents(session);
+        }
+
+        lock.unlock();
+        Schedule(m_sessions.at(session.fd));
+    }
+
+    /**
+     * @brief Watches the socket for what the session is waiting for. Called with the session locked.
+     *        Once input has ended, the hang-up would be reported over and over while a worker is busy
+     *        with the session, so events are only reported once, until the next call.
+     */
+    void UpdateEvents(Session& session)
+    {
+        epoll_event event {};
+        event.events = session.input_ended ? std::uint32_t{EPOLLONESHOT} : std::uint32_t{EPOLLIN | EPOLLRDHUP};
+        if(session.writing) event.events |= EPOLLOUT;
+        event.data.ptr = &session;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, session.fd, &event);
+    }
+
+    void Schedule(std::shared_ptr<Session> session)
+    {
+        {
+            std::lock_guard lock(session->mutex);
+            if(session->scheduled)
+            {
+                session->again = true;
+                return;
+            }
+            session->scheduled = true;
+        }
+        {
+            std::lock_guard lock(m_queue_mutex);
+            m_queue.push_back(std::move(session));
+        }
+        m_queue_changed.notify_one();
+    }
+
+    void Work()
+    {
+        while(true)
+        {
+            std::shared_ptr<Session> session;
+            {
+                std::unique_lock lock(m_queue_mutex);
+                m_queue_changed.wait(lock, [&] { return m_stop || !m_queue.empty(); });
+                if(m_stop) return;
+                session = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            Serve(*session);
+        }
+    }
+
+    /**
+     * @brief Hands every complete line received so far to the machine, and sends what it prints.
+     */
+    void Serve(Session& session)
+    {
+        while(true)
+        {
+            std::string lines;
+            bool input_ended;
+            {
+                std::lock_guard lock(session.mutex);
+                const std::size_t end = session.input.rfind('\n');
+                if(end != std::string::npos)
+                {
+                    lines = session.input.substr(0, end + 1);
+                    session.input.erase(0, end + 1);
+                }
+                input_ended = session.input_ended;
+            }
+
+            std::string_view remaining = lines;
+            while(!remaining.empty() && !session.task->done())
+            {
+                const std::size_t end = remaining.find('\n');
+                std::string_view line = remaining.substr(0, end);
+                remaining.remove_prefix(end + 1);
+                if(line.ends_with('\r')) line.remove_suffix(1); // From telnet-like clients
+                session.vm.ProvideInput(line);
+                session.task->resume();
+            }
+            session.vm.FlushOutput();
+            session.unsent += session.output.text();
+            session.output.Clear();
+
+            std::lock_guard lock(session.mutex);
+            if(session.closed) return; // Scheduled = true keeps anybody else away from it
+
+            if(!session.writing) Send(session);
+            if(!session.finished && session.unsent.empty() && (session.task->done() || input_ended))
+            {
+                session.finished = true;
+                shutdown(session.fd, SHUT_RDWR); // Lets the epoll thread know, through EPOLLHUP
+                UpdateEvents(session);
+            }
+
+            if(session.again)
+            {
+                session.again = false;
+                continue;
+            }
+            session.scheduled = false;
+            return;
+        }
+    }
+
+    /**
+     * @brief Writes as much unsent output as the socket takes. Called with the session locked.
+     */
+    void Send(Session& session)
+    {
+        while(!session.unsent.empty())
+        {
+            const ssize_t count = send(session.fd, session.unsent.data(), session.unsent.size(), MSG_NOSIGNAL);
+            if(count > 0)
+            {
+                session.unsent.erase(0, static_cast<std::size_t>(count));
+                continue;
+            }
+            if(count < 0 && errno == EINTR) continue;
+            if(count < 0 && errno == EAGAIN)
+            {
+                session.writing = true;
+                UpdateEvents(session);
+                return;
+            }
+            session.unsent.clear(); // The client is gone
+            session.input_ended = true;
+        }
+    }
+
+    int const m_listen_fd;
+    int const m_signal_fd;
+    int const m_epoll_fd;
+    VirtualMachine const& m_base;
+    std::string const m_greeting;
+
+    std::unordered_map<int, std::shared_ptr<Session>> m_sessions; // Only touched by the epoll thread
+
+    std::mutex m_queue_mutex;
+    std::condition_variable m_queue_changed;
+    std::deque<std::shared_ptr<Session>> m_queue;
+    bool m_stop = false;
+    std::vector<std::thread> m_workers;
+};
+
+int main(int argc, char * argv[])
+{
+    unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<char const*> positional;
+    for(int i=1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if(arg == "--threads" && i + 1 < argc) num_threads = std::max(1, std::atoi(argv[++i]));
+        else positional.push_back(argv[i]);
+    }
+    if(positional.size() != 2)
+    {
+        Help();
+        return positional.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    char const * const socket_path = positional[0];
+    char const * const program_path = positional[1];
+
+    // Every session starts from the program as it stands at its first IN
+    VirtualMachine base;
+    auto program = VirtualMachine::program_file_t(program_path, std::ios::binary);
+    if(!program)
+    {
+        std::cerr << "Failed to open " << program_path << std::endl;
+        return EXIT_FAILURE;
+    }
+    base.LoadMemory(program);
+    CaptureSink greeting;
+    base.SetOutput(greeting);
+    base.Start();
+    base.PauseOnInput(true);
+    base.ResumeThreaded();
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if(std::strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        std::cerr << "Socket path too long: " << socket_path << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::strcpy(address.sun_path, socket_path);
+    unlink(socket_path);
+
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listen_fd < 0
+        || bind(listen_fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0
+        || listen(listen_fd, SOMAXCONN) != 0)
+    {
+        std::cerr << "Failed to listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Handled through epoll, so that the workers are never interrupted
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    const int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+
+    {
+        Server server(listen_fd, signal_fd, base, std::string(greeting.text()), num_threads);
+        std::cerr << "Listening on " << socket_path << " with " << num_threads << " threads" << std::endl;
+        server.Run();
+    }
+
+    close(signal_fd);
+    close(listen_fd);
+    unlink(socket_path);
+    return EXIT_SUCCESS;
+}
@@ -13,9 +13,8 @@ public:
     constexpr Address() noexcept = default;
 
     constexpr Address(raw_byte_t in) noexcept
-    {
-        m_internal.lo() = in;
-    }
+        : m_internal(in)
+    { }
 
     constexpr explicit Address(Word const& word) noexcept
     {
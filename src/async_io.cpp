@@ -0,0 +1,135 @@
+#include "async_io.h"
+
+#if SYNACOR_ASYNC_IO_AVAILABLE
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <system_error>
+#include <unistd.h>
+
+AsyncIo::AsyncIo(int const input_fd, int const output_fd, std::size_t const ring_size)
+    : m_input_fd(input_fd)
+    , m_output_fd(output_fd)
+    , m_input(ring_size)
+    , m_output(ring_size)
+    , m_input_buffer(*this)
+    , m_input_stream(&m_input_buffer)
+    , m_output_sink(*this)
+{
+    if(pipe(m_wake_fds) != 0) throw std::system_error(errno, std::generic_category(), "pipe");
+    for(int const fd: m_wake_fds) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    m_thread = std::thread(&AsyncIo::Loop, this);
+}
+
+AsyncIo::~AsyncIo()
+{
+    m_output_sink.Flush();
+    m_stop.store(true, std::memory_order_release);
+    Wake();
+    m_thread.join();
+    close(m_wake_fds[0]);
+    close(m_wake_fds[1]);
+}
+
+void AsyncIo::Sync()
+{
+    m_output_sink.Flush();
+    m_output.WaitForSpace(true);
+}
+
+void AsyncIo::Wake() noexcept
+{
+    if(m_wake_pending.exchange(true, std::memory_order_acq_rel)) return;
+    const char byte = 0;
+    [[maybe_unused]] const ssize_t written = write(m_wake_fds[1], &byte, 1);
+}
+
+AsyncIo::InputBuffer::int_type AsyncIo::InputBuffer::underflow()
+{
+    if(gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    SpscRing& ring = m_io.m_input;
+    while(true)
+    {
+        const bool was_full = ring.full();
+        const std::size_t count = ring.Pop(m_buffer);
+        if(count != 0)
+        {
+            if(was_full) m_io.Wake(); // The I/O thread stops reading while there is no room
+            setg(m_buffer.data(), m_buffer.data(), m_buffer.data() + count);
+            return traits_type::to_int_type(m_buffer[0]);
+        }
+        if(ring.closed() && ring.empty()) return traits_type::eof();
+        ring.WaitForData();
+    }
+}
+
+void AsyncIo::RingSink::Write(std::string_view text)
+{
+    SpscRing& ring = m_io.m_output;
+    while(true)
+    {
+        text.remove_prefix(ring.Push(text));
+        m_io.Wake();
+        if(text.empty()) return;
+        ring.WaitForSpace();
+    }
+}
+
+void AsyncIo::Loop()
+{
+    std::array<char, 4096> chunk;
+
+    while(true)
+    {
+        const bool stop = m_stop.load(std::memory_order_acquire);
+        const bool want_input = !stop && !m_input.closed() && !m_input.full();
+        const bool want_output = !m_output.empty();
+        if(stop && !want_output) break;
+
+        std::array<pollfd, 3> fds {};
+        std::size_t num_fds = 0;
+        fds[num_fds++] = {m_wake_fds[0], POLLIN, 0};
+        const std::size_t input_index = want_input ? num_fds++ : fds.size();
+        const std::size_t output_index = want_output ? num_fds++ : fds.size();
+        if(want_input) fds[input_index] = {m_input_fd, POLLIN, 0};
+        if(want_output) fds[output_index] = {m_output_fd, POLLOUT, 0};
+
+        if(poll(fds.data(), num_fds, -1) < 0)
+        {
+            if(errno == EINTR) continue;
+            break;
+        }
+
+        if(fds[0].revents != 0)
+        {
+            // Drained before the flag is cleared: a Wake in between finds it still set and writes
+            // nothing, and what it woke up for is seen on the next iteration. The exchange reads
+            // the flag from the latest Wake, which makes that visible.
+            while(read(m_wake_fds[0], chunk.data(), chunk.size()) > 0) {}
+            m_wake_pending.exchange(false, std::memory_order_acq_rel);
+        }
+
+        if(want_input && fds[input_index].revents != 0)
+        {
+            const std::size_t room = std::min(chunk.size(), m_input.capacity() - m_input.size());
+            const ssize_t count = read(m_input_fd, chunk.data(), room);
+            if(count > 0) m_input.Push(std::string_view(chunk.data(), static_cast<std::size_t>(count)));
+            else if(count == 0 || (errno != EINTR && errno != EAGAIN)) m_input.Close();
+        }
+
+        if(want_output && fds[output_index].revents != 0)
+        {
+            const std::span<char const> pending = m_output.Readable();
+            const ssize_t count = write(m_output_fd, pending.data(), pending.size());
+            if(count > 0) m_output.Consume(static_cast<std::size_t>(count));
+            else if(count == 0 || (errno != EINTR && errno != EAGAIN)) m_output.Consume(pending.size()); // Nowhere to write it
+        }
+    }
+
+    m_input.Close();
+}
+
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+#include <string_view>
+#include <thread>
+
+#include "output_sink.h"
+#include "spsc_ring.h"
+
+#if defined(__unix__)
+#define SYNACOR_ASYNC_IO_AVAILABLE 1
+#else
+#define SYNACOR_ASYNC_IO_AVAILABLE 0
+#endif
+
+#if SYNACOR_ASYNC_IO_AVAILABLE
+
+/**
+ * Moves input and output between file descriptors and the thread running a virtual machine
+ * on a dedicated thread, so that a slow terminal or pipe on either end never stalls the
+ * interpreter. Bytes cross over through one SpscRing per direction.
+ *
+ * The machine thread blocks only when IN finds the input ring empty, or in the unlikely case
+ * that the output ring is full. The I/O thread sleeps in poll(), and is woken up through a
+ * pipe when there is new output or room for more input.
+ */
+class AsyncIo
+{
+public:
+    static constexpr std::size_t default_ring_size = 1 << 20;
+
+    AsyncIo(int input_fd, int output_fd, std::size_t ring_size = default_ring_size);
+
+    /**
+     * @brief Writes out the remaining output, then stops the I/O thread.
+     */
+    ~AsyncIo();
+
+    AsyncIo(AsyncIo const&) = delete;
+    AsyncIo& operator=(AsyncIo const&) = delete;
+
+    /**
+     * @brief Stream to hand over to VirtualMachine::SetInput.
+     */
+    std::istream& input() noexcept { return m_input_stream; }
+
+    /**
+     * @brief Sink to hand over to VirtualMachine::SetOutput.
+     */
+    OutputSink& output() noexcept { return m_output_sink; }
+
+    /**
+     * @brief Flushes the output sink and blocks until the I/O thread has written everything,
+     *        so that the caller can write to the same file descriptor without reordering.
+     */
+    void Sync();
+
+private:
+    class InputBuffer final : public std::streambuf
+    {
+    public:
+        explicit InputBuffer(AsyncIo& io) noexcept : m_io(io) {}
+
+    protected:
+        int_type underflow() override;
+
+    private:
+        AsyncIo& m_io;
+        std::array<char, 4096> m_buffer;
+    };
+
+    class RingSink final : public OutputSink
+    {
+    public:
+        explicit RingSink(AsyncIo& io) noexcept : m_io(io) {}
+        ~RingSink() override { Flush(); }
+
+    protected:
+        void Write(std::string_view text) override;
+
+    private:
+        AsyncIo& m_io;
+    };
+
+    void Wake() noexcept;
+    void Loop();
+
+    int m_input_fd;
+    int m_output_fd;
+    int m_wake_fds[2];                         // Pipe that the I/O thread polls besides the file descriptors
+    std::atomic<bool> m_wake_pending = false;  // Whether a byte is in the pipe already
+    std::atomic<bool> m_stop = false;
+
+    SpscRing m_input;  // Produced by the I/O thread
+    SpscRing m_output; // Consumed by the I/O thread
+    InputBuffer m_input_buffer;
+    std::istream m_input_stream;
+    RingSink m_output_sink;
+
+    std::thread m_thread; // Last, so that it starts once everything else is ready
+};
+
+#endif
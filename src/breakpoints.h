@@ -0,0 +1,129 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <span>
+
+#include "instruction.h"
+#include "word.h"
+
+/**
+ * Addresses at which BasicVirtualMachine::ResumeUntilBreakpoint stops, each optionally
+ * guarded by a condition on a register.
+ *
+ * Besides the bitmap of addresses, it caches which blocks of straight-line code contain a
+ * breakpoint, keyed by the address they were entered at, so that the machine checks the
+ * bitmap once per block instead of once per instruction. The cache is dropped whenever
+ * breakpoints change, or the program writes to code that was scanned.
+ */
+class Breakpoints
+{
+public:
+    struct Condition
+    {
+        enum Comparison { EQUAL, NOT_EQUAL, LESS, GREATER, LESS_EQUAL, GREATER_EQUAL };
+
+        std::size_t reg;
+        Comparison comparison;
+        raw_word_t value;
+
+        constexpr bool Holds(std::span<Word const, InstructionData::num_registers> const registers) const noexcept
+        {
+            const raw_word_t actual = registers[reg].to_int();
+            switch(comparison)
+            {
+                case EQUAL:         return actual == value;
+                case NOT_EQUAL:     return actual != value;
+                case LESS:          return actual < value;
+                case GREATER:       return actual > value;
+                case LESS_EQUAL:    return actual <= value;
+                case GREATER_EQUAL: return actual >= value;
+            }
+            return false;
+        }
+    };
+
+    /**
+     * @brief Sets a breakpoint, replacing any other at the same address.
+     */
+    void Set(raw_word_t const address, std::optional<Condition> const condition = std::nullopt)
+    {
+        m_addresses.set(address);
+        m_conditions[address] = condition;
+        ForgetBlocks();
+    }
+
+    /**
+     * @returns whether there was a breakpoint at the address
+     */
+    bool Remove(raw_word_t const address)
+    {
+        if(!m_addresses.test(address)) return false;
+        m_addresses.reset(address);
+        m_conditions.erase(address);
+        ForgetBlocks();
+        return true;
+    }
+
+    bool empty() const noexcept { return m_conditions.empty(); }
+    bool Has(raw_word_t const address) const noexcept { return m_addresses.test(address); }
+
+    /**
+     * @brief Every breakpoint, by address.
+     */
+    std::map<raw_word_t, std::optional<Condition>> const& all() const noexcept { return m_conditions; }
+
+    /**
+     * @brief Whether the machine should stop before running the instruction at the address.
+     */
+    bool ShouldStop(raw_word_t const address, std::span<Word const, InstructionData::num_registers> const registers) const
+    {
+        if(!m_addresses.test(address)) return false;
+        std::optional<Condition> const& condition = m_conditions.find(address)->second;
+        return !condition || condition->Holds(registers);
+    }
+
+    /**
+     * @brief Whether the block entered at the address was scanned, and if so whether it contains a breakpoint.
+     */
+    std::optional<bool> CachedBlock(raw_word_t const entry) const noexcept
+    {
+        if(!m_scanned_blocks.test(entry)) return std::nullopt;
+        return m_blocks_with_breakpoints.test(entry);
+    }
+
+    /**
+     * @param end is one past the last word of the block
+     */
+    void CacheBlock(raw_word_t const entry, std::size_t const end, bool const has_breakpoint) noexcept
+    {
+        m_scanned_blocks.set(entry);
+        m_blocks_with_breakpoints.set(entry, has_breakpoint);
+        for(std::size_t address = entry; address < end; ++address) m_scanned_code.set(address);
+    }
+
+    /**
+     * @brief Drops the blocks cached so far if the address is part of one, once the program has written to it.
+     */
+    void OnWrite(raw_word_t const address) noexcept
+    {
+        if(m_scanned_code.test(address)) ForgetBlocks();
+    }
+
+private:
+    void ForgetBlocks() noexcept
+    {
+        m_scanned_blocks.reset();
+        m_blocks_with_breakpoints.reset();
+        m_scanned_code.reset();
+    }
+
+    std::bitset<Word::max_word> m_addresses;
+    std::map<raw_word_t, std::optional<Condition>> m_conditions;
+
+    std::bitset<Word::max_word> m_scanned_blocks;          // By entry address
+    std::bitset<Word::max_word> m_blocks_with_breakpoints; // By entry address
+    std::bitset<Word::max_word> m_scanned_code;            // Every word of the scanned blocks
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "word.h"
+
+/**
+ * The stack that PUSH, POP, CALL and RET operate on. It lives outside of the address
+ * space, so it can neither overwrite the program nor be read through RMEM.
+ *
+ * Words are contiguous, and the buffer grows as needed up to a limit. Pushing above the
+ * high-water mark goes through a slow path, so that the mark costs nothing to keep: the
+ * fast path only compares the top against the end of the words pushed so far. Compiled
+ * blocks instead compare it against the end of the buffer, and raise the mark themselves.
+ */
+class CallStack
+{
+public:
+    static constexpr std::size_t default_limit = 1 << 24; // Words
+    static constexpr std::size_t initial_capacity = 1 << 12;
+
+    explicit CallStack(std::size_t const limit = default_limit)
+        : m_limit(limit)
+    { }
+
+    CallStack(CallStack const& other)
+        : m_limit(other.m_limit)
+    {
+        *this = other;
+    }
+
+    /**
+     * @brief Copies the words and the limit. The high-water mark becomes the current size.
+     */
+    CallStack& operator=(CallStack const& other)
+    {
+        if(this == &other) return *this;
+        m_limit = other.m_limit;
+        if(m_data.size() < other.size()) m_data.resize(other.size());
+        m_begin = m_data.data();
+        m_top = std::copy(other.m_begin, other.m_top, m_begin);
+        m_end = m_top;
+        UpdateCapacity();
+        return *this;
+    }
+
+    /**
+     * @returns false if the stack is at its limit, in which case nothing is pushed.
+     */
+    constexpr bool Push(Word const& val)
+    {
+        if(m_top == m_end) [[unlikely]]
+        {
+            if(!RaiseHighWaterMark()) return false;
+        }
+        *m_top++ = val;
+        return true;
+    }
+
+    /**
+     * @brief Removes the top word. The stack must not be empty.
+     */
+    constexpr Word Pop() noexcept
+    {
+        return *--m_top;
+    }
+
+    /**
+     * @brief The top word. The stack must not be empty.
+     */
+    constexpr Word const& top() const noexcept { return m_top[-1]; }
+
+    constexpr bool empty() const noexcept { return m_top == m_begin; }
+    constexpr std::size_t size() const noexcept { return static_cast<std::size_t>(m_top - m_begin); }
+
+    /**
+     * @brief Largest size the stack has had since the last Clear.
+     */
+    constexpr std::size_t high_water_mark() const noexcept { return static_cast<std::size_t>(m_end - m_begin); }
+
+    constexpr std::size_t limit() const noexcept { return m_limit; }
+
+    /**
+     * @brief Sets the maximum number of words. Words already pushed are kept.
+     */
+    constexpr void set_limit(std::size_t const limit) noexcept
+    {
+        m_limit = std::max(limit, high_water_mark());
+        UpdateCapacity();
+    }
+
+    /**
+     * @brief Empties the stack and resets the high-water mark. Memory is kept.
+     */
+    constexpr void Clear() noexcept
+    {
+        m_top = m_begin;
+        m_end = m_begin;
+    }
+
+    /**
+     * @brief Words from the bottom of the stack to the top.
+     */
+    constexpr Word const* begin() const noexcept { return m_begin; }
+    constexpr Word const* end() const noexcept { return m_top; }
+
+    /**
+     * @brief Where the bounds of the stack are kept, for code that pushes and pops by itself
+     *        (such as compiled blocks). Such code may push until the top reaches the capacity,
+     *        beyond which pushing must be left to Push, and must raise the end to the top when
+     *        it goes past it. The words move whenever the stack grows.
+     */
+    constexpr Word** top_location() noexcept { return &m_top; }
+    constexpr Word* const* begin_location() const noexcept { return &m_begin; }
+    constexpr Word** end_location() noexcept { return &m_end; }
+    constexpr Word* const* capacity_location() const noexcept { return &m_capacity; }
+
+private:
+    /**
+     * @brief Slow path of Push, taken when the stack is about to grow past its high-water mark.
+     */
+    [[gnu::noinline]] constexpr bool RaiseHighWaterMark()
+    {
+        if(high_water_mark() == m_limit) return false;
+        if(m_end == m_data.data() + m_data.size())
+        {
+            const std::size_t num_words = size();
+            const std::size_t mark = high_water_mark();
+            m_data.resize(std::min(std::max(2 * m_data.size(), initial_capacity), m_limit));
+            m_begin = m_data.data();
+            m_top = m_begin + num_words;
+            m_end = m_begin + mark;
+            UpdateCapacity();
+        }
+        ++m_end;
+        return true;
+    }
+
+    constexpr void UpdateCapacity() noexcept { m_capacity = m_begin + std::min(m_data.size(), m_limit); }
+
+    std::vector<Word> m_data;
+    Word* m_begin = nullptr;
+    Word* m_top = nullptr; // One past the last word pushed
+    Word* m_end = nullptr; // One past the highest word ever pushed
+    Word* m_capacity = nullptr; // One past the last word that may be pushed without growing the buffer
+    std::size_t m_limit;
+};
@@ -0,0 +1,470 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "breakpoints.h"
+#include "history.h"
+#include "instruction.h"
+#include "watchpoints.h"
+#include "word.h"
+
+/**
+ * Interactive debugger around a machine, reading one command per line. Breakpoints are
+ * only looked at when entering a block of straight-line code, and not at all when there is
+ * none, so that continuing runs as fast as the interpreter allows.
+ *
+ * Watchpoints record every RMEM and WMEM of the words they cover while continuing, and may
+ * pause there, or save a fork of the machine that can be restored later.
+ *
+ * Once recording, every instruction run is added to a History, so that the machine can be taken
+ * back step by step, or to the previous breakpoint, without running the program again.
+ *
+ * Everything, including registers, flags, memory and stack, is printed to the given stream.
+ * The program reads its own input from wherever the machine was told to, which may be the
+ * same stream as the commands.
+ */
+template<typename TVirtualMachine>
+class Debugger
+{
+public:
+    Debugger(TVirtualMachine& vm, std::istream& commands, std::ostream& os)
+        : m_vm(vm)
+        , m_commands(commands)
+        , m_os(os)
+    { }
+
+    ~Debugger() { m_vm.SetHistory(nullptr); }
+
+    Debugger(Debugger const&) = delete;
+    Debugger& operator=(Debugger const&) = delete;
+
+    /**
+     * @brief Reads and runs commands until quit, or the end of the commands.
+     */
+    void Run()
+    {
+        m_os << "Debugging. Type help for the list of commands." << std::endl;
+        PrintLocation();
+        std::string line;
+        while(true)
+        {
+            m_os << "(debug) " << std::flush;
+            if(!std::getline(m_commands, line) || !Execute(line)) return;
+        }
+    }
+
+    /**
+     * @brief Runs a single command.
+     * @returns false once asked to quit
+     */
+    bool Execute(std::string_view const line)
+    {
+        std::istringstream args{std::string(line)};
+        std::string command;
+        if(!(args >> command)) return true;
+
+        if(command == "q" || command == "quit") return false;
+        if(command == "h" || command == "help")             Help();
+        else if(command == "b" || command == "break")       Break(args);
+        else if(command == "d" || command == "delete")      Delete(args);
+        else if(command == "l" || command == "list")        List();
+        else if(command == "s" || command == "step")        Step(args);
+        else if(command == "c" || command == "continue")    Continue();
+        else if(command == "r" || command == "regs")        Registers();
+        else if(command == "x" || command == "mem")         Examine(args);
+        else if(command == "w" || command == "watch")       Watch(args);
+        else if(command == "u" || command == "unwatch")     Unwatch(args);
+        else if(command == "hits")                          Hits(args);
+        else if(command == "snapshots")                     Snapshots();
+        else if(command == "restore")                       Restore(args);
+        else if(command == "record")                        Record(args);
+        else if(command == "rs" || command == "reverse-step")     ReverseStep(args);
+        else if(command == "rc" || command == "reverse-continue") ReverseContinue();
+        else m_os << "Unknown command " << command << ". Type help for the list of commands.\n";
+        m_os << std::flush;
+        return true;
+    }
+
+    Breakpoints& breakpoints() noexcept { return m_breakpoints; }
+    Watchpoints& watchpoints() noexcept { return m_watchpoints; }
+    std::optional<History<TVirtualMachine>> const& history() const noexcept { return m_history; }
+
+private:
+    void Help()
+    {
+        m_os << "Commands:\n"
+             << "  break ADDR [if REG OP VALUE]  Stop before the instruction at ADDR, optionally only when\n"
+             << "                                register REG (a-h) compares to VALUE with OP (== != < > <= >=)\n"
+             << "  delete ADDR                   Remove the breakpoint at ADDR\n"
+             << "  list                          List breakpoints and watchpoints\n"
+             << "  watch ADDR[-LAST] [read|write|access] [pause|snapshot]\n"
+             << "                                Record reads, writes (default) or both of the words from ADDR to\n"
+             << "                                LAST while continuing, and optionally stop or save the machine there\n"
+             << "  unwatch ADDR                  Remove the watchpoint starting at ADDR\n"
+             << "  hits [N]                      Print the last N accesses to watched words (default 20)\n"
+             << "  snapshots                     List the machines saved by watchpoints\n"
+             << "  restore N                     Continue from snapshot N\n"
+             << "  record [INTERVAL [MAX]]       Record every instruction run from now on, with a checkpoint every\n"
+             << "                                INTERVAL of them, keeping at most MAX changes in between\n"
+             << "  record off                    Stop recording\n"
+             << "  reverse-step [N]              Go back N recorded instructions (default 1)\n"
+             << "  reverse-continue              Go back to the previous breakpoint or write to a watched word,\n"
+             << "                                or to the oldest recorded instruction\n"
+             << "  step [N]                      Run N instructions (default 1)\n"
+             << "  continue                      Run until a breakpoint, or until the program stops\n"
+             << "  regs                          Print registers, flags, memory around the instruction pointer and stack\n"
+             << "  mem ADDR [COUNT]              Print COUNT words of memory from ADDR (default 64)\n"
+             << "  quit\n"
+             << "Addresses and values are decimal, or hexadecimal with 0x. Commands may be shortened to their first letter,\n"
+             << "or rs and rc for reverse-step and reverse-continue.\n";
+    }
+
+    static std::optional<std::size_t> ParseNumber(std::istream& args)
+    {
+        std::string text;
+        if(!(args >> text)) return std::nullopt;
+        char* end;
+        const unsigned long long value = std::strtoull(text.c_str(), &end, 0);
+        if(*end != '\0') return std::nullopt;
+        return static_cast<std::size_t>(value);
+    }
+
+    static std::optional<raw_word_t> ParseAddress(std::istream& args)
+    {
+        const std::optional<std::size_t> address = ParseNumber(args);
+        if(!address || *address >= Word::max_word) return std::nullopt;
+        return static_cast<raw_word_t>(*address);
+    }
+
+    void Break(std::istream& args)
+    {
+        const std::optional<raw_word_t> address = ParseAddress(args);
+        if(!address)
+        {
+            m_os << "Usage: break ADDR [if REG OP VALUE]\n";
+            return;
+        }
+
+        std::optional<Breakpoints::Condition> condition;
+        std::string keyword;
+        if(args >> keyword)
+        {
+            condition = ParseCondition(keyword, args);
+            if(!condition)
+            {
+                m_os << "Usage: break ADDR [if REG OP VALUE], with REG in a-h and OP one of == != < > <= >=\n";
+                return;
+            }
+        }
+
+        m_breakpoints.Set(*address, condition);
+        m_os << "Breakpoint at " << Hex(*address) << '\n';
+    }
+
+    static std::optional<Breakpoints::Condition> ParseCondition(std::string_view const keyword, std::istream& args)
+    {
+        constexpr std::pair<std::string_view, Breakpoints::Condition::Comparison> comparisons[] = {
+            {"==", Breakpoints::Condition::EQUAL}, {"!=", Breakpoints::Condition::NOT_EQUAL},
+            {"<", Breakpoints::Condition::LESS}, {">", Breakpoints::Condition::GREATER},
+            {"<=", Breakpoints::Condition::LESS_EQUAL}, {">=", Breakpoints::Condition::GREATER_EQUAL},
+        };
+
+        std::string reg, comparison;
+        if(keyword != "if" || !(args >> reg >> comparison)) return std::nullopt;
+        if(reg.size() != 1 || reg[0] < 'a' || reg[0] >= 'a' + static_cast<int>(InstructionData::num_registers)) return std::nullopt;
+        const auto it = std::find_if(std::begin(comparisons), std::end(comparisons), [&](auto const& entry) { return entry.first == comparison; });
+        const std::optional<std::size_t> value = ParseNumber(args);
+        if(it == std::end(comparisons) || !value || *value >= Word::max_word) return std::nullopt;
+
+        return Breakpoints::Condition{static_cast<std::size_t>(reg[0] - 'a'), it->second, static_cast<raw_word_t>(*value)};
+    }
+
+    void Delete(std::istream& args)
+    {
+        const std::optional<raw_word_t> address = ParseAddress(args);
+        if(!address)                                m_os << "Usage: delete ADDR\n";
+        else if(!m_breakpoints.Remove(*address))    m_os << "No breakpoint at " << Hex(*address) << '\n';
+    }
+
+    void Watch(std::istream& args)
+    {
+        std::string range;
+        args >> range;
+        const std::size_t dash = range.find('-');
+        if(dash != std::string::npos) range[dash] = ' ';
+        std::istringstream bounds(range);
+        const std::optional<raw_word_t> first = ParseAddress(bounds);
+        const std::optional<raw_word_t> last = dash == std::string::npos ? first : ParseAddress(bounds);
+
+        auto access = Watchpoints::WRITE;
+        auto action = Watchpoints::LOG;
+        bool valid = first && last && *last >= *first;
+        std::string option;
+        while(valid && args >> option)
+        {
+            if(option == "read")            access = Watchpoints::READ;
+            else if(option == "write")      access = Watchpoints::WRITE;
+            else if(option == "access")     access = Watchpoints::READ_WRITE;
+            else if(option == "pause")      action = Watchpoints::PAUSE;
+            else if(option == "snapshot")   action = Watchpoints::SNAPSHOT;
+            else valid = false;
+        }
+        if(!valid)
+        {
+            m_os << "Usage: watch ADDR[-LAST] [read|write|access] [pause|snapshot]\n";
+            return;
+        }
+
+        m_watchpoints.Set(*first, *last, access, action);
+        m_os << "Watchpoint on " << Hex(*first);
+        if(*last != *first) m_os << '-' << Hex(*last);
+        m_os << '\n';
+    }
+
+    void Unwatch(std::istream& args)
+    {
+        const std::optional<raw_word_t> address = ParseAddress(args);
+        if(!address)                                m_os << "Usage: unwatch ADDR\n";
+        else if(!m_watchpoints.Remove(*address))    m_os << "No watchpoint starting at " << Hex(*address) << '\n';
+    }
+
+    void Hits(std::istream& args)
+    {
+        std::deque<Watchpoints::Hit> const& hits = m_watchpoints.hits();
+        const std::size_t count = std::min(ParseNumber(args).value_or(20), hits.size());
+        m_os << m_watchpoints.num_hits() << " accesses to watched words\n";
+        for(auto it = hits.end() - static_cast<std::ptrdiff_t>(count); it != hits.end(); ++it) PrintHit(*it);
+    }
+
+    void PrintHit(Watchpoints::Hit const& hit)
+    {
+        m_os << "  #" << hit.index << ' ' << Hex(hit.instr_ptr) << ": ";
+        if(hit.access == Watchpoints::READ) m_os << "read  [" << Hex(hit.address) << "] = " << hit.old_value << '\n';
+        else                                m_os << "write [" << Hex(hit.address) << "] " << hit.old_value << " -> " << hit.new_value << '\n';
+    }
+
+    void Snapshots()
+    {
+        if(m_snapshots.empty()) m_os << "No snapshots\n";
+        for(std::size_t i=0; i < m_snapshots.size(); ++i)
+        {
+            m_os << "  " << i << ": at hit #" << m_snapshots[i].hit << ", " << Hex(m_snapshots[i].vm.instr_ptr().get().to_int()) << '\n';
+        }
+    }
+
+    void Restore(std::istream& args)
+    {
+        const std::optional<std::size_t> index = ParseNumber(args);
+        if(!index || *index >= m_snapshots.size())
+        {
+            m_os << "Usage: restore N, with N from the list of snapshots\n";
+            return;
+        }
+        m_vm.CopyStateFrom(m_snapshots[*index].vm);
+        if(m_history) m_vm.SetHistory(&*m_history); // Starts over from here
+        PrintLocation();
+    }
+
+    void List()
+    {
+        if(m_breakpoints.empty() && m_watchpoints.empty()) m_os << "No breakpoints\n";
+        for(auto const& [address, condition]: m_breakpoints.all())
+        {
+            constexpr std::string_view names[] = {"==", "!=", "<", ">", "<=", ">="};
+            m_os << "  " << Hex(address);
+            if(condition) m_os << " if " << static_cast<char>('a' + condition->reg) << ' ' << names[condition->comparison] << ' ' << condition->value;
+            m_os << '\n';
+        }
+        for(auto const& [first, watchpoint]: m_watchpoints.all())
+        {
+            constexpr std::string_view accesses[] = {"", "read", "write", "access"};
+            constexpr std::string_view actions[] = {"", " pause", " snapshot"};
+            m_os << "  watch " << Hex(first);
+            if(watchpoint.last != first) m_os << '-' << Hex(watchpoint.last);
+            m_os << ' ' << accesses[watchpoint.access] << actions[watchpoint.action] << '\n';
+        }
+    }
+
+    void Step(std::istream& args)
+    {
+        const std::size_t count = ParseNumber(args).value_or(1);
+        for(std::size_t i=0; i < count && m_vm.IsRunning(); ++i) m_vm.Step();
+        m_vm.FlushOutput();
+        PrintLocation();
+    }
+
+    void Continue()
+    {
+        while(true)
+        {
+            const std::uint64_t num_hits = m_watchpoints.num_hits();
+            const bool stopped = m_vm.ResumeUntilBreakpoint(m_breakpoints, m_watchpoints);
+            m_vm.FlushOutput();
+
+            // Watchpoints that only log never stop the machine, so it stopped at the last hit if that one does not
+            const bool watched = stopped && m_watchpoints.num_hits() != num_hits && m_watchpoints.hits().back().action != Watchpoints::LOG;
+            if(!watched)
+            {
+                if(m_watchpoints.num_hits() != num_hits) m_os << m_watchpoints.num_hits() - num_hits << " accesses to watched words\n";
+                if(stopped) m_os << "Breakpoint reached\n";
+                break;
+            }
+
+            Watchpoints::Hit const& hit = m_watchpoints.hits().back();
+            PrintHit(hit);
+            if(hit.action == Watchpoints::PAUSE)
+            {
+                m_os << "Watchpoint reached\n";
+                break;
+            }
+            m_snapshots.push_back(Snapshot{hit.index, m_vm.Fork()});
+            m_os << "Saved snapshot " << m_snapshots.size() - 1 << '\n';
+        }
+        PrintLocation();
+    }
+
+    void Registers()
+    {
+        m_vm.Print(m_os);
+        m_os << std::dec << std::setfill(' ');
+    }
+
+    void Examine(std::istream& args)
+    {
+        const std::optional<raw_word_t> address = ParseAddress(args);
+        if(!address)
+        {
+            m_os << "Usage: mem ADDR [COUNT]\n";
+            return;
+        }
+        const std::size_t count = ParseNumber(args).value_or(64);
+        const std::size_t end = std::min<std::size_t>(*address + std::max<std::size_t>(count, 1), Word::max_word);
+
+        constexpr std::size_t row_size = 8; // As printed by hex_dump
+        std::as_const(m_vm).memory().hex_dump(*address / row_size, (end + row_size - 1) / row_size, *address, m_os);
+        m_os << std::dec << std::setfill(' ');
+    }
+
+    void Record(std::istream& args)
+    {
+        std::string first;
+        args >> first;
+        if(first == "off")
+        {
+            m_vm.SetHistory(nullptr);
+            m_history.reset();
+            m_os << "Stopped recording\n";
+            return;
+        }
+
+        std::istringstream first_number(first);
+        const std::size_t interval = ParseNumber(first_number).value_or(History<TVirtualMachine>::default_interval);
+        const std::size_t max_deltas = ParseNumber(args).value_or(History<TVirtualMachine>::default_max_deltas);
+        m_vm.SetHistory(nullptr);
+        m_history.emplace(interval, max_deltas);
+        m_vm.SetHistory(&*m_history);
+        m_os << "Recording, with a checkpoint every " << m_history->interval() << " instructions and at most "
+             << m_history->max_deltas() << " changes kept\n";
+    }
+
+    /**
+     * @brief Whether the machine is in the state after the latest recorded instruction. Otherwise,
+     *        it stopped on the instruction after, which is not recorded.
+     */
+    bool IsAtRecordedStep() const noexcept { return m_vm.IsRunning() || m_vm.IsAwaitingInput(); }
+
+    void ReverseStep(std::istream& args)
+    {
+        if(!m_history)
+        {
+            m_os << "Not recording. Type record to start.\n";
+            return;
+        }
+
+        const std::uint64_t count = ParseNumber(args).value_or(1);
+        if(count == 0) return;
+        const std::uint64_t back = IsAtRecordedStep() ? count : count - 1;
+        const std::uint64_t available = m_history->now() - m_history->oldest();
+        if(back > available) m_os << "Reached the oldest recorded instruction\n";
+        m_vm.TravelTo(m_history->now() - std::min(back, available));
+        PrintLocation();
+    }
+
+    void ReverseContinue()
+    {
+        using Delta = typename History<TVirtualMachine>::Delta;
+        if(!m_history)
+        {
+            m_os << "Not recording. Type record to start.\n";
+            return;
+        }
+
+        const std::uint64_t before = IsAtRecordedStep() ? m_history->now() : m_history->now() + 1;
+        const std::optional<std::uint64_t> found = m_history->FindLast(before, [&](raw_word_t const instr_ptr, auto const registers, Delta const* const previous) {
+            if(m_breakpoints.ShouldStop(instr_ptr, registers)) return true;
+            return previous && previous->kind == Delta::MEMORY && m_watchpoints.Watches(previous->destination, Watchpoints::WRITE);
+        });
+
+        m_vm.TravelTo(found.value_or(m_history->oldest()));
+        m_os << (found ? "Breakpoint or watchpoint reached\n" : "Reached the oldest recorded instruction\n");
+        PrintLocation();
+    }
+
+    void PrintLocation()
+    {
+        if(!m_vm.IsRunning() && !m_vm.IsAwaitingInput())
+        {
+            m_os << "The program has stopped\n";
+            return;
+        }
+
+        const raw_word_t ip = m_vm.instr_ptr().get().to_int();
+        auto const& memory = std::as_const(m_vm).memory();
+        const auto opcode = InstructionData::to_opcode(memory[ip]);
+        if(m_history) m_os << "[step " << m_history->now() << "] ";
+        m_os << Hex(ip) << ": " << InstructionData::InstructionName(opcode);
+        for(std::size_t i=1; i <= InstructionData::NumOperands(opcode) && ip + i < Word::max_word; ++i)
+        {
+            const raw_word_t operand = memory[static_cast<raw_word_t>(ip + i)].to_int();
+            if(operand >= Word::max_word && operand < Word::max_word + InstructionData::num_registers)
+            {
+                m_os << ' ' << static_cast<char>('a' + (operand - Word::max_word));
+            } else {
+                m_os << ' ' << operand;
+            }
+        }
+        m_os << '\n';
+    }
+
+    static std::string Hex(raw_word_t const address)
+    {
+        std::ostringstream os;
+        os << "0x" << std::hex << std::setw(4) << std::setfill('0') << address;
+        return os.str();
+    }
+
+    TVirtualMachine& m_vm;
+    std::istream& m_commands;
+    std::ostream& m_os;
+    Breakpoints m_breakpoints;
+    Watchpoints m_watchpoints;
+    std::optional<History<TVirtualMachine>> m_history; // While recording
+
+    struct Snapshot
+    {
+        std::uint64_t hit; // Index of the hit that saved it
+        TVirtualMachine vm;
+    };
+    std::deque<Snapshot> m_snapshots; // Never relocated, as machines cannot be assigned
+};
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include "address.h"
+#include "instruction.h"
+#include "shared_pages.h"
+#include "superinstruction.h"
+#include "virtual_memory.h"
+#include "word.h"
+
+/**
+ * An instruction argument, classified once by the decoder.
+ */
+struct Operand
+{
+    InstructionData::WordType type = InstructionData::INVALID;
+    Word value = 0; // Literal value, or register index if type is REGISTER
+};
+
+/**
+ * Compact record of the instruction starting at some address in memory.
+ */
+struct DecodedInstruction
+{
+    // Value of operand_modes for instructions whose operands must be classified at run time
+    static constexpr std::uint8_t runtime_modes = 1 << InstructionData::max_operands;
+
+    InstructionData::OpCode opcode = InstructionData::WRONG_OPCODE;
+    std::uint8_t length = 0; // Number of words, including the opcode. Zero means not decoded.
+    bool may_fault = false;  // Some operand is invalid or a literal where a register is expected
+    std::uint8_t operand_modes = runtime_modes; // Bit i is set if args[i] is a register
+    std::array<Operand, InstructionData::max_operands> args;
+    SuperinstructionData::Kind fusion = SuperinstructionData::NONE; // Group of instructions that starts here
+    std::uint8_t span = 0; // Number of words, including those of the instructions fused to this one
+
+    constexpr bool is_decoded() const noexcept { return length != 0; }
+};
+
+/**
+ * Operands of a decoded instruction, with the type of each one fixed at compile time.
+ * An empty list of modes means that operands are classified at run time.
+ */
+template<InstructionData::WordType... TModes>
+struct Operands
+{
+    static constexpr bool is_runtime = sizeof...(TModes) == 0;
+
+    static constexpr InstructionData::WordType Mode(std::size_t const n) noexcept
+    {
+        constexpr std::array<InstructionData::WordType, sizeof...(TModes)> modes = {TModes...};
+        return modes[n];
+    }
+
+    DecodedInstruction const& instr;
+};
+
+/**
+ * Caches the decoded instruction at every address of the memory.
+ * Instructions are decoded the first time they are fetched. Any write
+ * to memory must be reported through Invalidate, otherwise stale code
+ * will be executed.
+ *
+ * Entries are kept in pages of the same size as those of the memory, which copies
+ * of the cache share until one of them decodes or drops an instruction in the page.
+ * Superinstructions never cross a page, so that the instructions of a group are
+ * contiguous.
+ */
+class DecodeCache
+{
+public:
+    static constexpr raw_word_t address_space = Word::max_word;
+    static constexpr std::size_t max_instruction_length = 1 + InstructionData::max_operands;
+    static constexpr std::size_t page_size = Memory::page_size;
+
+    struct Page
+    {
+        std::array<DecodedInstruction, page_size> entries;
+        std::array<std::uint64_t, page_size/64> is_code {}; // Bitmap of words that belong to some decoded instruction
+        std::array<std::uint64_t, page_size/64> is_hook {}; // Bitmap of addresses that decode as NATIVE_HOOK
+    };
+
+    using Pages = SharedPages<Page, address_space / page_size>;
+
+    static constexpr std::size_t max_span = SuperinstructionData::max_instructions * max_instruction_length;
+
+    [[gnu::always_inline]] DecodedInstruction const& Fetch(Memory const& memory, Address const ptr)
+    {
+        DecodedInstruction const& cached = entry(ptr.get().to_int());
+        if(cached.is_decoded()) [[likely]] return cached;
+        return DecodeBlock(memory, ptr);
+    }
+
+    /**
+     * @brief Drops every cached instruction that overlaps the word at ptr,
+     *        either by itself or through the instructions fused to it.
+     * @returns whether the word may hold code
+     */
+    bool Invalidate(Address const ptr)
+    {
+        const raw_word_t raw_ptr = ptr.get().to_int();
+        if(!IsCode(raw_ptr)) return false;
+        DropOverlapping(raw_ptr);
+        return true;
+    }
+
+    /**
+     * @brief Drops every cached instruction. Hooks are kept.
+     */
+    void Clear()
+    {
+        Pages cleared;
+        for(std::size_t i=0; i < Pages::num_pages; ++i)
+        {
+            auto const& is_hook = m_pages.page(i).is_hook;
+            if(std::ranges::any_of(is_hook, [](std::uint64_t const bits){ return bits != 0; }))
+            {
+                cleared.mutable_page(i).is_hook = is_hook;
+            }
+        }
+        m_pages = cleared;
+    }
+
+    /**
+     * @brief Makes the instruction at ptr decode as NATIVE_HOOK, or back to whatever
+     *        memory holds. The instruction keeps its length, so that overwriting it
+     *        is still noticed.
+     */
+    void SetHook(Address const ptr, bool const hooked)
+    {
+        const raw_word_t raw_ptr = ptr.get().to_int();
+        std::uint64_t& bits = mutable_page(raw_ptr).is_hook[Bit(raw_ptr) / 64];
+        if(hooked) bits |= std::uint64_t{1} << (raw_ptr % 64);
+        else       bits &= ~(std::uint64_t{1} << (raw_ptr % 64));
+        DropOverlapping(raw_ptr);
+    }
+
+    bool IsHook(Address const ptr) const noexcept
+    {
+        const raw_word_t raw_ptr = ptr.get().to_int();
+        return (page(raw_ptr).is_hook[Bit(raw_ptr) / 64] >> (raw_ptr % 64)) & 1;
+    }
+
+    static constexpr DecodedInstruction Decode(Memory const& memory, Address ptr)
+    {
+        DecodedInstruction out;
+
+        out.opcode = InstructionData::to_opcode(memory[ptr]);
+        if(out.opcode > InstructionData::WRONG_OPCODE)
+        {
+            out.opcode = InstructionData::WRONG_OPCODE;
+        }
+
+        const std::size_t num_operands = InstructionData::NumOperands(out.opcode);
+        out.length = static_cast<std::uint8_t>(1 + num_operands);
+        out.span = out.length;
+
+        for(std::size_t i=0; i < num_operands; ++i)
+        {
+            out.args[i] = DecodeOperand(memory[++ptr]);
+            out.may_fault |= out.args[i].type == InstructionData::INVALID;
+        }
+
+        if(InstructionData::HasRegisterTarget(out.opcode))
+        {
+            out.may_fault |= out.args[0].type != InstructionData::REGISTER;
+        }
+
+        if(!out.may_fault)
+        {
+            out.operand_modes = 0;
+            for(std::size_t i=0; i < num_operands; ++i)
+            {
+                const bool is_register = out.args[i].type == InstructionData::REGISTER;
+                out.operand_modes |= static_cast<std::uint8_t>(is_register << i);
+            }
+        }
+
+        return out;
+    }
+
+    static constexpr Operand DecodeOperand(Word const& w) noexcept
+    {
+        const auto type = InstructionData::to_wordtype(w);
+        switch(type)
+        {
+            case InstructionData::REGISTER: return {type, Word(w.to_int() - Word::max_word)};
+            case InstructionData::LITERAL:  return {type, w};
+            case InstructionData::INVALID:  return {type, 0};
+        }
+        return {};
+    }
+
+    /**
+     * @brief Number of instructions of each kind of group among the cached ones.
+     */
+    std::array<std::size_t, SuperinstructionData::NUM_KINDS> CountFusions() const noexcept
+    {
+        std::array<std::size_t, SuperinstructionData::NUM_KINDS> counts {};
+        for(std::size_t i=0; i < Pages::num_pages; ++i)
+        {
+            for(auto const& entry: m_pages.page(i).entries)
+            {
+                if(entry.is_decoded()) ++counts[entry.fusion];
+            }
+        }
+        return counts;
+    }
+
+    /**
+     * @brief Pages, whose is_code bitmaps tell which words have been decoded since
+     *        the last Clear, for compiled code and for copies of the cache.
+     */
+    constexpr Pages const& pages() const noexcept { return m_pages; }
+
+private:
+    static constexpr bool EndsBasicBlock(InstructionData::OpCode op) noexcept
+    {
+        switch(op)
+        {
+            case InstructionData::HALT: case InstructionData::JMP: case InstructionData::JT:
+            case InstructionData::JF:   case InstructionData::CALL: case InstructionData::RET:
+            case InstructionData::WRONG_OPCODE: case InstructionData::NATIVE_HOOK:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * @brief Decodes the basic block that starts at ptr, then fuses adjacent instructions in it.
+     *        The block ends at the first instruction that may transfer control, before the
+     *        first one that is already decoded, or at the end of memory.
+     * @returns the instruction at begin
+     */
+    [[gnu::noinline]] DecodedInstruction const& DecodeBlock(Memory const& memory, Address const begin)
+    {
+        raw_word_t raw_ptr = begin.get().to_int();
+        std::size_t block_size = 0;
+        while(!entry(raw_ptr).is_decoded())
+        {
+            DecodedInstruction& decoded = mutable_entry(raw_ptr);
+            decoded = Decode(memory, raw_ptr);
+            if(IsHook(raw_ptr))
+            {
+                decoded.opcode = InstructionData::NATIVE_HOOK;
+                decoded.may_fault = false;
+                decoded.operand_modes = 0;
+            }
+            MarkAsCode(raw_ptr, decoded.length);
+            ++block_size;
+
+            if(EndsBasicBlock(decoded.opcode)) break;
+            if(raw_ptr + decoded.length >= address_space) break;
+            raw_ptr += decoded.length;
+        }
+
+        raw_ptr = begin.get().to_int();
+        for(std::size_t i=0; i < block_size; ++i)
+        {
+            Fuse(raw_ptr);
+            raw_ptr += entry(raw_ptr).length;
+        }
+        return entry(begin.get().to_int());
+    }
+
+    /**
+     * @brief Fuses the instruction at raw_ptr with the decoded ones that follow it, if they form a group.
+     *        Instructions with operands that may fault are never fused, and neither are
+     *        instructions in another page.
+     */
+    void Fuse(raw_word_t const raw_ptr)
+    {
+        std::array<InstructionData::OpCode, SuperinstructionData::max_instructions> run {};
+        std::size_t run_size = 0;
+        std::size_t ptr = raw_ptr;
+        while(run_size < run.size() && ptr / page_size == raw_ptr / page_size)
+        {
+            DecodedInstruction const& next = entry(static_cast<raw_word_t>(ptr));
+            if(!next.is_decoded() || next.may_fault) break;
+            run[run_size++] = next.opcode;
+            ptr += next.length;
+        }
+
+        DecodedInstruction& head = mutable_entry(raw_ptr);
+        head.fusion = SuperinstructionData::Match(run, run_size);
+        head.span = 0;
+
+        ptr = raw_ptr;
+        for(std::size_t i=0; i < std::max<std::size_t>(1, SuperinstructionData::patterns[head.fusion].size); ++i)
+        {
+            const std::uint8_t length = entry(static_cast<raw_word_t>(ptr)).length;
+            head.span = static_cast<std::uint8_t>(head.span + length);
+            ptr += length;
+        }
+    }
+
+    /**
+     * @brief Slow path of Invalidate, kept out of line so that memory writes stay cheap to inline.
+     */
+    [[gnu::noinline]] void DropOverlapping(raw_word_t const raw_ptr)
+    {
+        for(std::size_t i=0; i < max_span; ++i)
+        {
+            const auto ptr = static_cast<raw_word_t>((raw_ptr - i) % address_space);
+            DecodedInstruction const& overlapping = entry(ptr);
+            if(overlapping.is_decoded() && overlapping.span > i)
+            {
+                mutable_entry(ptr).length = 0;
+            }
+        }
+    }
+
+    void MarkAsCode(Address ptr, std::size_t const length)
+    {
+        for(std::size_t i=0; i < length; ++i)
+        {
+            const raw_word_t raw_ptr = (ptr++).get().to_int();
+            if(IsCode(raw_ptr)) continue;
+            mutable_page(raw_ptr).is_code[Bit(raw_ptr) / 64] |= std::uint64_t{1} << (raw_ptr % 64);
+        }
+    }
+
+    bool IsCode(raw_word_t const raw_ptr) const noexcept
+    {
+        return (page(raw_ptr).is_code[Bit(raw_ptr) / 64] >> (raw_ptr % 64)) & 1;
+    }
+
+    static constexpr std::size_t Bit(raw_word_t const raw_ptr) noexcept { return raw_ptr % page_size; }
+
+    Page const& page(raw_word_t const raw_ptr) const noexcept { return m_pages.page(raw_ptr / page_size); }
+    Page& mutable_page(raw_word_t const raw_ptr) { return m_pages.mutable_page(raw_ptr / page_size); }
+
+    DecodedInstruction const& entry(raw_word_t const raw_ptr) const noexcept { return page(raw_ptr).entries[raw_ptr % page_size]; }
+    DecodedInstruction& mutable_entry(raw_word_t const raw_ptr) { return mutable_page(raw_ptr).entries[raw_ptr % page_size]; }
+
+    Pages m_pages;
+};
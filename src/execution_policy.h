@@ -0,0 +1,31 @@
+#pragma once
+
+/**
+ * Execution policies for BasicVirtualMachine.
+ *
+ * With checked execution, jump and memory addresses are validated, popping an empty
+ * stack is detected, and invalid operands raise flags. Unchecked execution trusts the
+ * program: addresses are wrapped into the address space and none of these checks is
+ * compiled in. Both policies share the same Execute<Op> implementations.
+ *
+ * Profiled execution is checked execution that also counts every instruction it runs, per
+ * address, per opcode and per chain of calls. To keep a single counting site, it runs one instruction at a time:
+ * superinstructions, the threaded loop and the JIT are all bypassed.
+ */
+struct CheckedPolicy
+{
+    static constexpr bool checked = true;
+    static constexpr bool profiled = false;
+};
+
+struct UncheckedPolicy
+{
+    static constexpr bool checked = false;
+    static constexpr bool profiled = false;
+};
+
+struct ProfiledPolicy
+{
+    static constexpr bool checked = true;
+    static constexpr bool profiled = true;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+
+#include "instruction.h"
+#include "word.h"
+
+/**
+ * Record of the instructions a machine ran, from which BasicVirtualMachine::TravelTo brings
+ * it back to any earlier state. A full checkpoint, a fork of the machine, is taken every
+ * interval instructions, and in between only what each instruction changed is kept. Going to
+ * a step restores the checkpoint before it and applies the changes up to it, without running
+ * anything again.
+ *
+ * The changes are kept in a ring: once there are more than max_deltas of them, the oldest
+ * checkpoint is dropped along with the changes it led to, so memory stays bounded.
+ */
+template<typename TVirtualMachine>
+class History
+{
+public:
+    static constexpr std::size_t default_interval = 1 << 16;   // Instructions
+    static constexpr std::size_t default_max_deltas = 1 << 22; // 48 MiB
+
+    /**
+     * @brief What one instruction changed. Since instructions write at most one register or word
+     *        of memory, and push or pop at most one word, this is enough to redo any of them.
+     */
+    struct Delta
+    {
+        enum Kind : std::uint8_t
+        {
+            NONE,     // Only the instruction pointer and the stack size changed
+            REGISTER, // destination is the register index
+            INPUT,    // Same as REGISTER, for a character read by IN
+            MEMORY,   // destination is the address
+            PUSH,     // value was pushed
+            OPAQUE    // Ran a hook or a memoized call, which may change anything. A checkpoint follows.
+        };
+
+        raw_word_t instr_ptr; // Afterwards
+        Kind kind;
+        raw_word_t destination;
+        raw_word_t value;
+        std::uint32_t stack_size; // Afterwards
+    };
+
+    struct Checkpoint
+    {
+        Checkpoint(std::uint64_t const step, TVirtualMachine const& vm)
+            : step(step)
+            , vm(vm)
+        { }
+
+        std::uint64_t step;
+        TVirtualMachine vm;
+    };
+
+    explicit History(std::size_t const interval = default_interval, std::size_t const max_deltas = default_max_deltas)
+        : m_interval(std::clamp<std::size_t>(interval, 1, std::max<std::size_t>(max_deltas, 1)))
+        , m_max_deltas(std::max<std::size_t>(max_deltas, 1))
+    { }
+
+    std::size_t interval() const noexcept { return m_interval; }
+    std::size_t max_deltas() const noexcept { return m_max_deltas; }
+
+    /**
+     * @brief Number of instructions recorded before the current state of the machine.
+     */
+    std::uint64_t now() const noexcept { return m_now; }
+
+    /**
+     * @brief Earliest step that can still be travelled to.
+     */
+    std::uint64_t oldest() const noexcept { return m_checkpoints.empty() ? m_now : m_checkpoints.front().step; }
+
+    /**
+     * @brief Latest step that was recorded. Later than now after travelling back.
+     */
+    std::uint64_t latest() const noexcept { return m_first_step + m_deltas.size(); }
+
+    std::size_t num_checkpoints() const noexcept { return m_checkpoints.size(); }
+
+    /**
+     * @brief What the instruction run at step changed. step must be between oldest and latest, excluded.
+     */
+    Delta const& delta(std::uint64_t const step) const noexcept { return m_deltas[step - m_first_step]; }
+
+    /**
+     * @brief Latest checkpoint at or before the step, which must not be before oldest.
+     */
+    Checkpoint const& CheckpointBefore(std::uint64_t const step) const noexcept
+    {
+        const auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), step, [](std::uint64_t const s, Checkpoint const& c) { return s < c.step; });
+        return *(it - 1);
+    }
+
+    /**
+     * @brief Forgets everything, and numbers steps from zero again.
+     */
+    void Clear()
+    {
+        m_checkpoints.clear();
+        m_deltas.clear();
+        m_first_step = 0;
+        m_now = 0;
+    }
+
+    /**
+     * @brief Whether the state at now must be saved in full before recording the next instruction.
+     */
+    bool NeedsCheckpoint() const noexcept { return m_checkpoints.empty() || m_now - m_checkpoints.back().step >= m_interval; }
+
+    void AddCheckpoint(TVirtualMachine const& vm)
+    {
+        if(!m_checkpoints.empty() && m_checkpoints.back().step == m_now) return;
+        m_checkpoints.emplace_back(m_now, vm);
+    }
+
+    /**
+     * @brief Appends the instruction run at now. Whatever was recorded after now is dropped first,
+     *        since the machine is no longer heading there.
+     */
+    void Record(Delta const& delta)
+    {
+        if(m_now != latest())
+        {
+            m_deltas.resize(m_now - m_first_step);
+            while(m_checkpoints.back().step > m_now) m_checkpoints.pop_back();
+        }
+
+        m_deltas.push_back(delta);
+        ++m_now;
+
+        while(m_deltas.size() > m_max_deltas && m_checkpoints.size() > 1)
+        {
+            m_checkpoints.pop_front();
+            const std::uint64_t first_step = m_checkpoints.front().step;
+            m_deltas.erase(m_deltas.begin(), m_deltas.begin() + static_cast<std::ptrdiff_t>(first_step - m_first_step));
+            m_first_step = first_step;
+        }
+    }
+
+    /**
+     * @brief Moves now to a step that was recorded, once the machine has been brought to it.
+     */
+    void SetNow(std::uint64_t const step) noexcept { m_now = step; }
+
+    /**
+     * @brief Latest step before the given one at which the predicate holds, looking only at the
+     *        instruction pointer, the registers, and the change that led there.
+     * @param predicate is called with the instruction pointer, the registers and the previous
+     *        Delta, or nullptr if it is no longer recorded
+     */
+    template<typename TPredicate>
+    std::optional<std::uint64_t> FindLast(std::uint64_t const before, TPredicate&& predicate) const
+    {
+        for(auto checkpoint = m_checkpoints.rbegin(); checkpoint != m_checkpoints.rend(); ++checkpoint)
+        {
+            if(checkpoint->step >= before) continue;
+            const std::uint64_t end = std::min(before, checkpoint == m_checkpoints.rbegin() ? latest() + 1 : (checkpoint - 1)->step);
+
+            std::array<Word, InstructionData::num_registers> registers;
+            std::ranges::copy(checkpoint->vm.registers(), registers.begin());
+            raw_word_t instr_ptr = checkpoint->vm.instr_ptr().get().to_int();
+
+            std::optional<std::uint64_t> found;
+            for(std::uint64_t step = checkpoint->step; step < end; ++step)
+            {
+                if(step != checkpoint->step)
+                {
+                    Delta const& previous = delta(step - 1);
+                    instr_ptr = previous.instr_ptr;
+                    if(previous.kind == Delta::REGISTER || previous.kind == Delta::INPUT) registers[previous.destination] = previous.value;
+                }
+                Delta const* const previous = step > m_first_step ? &delta(step - 1) : nullptr;
+                if(predicate(instr_ptr, std::span<Word const, InstructionData::num_registers>(registers), previous)) found = step;
+            }
+            if(found) return found;
+        }
+        return std::nullopt;
+    }
+
+private:
+    std::size_t m_interval;
+    std::size_t m_max_deltas;
+
+    std::deque<Checkpoint> m_checkpoints; // By step
+    std::deque<Delta> m_deltas;           // Instruction run at m_first_step first
+    std::uint64_t m_first_step = 0;
+    std::uint64_t m_now = 0;
+};
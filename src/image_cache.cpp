@@ -0,0 +1,43 @@
+#include "image_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <system_error>
+#include <utility>
+
+ImageCache::ImageCache(std::filesystem::path directory)
+    : m_directory(std::move(directory))
+{
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+}
+
+std::filesystem::path ImageCache::path(Key const key) const
+{
+    char name[sizeof("0123456789abcdef.image")];
+    std::snprintf(name, sizeof(name), "%016llx.image", static_cast<unsigned long long>(key));
+    return m_directory / name;
+}
+
+void ImageCache::Write(Key const key, std::string_view const entry) const
+{
+    const std::filesystem::path target = path(key);
+    std::filesystem::path temporary = target;
+    temporary += ".tmp" + std::to_string(std::random_device{}());
+
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        file.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+        if(!file)
+        {
+            std::error_code error;
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, target, error);
+    if(error) std::filesystem::remove(temporary, error);
+}
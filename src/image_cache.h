@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "output_sink.h"
+#include "snapshot.h"
+
+/**
+ * Machine images saved on disk, keyed by a hash of the program and of every line of input
+ * it has consumed, so that runs sharing a prefix of their input can skip the execution
+ * leading up to it. Images are taken while the machine waits for input, and each one is
+ * stored next to the output printed since the previous image, which is replayed on restore.
+ *
+ * Each entry is a single file, written under a temporary name and then renamed into place,
+ * so that concurrent runs never see half of one:
+ *
+ *   output_size   8 bytes, little-endian
+ *   output        output_size bytes
+ *   snapshot      as written by SaveSnapshot
+ */
+class ImageCache
+{
+public:
+    using Key = std::uint64_t;
+
+    explicit ImageCache(std::filesystem::path directory);
+
+    /**
+     * @brief Key of a program (or of the snapshot a run resumes from), before it reads any input.
+     */
+    static constexpr Key Hash(std::span<std::byte const> const bytes) noexcept
+    {
+        Key key = fnv_offset;
+        for(std::byte const b: bytes) key = (key ^ std::to_integer<Key>(b)) * fnv_prime;
+        return key;
+    }
+
+    /**
+     * @brief Key of the image reached after consuming one more line, given without its newline.
+     */
+    static constexpr Key Extend(Key key, std::string_view const line) noexcept
+    {
+        for(char const c: line) key = (key ^ static_cast<unsigned char>(c)) * fnv_prime;
+        return (key ^ '\n') * fnv_prime;
+    }
+
+    /**
+     * @brief Loads the image stored under key into the machine, and writes the output that led to it.
+     * @returns false if there is no valid entry, in which case neither is touched
+     */
+    template<typename TVirtualMachine>
+    bool Restore(Key key, TVirtualMachine& vm, OutputSink& sink) const;
+
+    /**
+     * @brief Saves the state of the machine under key, along with the output that led to it.
+     *        Failing to write is not an error: the entry is simply missing next time.
+     */
+    template<typename TVirtualMachine>
+    void Store(Key key, TVirtualMachine const& vm, std::string_view output) const;
+
+    std::filesystem::path path(Key key) const;
+
+private:
+    static constexpr Key fnv_offset = 0xcbf29ce484222325;
+    static constexpr Key fnv_prime = 0x100000001b3;
+
+    void Write(Key key, std::string_view entry) const;
+
+    std::filesystem::path m_directory;
+};
+
+template<typename TVirtualMachine>
+bool ImageCache::Restore(Key const key, TVirtualMachine& vm, OutputSink& sink) const
+{
+    const MappedFile file(path(key).c_str());
+    const std::span<std::byte const> entry = file.data();
+    if(entry.size() < sizeof(std::uint64_t)) return false;
+
+    std::uint64_t output_size;
+    std::memcpy(&output_size, entry.data(), sizeof(output_size));
+    output_size = LittleEndian(output_size);
+    if(output_size > entry.size() - sizeof(output_size)) return false;
+
+    const std::span<std::byte const> output = entry.subspan(sizeof(output_size), output_size);
+    if(!vm.LoadSnapshot(entry.subspan(sizeof(output_size) + output_size))) return false;
+
+    sink.Put(std::string_view(reinterpret_cast<char const*>(output.data()), output.size()));
+    return true;
+}
+
+template<typename TVirtualMachine>
+void ImageCache::Store(Key const key, TVirtualMachine const& vm, std::string_view const output) const
+{
+    const std::uint64_t output_size = LittleEndian(static_cast<std::uint64_t>(output.size()));
+
+    std::string entry(reinterpret_cast<char const*>(&output_size), sizeof(output_size));
+    entry += output;
+    std::ostringstream snapshot;
+    vm.SaveSnapshot(snapshot);
+    entry += snapshot.view();
+
+    Write(key, entry);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 
 #include "word.h"
 
@@ -8,7 +9,7 @@ class InstructionData
 {
 public:
 
-    enum OpCode
+    enum OpCode : std::uint8_t
     {
         HALT,
         SET,
@@ -32,10 +33,13 @@ public:
         OUT,
         IN,
         NOOP,
-        WRONG_OPCODE
+        WRONG_OPCODE,
+        NATIVE_HOOK  // Never decoded from memory: stands in for subroutines replaced by host code
     };
 
-    enum WordType 
+    static constexpr std::size_t num_opcodes = NATIVE_HOOK + 1;
+
+    enum WordType : std::uint8_t
     {
         LITERAL,
         REGISTER,
@@ -46,11 +50,9 @@ public:
     {
         // Operations   0 --   21 are correct
         // Operations  22 --   FF terminate the program
-        // Operations 100 -- FFFF are truncated to the previous two
+        // Operations 100 -- FFFF are wrong as well
         
-#ifndef DNDEBUG
         if(word.hi() != 0) return WRONG_OPCODE;
-#endif
 
         return static_cast<OpCode>(word.lo());
     }
@@ -65,6 +67,40 @@ public:
         return INVALID;
     }
 
+    /**
+     * @brief Number of operand words that follow the opcode.
+     */
+    static constexpr std::size_t NumOperands(OpCode op) noexcept
+    {
+        switch(op)
+        {
+            case HALT: case RET: case NOOP: case WRONG_OPCODE: case NATIVE_HOOK:
+                return 0;
+            case PUSH: case POP: case JMP: case CALL: case OUT: case IN:
+                return 1;
+            case SET: case JT: case JF: case NOT: case RMEM: case WMEM:
+                return 2;
+            case EQ: case GT: case ADD: case MULT: case MOD: case AND: case OR:
+                return 3;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Whether the first operand must be a register that the instruction writes to.
+     */
+    static constexpr bool HasRegisterTarget(OpCode op) noexcept
+    {
+        switch(op)
+        {
+            case SET: case POP: case EQ: case GT: case ADD: case MULT: case MOD:
+            case AND: case OR:  case NOT: case RMEM: case IN:
+                return true;
+            default:
+                return false;
+        }
+    }
+
     static constexpr std::string_view InstructionName(OpCode op) noexcept
     {
         switch(op)
@@ -92,12 +128,14 @@ public:
             case IN          : return "IN";
             case NOOP        : return "NOOP";
             case WRONG_OPCODE : return "WRONG_OPCODE";
+            case NATIVE_HOOK  : return "NATIVE_HOOK";
         }
         return "INVALID";
     }
 
 
     static constexpr std::size_t num_registers = 8;
+    static constexpr std::size_t max_operands = 3;
 
 private:
     constexpr InstructionData() = default;
@@ -0,0 +1,809 @@
+#include "jit_compiler.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+#if SYNACOR_JIT_AVAILABLE
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+#if SYNACOR_JIT_AVAILABLE
+
+enum Reg : std::uint8_t
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8,  R9,  R10, R11, R12, R13, R14, R15
+};
+
+enum Condition : std::uint8_t
+{
+    BELOW       = 0x2,
+    ABOVE_EQUAL = 0x3,
+    EQUAL       = 0x4,
+    NOT_EQUAL   = 0x5,
+    ABOVE       = 0x7
+};
+
+// Value of the reg field in the group-1 encodings (81 /n)
+enum AluOp : std::uint8_t
+{
+    ALU_ADD = 0,
+    ALU_OR  = 1,
+    ALU_AND = 4,
+    ALU_SUB = 5,
+    ALU_XOR = 6,
+    ALU_CMP = 7
+};
+
+/**
+ * Minimal x86-64 encoder. All arithmetic is 32-bit, all memory operands use a 32-bit displacement.
+ */
+class Assembler
+{
+public:
+    struct Label { std::size_t id; };
+
+    Label NewLabel()
+    {
+        m_labels.push_back(unbound);
+        return {m_labels.size() - 1};
+    }
+
+    void Bind(Label const label) { m_labels[label.id] = m_code.size(); }
+
+    void Jmp(Label const label)
+    {
+        Emit8(0xE9);
+        EmitFixup(label);
+    }
+
+    void Jcc(Condition const cond, Label const label)
+    {
+        Emit8(0x0F);
+        Emit8(0x80 | cond);
+        EmitFixup(label);
+    }
+
+    void MovImm(Reg const dst, std::uint32_t const imm)
+    {
+        Rex(false, 0, 0, dst);
+        Emit8(0xB8 | (dst & 7));
+        Emit32(imm);
+    }
+
+    void Mov(Reg const dst, Reg const src)
+    {
+        if(dst == src) return;
+        Rex(false, src, 0, dst);
+        Emit8(0x89);
+        ModRMRegister(src, dst);
+    }
+
+    void Mov64(Reg const dst, Reg const src)
+    {
+        Rex(true, src, 0, dst);
+        Emit8(0x89);
+        ModRMRegister(src, dst);
+    }
+
+    void Alu(AluOp const op, Reg const dst, Reg const src)
+    {
+        Rex(false, src, 0, dst);
+        Emit8(static_cast<std::uint8_t>(op * 8 + 1));
+        ModRMRegister(src, dst);
+    }
+
+    void AluImm(AluOp const op, Reg const dst, std::uint32_t const imm)
+    {
+        Rex(false, 0, 0, dst);
+        Emit8(0x81);
+        ModRMRegister(op, dst);
+        Emit32(imm);
+    }
+
+    void Alu64(AluOp const op, Reg const dst, Reg const src)
+    {
+        Rex(true, src, 0, dst);
+        Emit8(static_cast<std::uint8_t>(op * 8 + 1));
+        ModRMRegister(src, dst);
+    }
+
+    // The immediate is sign-extended
+    void AluImm64(AluOp const op, Reg const dst, std::int32_t const imm)
+    {
+        Rex(true, 0, 0, dst);
+        Emit8(0x81);
+        ModRMRegister(op, dst);
+        Emit32(static_cast<std::uint32_t>(imm));
+    }
+
+    void Imul(Reg const dst, Reg const src)
+    {
+        Rex(false, dst, 0, src);
+        Emit8(0x0F);
+        Emit8(0xAF);
+        ModRMRegister(dst, src);
+    }
+
+    // Unsigned division of edx:eax, quotient in eax, remainder in edx
+    void Div(Reg const divisor)
+    {
+        Rex(false, 0, 0, divisor);
+        Emit8(0xF7);
+        ModRMRegister(6, divisor);
+    }
+
+    void Not(Reg const reg)
+    {
+        Rex(false, 0, 0, reg);
+        Emit8(0xF7);
+        ModRMRegister(2, reg);
+    }
+
+    void Test(Reg const lhs, Reg const rhs)
+    {
+        Rex(false, rhs, 0, lhs);
+        Emit8(0x85);
+        ModRMRegister(rhs, lhs);
+    }
+
+    void ShrImm(Reg const reg, std::uint8_t const count)
+    {
+        Rex(false, 0, 0, reg);
+        Emit8(0xC1);
+        ModRMRegister(5, reg);
+        Emit8(count);
+    }
+
+    // dst = cond ? 1 : 0. Clobbers al.
+    void SetCondition(Condition const cond, Reg const dst)
+    {
+        Emit8(0x0F);
+        Emit8(0x90 | cond);
+        ModRMRegister(0, RAX);
+        Rex(false, dst, 0, RAX);
+        Emit8(0x0F);
+        Emit8(0xB6);
+        ModRMRegister(dst, RAX);
+    }
+
+    // mov r64, [base + disp]
+    void Load64(Reg const dst, Reg const base, std::int32_t const disp)
+    {
+        Rex(true, dst, 0, base);
+        Emit8(0x8B);
+        ModRMMemory(dst, base, disp);
+    }
+
+    // mov r64, [base + index*8 + disp]
+    void Load64Indexed(Reg const dst, Reg const base, Reg const index, std::int32_t const disp = 0)
+    {
+        Rex(true, dst, index, base);
+        Emit8(0x8B);
+        ModRMIndexed(dst, base, index, 3, disp);
+    }
+
+    // mov [base + disp], r64
+    void Store64(Reg const base, std::int32_t const disp, Reg const src)
+    {
+        Rex(true, src, 0, base);
+        Emit8(0x89);
+        ModRMMemory(src, base, disp);
+    }
+
+    // mov r32, [base + disp]
+    void Load32(Reg const dst, Reg const base, std::int32_t const disp)
+    {
+        Rex(false, dst, 0, base);
+        Emit8(0x8B);
+        ModRMMemory(dst, base, disp);
+    }
+
+    // mov [base + disp], r32
+    void Store32(Reg const base, std::int32_t const disp, Reg const src)
+    {
+        Rex(false, src, 0, base);
+        Emit8(0x89);
+        ModRMMemory(src, base, disp);
+    }
+
+    // movzx r32, word [base + disp]
+    void LoadWord(Reg const dst, Reg const base, std::int32_t const disp)
+    {
+        Rex(false, dst, 0, base);
+        Emit8(0x0F);
+        Emit8(0xB7);
+        ModRMMemory(dst, base, disp);
+    }
+
+    // movzx r32, word [base + index*2 + disp]
+    void LoadWordIndexed(Reg const dst, Reg const base, Reg const index, std::int32_t const disp = 0)
+    {
+        Rex(false, dst, index, base);
+        Emit8(0x0F);
+        Emit8(0xB7);
+        ModRMIndexed(dst, base, index, 1, disp);
+    }
+
+    // mov word [base + disp], r16
+    void StoreWord(Reg const base, std::int32_t const disp, Reg const src)
+    {
+        Emit8(0x66);
+        Rex(false, src, 0, base);
+        Emit8(0x89);
+        ModRMMemory(src, base, disp);
+    }
+
+    // mov word [base + index*2 + disp], r16
+    void StoreWordIndexed(Reg const base, Reg const index, Reg const src, std::int32_t const disp = 0)
+    {
+        Emit8(0x66);
+        Rex(false, src, index, base);
+        Emit8(0x89);
+        ModRMIndexed(src, base, index, 1, disp);
+    }
+
+    // op dword [base + disp], imm32
+    void AluMemImm(AluOp const op, Reg const base, std::int32_t const disp, std::uint32_t const imm)
+    {
+        Rex(false, 0, 0, base);
+        Emit8(0x81);
+        ModRMMemory(op, base, disp);
+        Emit32(imm);
+    }
+
+    // bt r64, r64: carry flag = bit (bit % 64) of value
+    void BitTest(Reg const value, Reg const bit)
+    {
+        Rex(true, bit, 0, value);
+        Emit8(0x0F);
+        Emit8(0xA3);
+        ModRMRegister(bit, value);
+    }
+
+    // call [base + disp]
+    void CallIndirect(Reg const base, std::int32_t const disp)
+    {
+        Rex(false, 0, 0, base);
+        Emit8(0xFF);
+        ModRMMemory(2, base, disp);
+    }
+
+    void Push(Reg const reg)
+    {
+        Rex(false, 0, 0, reg);
+        Emit8(0x50 | (reg & 7));
+    }
+
+    void Pop(Reg const reg)
+    {
+        Rex(false, 0, 0, reg);
+        Emit8(0x58 | (reg & 7));
+    }
+
+    void AddRsp(std::uint8_t const imm)
+    {
+        Emit8(0x48); Emit8(0x83); Emit8(0xC4); Emit8(imm);
+    }
+
+    void SubRsp(std::uint8_t const imm)
+    {
+        Emit8(0x48); Emit8(0x83); Emit8(0xEC); Emit8(imm);
+    }
+
+    void Ret() { Emit8(0xC3); }
+
+    /**
+     * @brief Resolves jumps to labels and returns the machine code.
+     */
+    std::vector<std::uint8_t> const& Finish()
+    {
+        for(auto const& [position, label] : m_fixups)
+        {
+            const auto rel = static_cast<std::int32_t>(m_labels[label] - (position + 4));
+            std::memcpy(&m_code[position], &rel, sizeof(rel));
+        }
+        m_fixups.clear();
+        return m_code;
+    }
+
+private:
+    static constexpr std::size_t unbound = ~std::size_t{0};
+
+    void Emit8(std::uint8_t const byte) { m_code.push_back(byte); }
+
+    void Emit32(std::uint32_t const value)
+    {
+        for(std::size_t i=0; i < 4; ++i) Emit8(static_cast<std::uint8_t>(value >> (8*i)));
+    }
+
+    void EmitFixup(Label const label)
+    {
+        m_fixups.push_back({m_code.size(), label.id});
+        Emit32(0);
+    }
+
+    // Emitted only if needed
+    void Rex(bool const wide, std::uint8_t const reg, std::uint8_t const index, std::uint8_t const base)
+    {
+        const std::uint8_t rex = static_cast<std::uint8_t>(0x40 | (wide << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3));
+        if(rex != 0x40) Emit8(rex);
+    }
+
+    void ModRMRegister(std::uint8_t const reg, std::uint8_t const rm)
+    {
+        Emit8(static_cast<std::uint8_t>(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+    }
+
+    void ModRMMemory(std::uint8_t const reg, std::uint8_t const base, std::int32_t const disp)
+    {
+        Emit8(static_cast<std::uint8_t>(0x80 | ((reg & 7) << 3) | (base & 7)));
+        if((base & 7) == RSP) Emit8(0x24);
+        Emit32(static_cast<std::uint32_t>(disp));
+    }
+
+    void ModRMIndexed(std::uint8_t const reg, std::uint8_t const base, std::uint8_t const index, std::uint8_t const scale, std::int32_t const disp)
+    {
+        Emit8(static_cast<std::uint8_t>(0x80 | ((reg & 7) << 3) | RSP));
+        Emit8(static_cast<std::uint8_t>((scale << 6) | ((index & 7) << 3) | (base & 7)));
+        Emit32(static_cast<std::uint32_t>(disp));
+    }
+
+    std::vector<std::uint8_t> m_code;
+    std::vector<std::size_t> m_labels;
+    std::vector<std::pair<std::size_t, std::size_t>> m_fixups; // Position of rel32, label
+};
+
+// Fixed roles of host registers inside a block
+constexpr Reg context_reg = RBP;
+constexpr Reg memory_reg = RBX;
+constexpr Reg callee_saved[] = {RBX, RBP, R12, R13, R14, R15};
+constexpr Reg caller_saved[] = {R8, R9, R10, R11}; // Those that hold registers of the virtual machine
+
+constexpr Reg HostRegister(Operand const& arg) noexcept
+{
+    return static_cast<Reg>(R8 + arg.value.to_int());
+}
+
+constexpr std::int32_t Offset(std::size_t const offset) noexcept
+{
+    return static_cast<std::int32_t>(offset);
+}
+
+/**
+ * Translates the instructions of one block.
+ */
+class BlockCompiler
+{
+public:
+    explicit BlockCompiler(bool const checked)
+        : m_checked(checked), m_epilogue(m_asm.NewLabel())
+    { }
+
+    void Prologue()
+    {
+        for(Reg reg: callee_saved) m_asm.Push(reg);
+        m_asm.SubRsp(8); // Align the stack for calls, and keep one scratch slot at [rsp]
+        m_asm.Mov64(context_reg, RDI);
+        m_asm.Load64(memory_reg, context_reg, Offset(offsetof(JitContext, memory_pages)));
+        m_asm.Load64(RAX, context_reg, Offset(offsetof(JitContext, registers)));
+        for(std::uint8_t i=0; i < InstructionData::num_registers; ++i)
+        {
+            m_asm.LoadWord(static_cast<Reg>(R8 + i), RAX, 2 * i);
+        }
+    }
+
+    /**
+     * @brief Emits the instruction at ip.
+     * @returns false if it cannot be compiled, in which case nothing was emitted.
+     */
+    bool Emit(DecodedInstruction const& instr, raw_word_t const ip)
+    {
+        if(instr.may_fault) return false;
+
+        const raw_word_t next = static_cast<raw_word_t>((ip + instr.length) % Word::max_word);
+        auto const& args = instr.args;
+
+        switch(instr.opcode)
+        {
+            case InstructionData::SET:
+                LoadValue(HostRegister(args[0]), args[1]);
+                return true;
+
+            case InstructionData::ADD:  EmitArithmetic(ALU_ADD, args, true);  return true;
+            case InstructionData::AND:  EmitArithmetic(ALU_AND, args, false); return true;
+            case InstructionData::OR:   EmitArithmetic(ALU_OR,  args, false); return true;
+
+            case InstructionData::MULT:
+                LoadValue(RAX, args[1]);
+                LoadValue(RCX, args[2]);
+                m_asm.Imul(RAX, RCX);
+                m_asm.AluImm(ALU_AND, RAX, Word::max_word - 1);
+                m_asm.Mov(HostRegister(args[0]), RAX);
+                return true;
+
+            case InstructionData::MOD:
+                if(args[2].type == InstructionData::LITERAL && args[2].value.is_zero()) return false;
+                LoadValue(RAX, args[1]);
+                LoadValue(RCX, args[2]);
+                if(args[2].type == InstructionData::REGISTER)
+                {
+                    m_asm.Test(RCX, RCX);
+                    SideExitIf(EQUAL, ip); // Division by zero is left to the interpreter
+                }
+                m_asm.Alu(ALU_XOR, RDX, RDX);
+                m_asm.Div(RCX);
+                m_asm.Mov(HostRegister(args[0]), RDX);
+                return true;
+
+            case InstructionData::NOT:
+                LoadValue(RAX, args[1]);
+                m_asm.Not(RAX);
+                m_asm.AluImm(ALU_AND, RAX, Word::max_word - 1);
+                m_asm.Mov(HostRegister(args[0]), RAX);
+                return true;
+
+            case InstructionData::EQ: EmitComparison(EQUAL, args); return true;
+            case InstructionData::GT: EmitComparison(ABOVE, args); return true;
+
+            case InstructionData::RMEM:
+                if(args[1].type == InstructionData::LITERAL)
+                {
+                    const raw_word_t address = args[1].value.to_int();
+                    m_asm.Load64(RAX, memory_reg, Offset(8 * (address / Memory::page_size)));
+                    m_asm.LoadWord(HostRegister(args[0]), RAX, Offset(Memory::Pages::page_offset + 2 * (address % Memory::page_size)));
+                    return true;
+                }
+                LoadAddress(RAX, args[1], ip);
+                EmitPageLookup(RSI, memory_reg, RAX);
+                m_asm.AluImm(ALU_AND, RAX, Memory::page_size - 1);
+                m_asm.LoadWordIndexed(HostRegister(args[0]), RSI, RAX, Offset(Memory::Pages::page_offset));
+                return true;
+
+            case InstructionData::WMEM:
+                LoadAddress(RAX, args[0], ip);
+                LoadValue(RCX, args[1]);
+                EmitWrite([&]{ Exit(next); });
+                return true;
+
+            case InstructionData::PUSH:
+                LoadValue(RCX, args[0]);
+                EmitPush(ip);
+                return true;
+
+            case InstructionData::POP:
+                EmitPeek(ip);
+                m_asm.LoadWord(HostRegister(args[0]), RAX, 0);
+                m_asm.Store64(RDX, 0, RAX);
+                return true;
+
+            case InstructionData::NOOP:
+                return true;
+
+            case InstructionData::JMP:
+                EmitJump(args[0], ip);
+                return true;
+
+            case InstructionData::JT:
+            case InstructionData::JF:
+            {
+                const bool jump_if_zero = instr.opcode == InstructionData::JF;
+                if(args[0].type == InstructionData::LITERAL)
+                {
+                    if(args[0].value.is_zero() == jump_if_zero) EmitJump(args[1], ip);
+                    else Exit(next);
+                    return true;
+                }
+                auto taken = m_asm.NewLabel();
+                m_asm.Test(HostRegister(args[0]), HostRegister(args[0]));
+                m_asm.Jcc(jump_if_zero ? EQUAL : NOT_EQUAL, taken);
+                Exit(next);
+                m_asm.Bind(taken);
+                EmitJump(args[1], ip);
+                return true;
+            }
+
+            case InstructionData::CALL:
+                // The target is checked before the stack is touched, and kept in the scratch slot
+                LoadAddress(RAX, args[0], ip);
+                m_asm.Store32(RSP, 0, RAX);
+                m_asm.MovImm(RCX, next);
+                EmitPush(ip);
+                m_asm.Load32(RSI, RSP, 0);
+                m_asm.Jmp(m_epilogue);
+                return true;
+
+            case InstructionData::RET:
+                EmitPeek(ip);
+                m_asm.LoadWord(RSI, RAX, 0);
+                CheckAddress(RSI, ip);
+                m_asm.Store64(RDX, 0, RAX);
+                m_asm.Jmp(m_epilogue);
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * @brief Leaves the block, to continue at ptr.
+     */
+    void Exit(std::uint32_t const ptr)
+    {
+        m_asm.MovImm(RSI, ptr);
+        m_asm.Jmp(m_epilogue);
+    }
+
+    std::vector<std::uint8_t> const& Finish()
+    {
+        m_asm.Bind(m_epilogue);
+        m_asm.Load64(RAX, context_reg, Offset(offsetof(JitContext, registers)));
+        for(std::uint8_t i=0; i < InstructionData::num_registers; ++i)
+        {
+            m_asm.StoreWord(RAX, 2 * i, static_cast<Reg>(R8 + i));
+        }
+        m_asm.Mov(RAX, RSI);
+        m_asm.AddRsp(8);
+        for(auto it = std::rbegin(callee_saved); it != std::rend(callee_saved); ++it) m_asm.Pop(*it);
+        m_asm.Ret();
+        return m_asm.Finish();
+    }
+
+private:
+    void LoadValue(Reg const dst, Operand const& arg)
+    {
+        if(arg.type == InstructionData::REGISTER) m_asm.Mov(dst, HostRegister(arg));
+        else m_asm.MovImm(dst, arg.value.to_int());
+    }
+
+    void SideExitIf(Condition const cond, raw_word_t const ip)
+    {
+        auto skip = m_asm.NewLabel();
+        m_asm.Jcc(static_cast<Condition>(cond ^ 1), skip); // Conditions come in pairs that differ in the last bit
+        Exit(ip | JitCompiler::side_exit);
+        m_asm.Bind(skip);
+    }
+
+    /**
+     * @brief Same as VirtualMachine::ToAddress: addresses out of memory are errors
+     *        under checked execution, and wrap around otherwise.
+     */
+    void CheckAddress(Reg const reg, raw_word_t const ip)
+    {
+        if(m_checked)
+        {
+            m_asm.AluImm(ALU_CMP, reg, Word::max_word - 1);
+            SideExitIf(ABOVE, ip);
+        } else {
+            m_asm.AluImm(ALU_AND, reg, Word::max_word - 1);
+        }
+    }
+
+    void LoadAddress(Reg const dst, Operand const& arg, raw_word_t const ip)
+    {
+        LoadValue(dst, arg);
+        if(arg.type == InstructionData::REGISTER) CheckAddress(dst, ip);
+    }
+
+    void EmitArithmetic(AluOp const op, std::array<Operand, InstructionData::max_operands> const& args, bool const modular)
+    {
+        LoadValue(RAX, args[1]);
+        if(args[2].type == InstructionData::REGISTER) m_asm.Alu(op, RAX, HostRegister(args[2]));
+        else m_asm.AluImm(op, RAX, args[2].value.to_int());
+        if(modular) m_asm.AluImm(ALU_AND, RAX, Word::max_word - 1);
+        m_asm.Mov(HostRegister(args[0]), RAX);
+    }
+
+    void EmitComparison(Condition const cond, std::array<Operand, InstructionData::max_operands> const& args)
+    {
+        LoadValue(RCX, args[1]);
+        if(args[2].type == InstructionData::REGISTER) m_asm.Alu(ALU_CMP, RCX, HostRegister(args[2]));
+        else m_asm.AluImm(ALU_CMP, RCX, args[2].value.to_int());
+        m_asm.SetCondition(cond, HostRegister(args[0]));
+    }
+
+    void EmitJump(Operand const& target, raw_word_t const ip)
+    {
+        if(target.type == InstructionData::LITERAL)
+        {
+            Exit(target.value.to_int());
+            return;
+        }
+        m_asm.Mov(RSI, HostRegister(target));
+        CheckAddress(RSI, ip);
+        m_asm.Jmp(m_epilogue);
+    }
+
+    /**
+     * @brief Leaves a pointer to the top word of the stack in rax, and a pointer to the
+     *        top of the stack in rdx. The stack is not modified. Popping an empty stack
+     *        is left to the interpreter.
+     */
+    void EmitPeek(raw_word_t const ip)
+    {
+        m_asm.Load64(RDX, context_reg, Offset(offsetof(JitContext, stack_top)));
+        m_asm.Load64(RAX, RDX, 0);
+        m_asm.Load64(RCX, context_reg, Offset(offsetof(JitContext, stack_begin)));
+        m_asm.Load64(RCX, RCX, 0);
+        m_asm.Alu64(ALU_CMP, RAX, RCX);
+        SideExitIf(EQUAL, ip); // Stack underflow
+        m_asm.AluImm64(ALU_SUB, RAX, 2);
+    }
+
+    /**
+     * @brief Pushes ecx onto the stack, raising the high-water mark if the top goes past it.
+     *        Growing the buffer is left to the interpreter.
+     */
+    void EmitPush(raw_word_t const ip)
+    {
+        auto below_mark = m_asm.NewLabel();
+
+        m_asm.Load64(RDX, context_reg, Offset(offsetof(JitContext, stack_top)));
+        m_asm.Load64(RAX, RDX, 0);
+        m_asm.Load64(RSI, context_reg, Offset(offsetof(JitContext, stack_capacity)));
+        m_asm.Load64(RSI, RSI, 0);
+        m_asm.Alu64(ALU_CMP, RAX, RSI);
+        SideExitIf(EQUAL, ip);
+        m_asm.StoreWord(RAX, 0, RCX);
+        m_asm.AluImm64(ALU_ADD, RAX, 2);
+        m_asm.Store64(RDX, 0, RAX);
+
+        m_asm.Load64(RSI, context_reg, Offset(offsetof(JitContext, stack_end)));
+        m_asm.Load64(RDX, RSI, 0);
+        m_asm.Alu64(ALU_CMP, RDX, RAX);
+        m_asm.Jcc(ABOVE_EQUAL, below_mark);
+        m_asm.Store64(RSI, 0, RAX);
+        m_asm.Bind(below_mark);
+    }
+
+    /**
+     * @brief Leaves in dst the pointer to the page that holds the address in src, out of the
+     *        table of pages at table. Pages of the memory and of the decode cache cover the same addresses.
+     */
+    void EmitPageLookup(Reg const dst, Reg const table, Reg const src)
+    {
+        static_assert(Memory::page_size == DecodeCache::page_size && std::has_single_bit(Memory::page_size));
+        m_asm.Mov(RDX, src);
+        m_asm.ShrImm(RDX, static_cast<std::uint8_t>(std::countr_zero(Memory::page_size)));
+        m_asm.Load64Indexed(dst, table, RDX);
+    }
+
+    /**
+     * @brief Writes ecx to the address in eax. Words that hold decoded code, and words in pages
+     *        shared with other machines, are written by the virtual machine, so that stale code
+     *        is dropped and shared pages are copied. The block is then left through the code
+     *        emitted by exit, as it may have overwritten itself.
+     */
+    template<typename TExit>
+    void EmitWrite(TExit const& exit)
+    {
+        static constexpr std::size_t is_code_offset = DecodeCache::Pages::page_offset + offsetof(DecodeCache::Page, is_code);
+
+        auto write_code = m_asm.NewLabel();
+        auto done = m_asm.NewLabel();
+
+        m_asm.Load64(RSI, context_reg, Offset(offsetof(JitContext, code_pages)));
+        EmitPageLookup(RSI, RSI, RAX);
+        m_asm.Mov(RDX, RAX);
+        m_asm.AluImm(ALU_AND, RDX, DecodeCache::page_size - 1);
+        m_asm.ShrImm(RDX, 6);
+        m_asm.Load64Indexed(RSI, RSI, RDX, Offset(is_code_offset));
+        m_asm.BitTest(RSI, RAX);
+        m_asm.Jcc(BELOW, write_code); // Carry is set if the word is code
+
+        EmitPageLookup(RSI, memory_reg, RAX);
+        m_asm.AluMemImm(ALU_CMP, RSI, Offset(Memory::Pages::refs_offset), 1);
+        m_asm.Jcc(NOT_EQUAL, write_code); // The page is shared
+        m_asm.Mov(RDX, RAX);
+        m_asm.AluImm(ALU_AND, RDX, Memory::page_size - 1);
+        m_asm.StoreWordIndexed(RSI, RDX, RCX, Offset(Memory::Pages::page_offset));
+        m_asm.Jmp(done);
+
+        m_asm.Bind(write_code);
+        for(Reg reg: caller_saved) m_asm.Push(reg);
+        m_asm.Load64(RDI, context_reg, Offset(offsetof(JitContext, vm)));
+        m_asm.Mov(RSI, RAX);
+        m_asm.Mov(RDX, RCX);
+        m_asm.CallIndirect(context_reg, Offset(offsetof(JitContext, write_code)));
+        for(auto it = std::rbegin(caller_saved); it != std::rend(caller_saved); ++it) m_asm.Pop(*it);
+        exit();
+
+        m_asm.Bind(done);
+    }
+
+    Assembler m_asm;
+    bool m_checked;
+    Assembler::Label m_epilogue;
+};
+
+#endif
+
+}
+
+JitCompiler::JitCompiler()
+    : m_blocks(Word::max_word, nullptr), m_run_counts(Word::max_word, 0)
+{
+#if SYNACOR_JIT_AVAILABLE
+    void* code = mmap(nullptr, code_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(code != MAP_FAILED) m_code = static_cast<std::uint8_t*>(code);
+#endif
+}
+
+JitCompiler::~JitCompiler()
+{
+#if SYNACOR_JIT_AVAILABLE
+    if(m_code) munmap(m_code, code_capacity);
+#endif
+}
+
+bool JitCompiler::Compile([[maybe_unused]] DecodeCache& cache, [[maybe_unused]] Memory const& memory,
+                          [[maybe_unused]] Address const ptr, [[maybe_unused]] bool const checked)
+{
+#if SYNACOR_JIT_AVAILABLE
+    if(!m_code) return false;
+
+    BlockCompiler compiler(checked);
+    compiler.Prologue();
+
+    const raw_word_t begin = ptr.get().to_int();
+    raw_word_t end = begin;
+    for(std::size_t i=0; i < max_block_instructions; ++i)
+    {
+        DecodedInstruction const& instr = cache.Fetch(memory, end);
+        if(!compiler.Emit(instr, end))
+        {
+            if(i == 0) return false;
+            compiler.Exit(end);
+            break;
+        }
+
+        end = static_cast<raw_word_t>(end + instr.length);
+        if(instr.opcode == InstructionData::JMP || instr.opcode == InstructionData::JT || instr.opcode == InstructionData::JF
+            || instr.opcode == InstructionData::CALL || instr.opcode == InstructionData::RET) break;
+
+        if(end >= Word::max_word || i + 1 == max_block_instructions)
+        {
+            compiler.Exit(end % Word::max_word);
+            break;
+        }
+    }
+
+    auto const& code = compiler.Finish();
+    if(m_code_size + code.size() > code_capacity) return false;
+
+    if(mprotect(m_code, code_capacity, PROT_READ | PROT_WRITE) != 0) return false;
+    std::uint8_t* const entry = m_code + m_code_size;
+    std::memcpy(entry, code.data(), code.size());
+    m_code_size += code.size();
+    if(mprotect(m_code, code_capacity, PROT_READ | PROT_EXEC) != 0) return false;
+
+    m_blocks[begin] = reinterpret_cast<Block>(entry);
+    m_ranges.push_back({begin, std::min<raw_word_t>(end, Word::max_word)});
+    return true;
+#else
+    return false;
+#endif
+}
+
+void JitCompiler::Invalidate(Address const ptr) noexcept
+{
+    const raw_word_t raw_ptr = ptr.get().to_int();
+    for(std::size_t i=0; i < m_ranges.size();)
+    {
+        Range const range = m_ranges[i];
+        if(raw_ptr < range.begin || raw_ptr >= range.end)
+        {
+            ++i;
+            continue;
+        }
+        m_blocks[range.begin] = nullptr;
+        m_run_counts[range.begin] = 0;
+        m_ranges[i] = m_ranges.back();
+        m_ranges.pop_back();
+    }
+}
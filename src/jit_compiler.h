@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "address.h"
+#include "decode_cache.h"
+#include "virtual_memory.h"
+#include "word.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define SYNACOR_JIT_AVAILABLE 1
+#else
+#define SYNACOR_JIT_AVAILABLE 0
+#endif
+
+/**
+ * Everything a compiled block needs to reach the state of the virtual machine.
+ * Words are accessed as plain 16-bit integers.
+ */
+struct JitContext
+{
+    std::uint16_t* registers;            // The eight general-purpose registers
+    void const* memory_pages;            // Memory::Pages::table()
+    std::uint16_t** stack_top;           // See CallStack: one past the last word pushed
+    std::uint16_t* const* stack_begin;
+    std::uint16_t** stack_end;           // High-water mark, raised by pushes that go past it
+    std::uint16_t* const* stack_capacity; // Pushing here is left to the interpreter
+    void const* code_pages;              // DecodeCache::Pages::table(), whose is_code bitmaps tell which words may hold decoded code
+    void* vm;
+    void (*write_code)(void* vm, std::uint32_t address, std::uint32_t value); // Writes a word that may hold code
+};
+
+/**
+ * Compiles hot basic blocks to native x86-64 code.
+ * While a block runs, the registers of the virtual machine live in host registers r8 -- r15.
+ *
+ * A block stops before any instruction it cannot compile (IN, OUT, HALT, or any instruction
+ * whose operands may fault) and returns the address of that instruction, so that the
+ * interpreter takes over. Under checked execution, a block also stops before any instruction
+ * that would raise an error, and returns its address tagged with side_exit. That instruction
+ * must then be run by the interpreter.
+ */
+class JitCompiler
+{
+public:
+    using Block = std::uint32_t (*)(JitContext*);
+
+    static constexpr bool is_available = SYNACOR_JIT_AVAILABLE;
+    static constexpr std::uint32_t side_exit = 1u << 16;
+    static constexpr std::uint32_t hot_threshold = 256;     // Number of interpreted runs before an address is compiled
+    static constexpr std::size_t max_block_instructions = 64;
+    static constexpr std::size_t code_capacity = 16 << 20; // Bytes of native code. No more blocks are compiled once full.
+
+    JitCompiler();
+    ~JitCompiler();
+
+    JitCompiler(JitCompiler const&) = delete;
+    JitCompiler& operator=(JitCompiler const&) = delete;
+
+    Block Find(Address const ptr) const noexcept
+    {
+        return m_blocks[ptr.get().to_int()];
+    }
+
+    /**
+     * @brief Counts one interpreted run of the instruction at ptr.
+     * @returns true when it becomes hot
+     */
+    bool CountRun(Address const ptr) noexcept
+    {
+        return ++m_run_counts[ptr.get().to_int()] == hot_threshold;
+    }
+
+    /**
+     * @brief Compiles the block that starts at ptr.
+     * @returns false if not even the first instruction could be compiled, or there is no space left.
+     */
+    bool Compile(DecodeCache& cache, Memory const& memory, Address ptr, bool checked);
+
+    /**
+     * @brief Drops every block that contains the word at ptr.
+     */
+    void Invalidate(Address const ptr) noexcept;
+
+    std::size_t num_blocks() const noexcept { return m_ranges.size(); }
+
+private:
+    struct Range
+    {
+        raw_word_t begin;
+        raw_word_t end; // One past the last word of the block
+    };
+
+    std::vector<Block> m_blocks;             // Indexed by address of the first instruction
+    std::vector<std::uint32_t> m_run_counts; // Indexed by address
+    std::vector<Range> m_ranges;             // Words covered by each live block
+
+    std::uint8_t* m_code = nullptr;          // Executable memory
+    std::size_t m_code_size = 0;
+};
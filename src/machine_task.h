@@ -0,0 +1,67 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+/**
+ * Coroutine that runs a virtual machine, as returned by BasicVirtualMachine::RunAsync.
+ * It runs as soon as it is created, and suspends whenever the machine needs input that
+ * the host has not provided yet. The host then provides it and resumes the task, so that
+ * a single thread can drive any number of machines, each one waiting on its own input.
+ */
+class MachineTask
+{
+public:
+    struct promise_type
+    {
+        MachineTask get_return_object() noexcept { return MachineTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_always final_suspend() const noexcept { return {}; } // So that done() can be asked
+        void return_void() const noexcept {}
+        void unhandled_exception() const { std::rethrow_exception(std::current_exception()); }
+    };
+
+    MachineTask(MachineTask&& other) noexcept
+        : m_handle(std::exchange(other.m_handle, nullptr))
+    { }
+
+    MachineTask& operator=(MachineTask&& other) noexcept
+    {
+        if(this != &other)
+        {
+            if(m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    MachineTask(MachineTask const&) = delete;
+    MachineTask& operator=(MachineTask const&) = delete;
+
+    ~MachineTask()
+    {
+        if(m_handle) m_handle.destroy();
+    }
+
+    /**
+     * @brief Whether the machine has stopped for good: halted, or stopped by an error.
+     */
+    bool done() const noexcept { return !m_handle || m_handle.done(); }
+
+    /**
+     * @brief Continues running the machine, after the host has provided input. Without any,
+     *        the task suspends again straight away. No-op once done.
+     */
+    void resume() const
+    {
+        if(!done()) m_handle.resume();
+    }
+
+private:
+    explicit MachineTask(std::coroutine_handle<promise_type> const handle) noexcept
+        : m_handle(handle)
+    { }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
@@ -1,35 +1,359 @@
 #include <cstdio>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <optional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "async_io.h"
+#include "debugger.h"
+#include "image_cache.h"
+#include "trace.h"
 #include "virtual_machine.h"
 #include "word.h"
 
 void Help()
 {
     std::cout << "          SYNACOR CHALLENGE VIRTUAL MACHINE\n";
-    std::cout << "In order to run, pass the name of the program as the only argument\n";
+    std::cout << "In order to run, pass the name of the program as the last argument, or resume from a snapshot\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --threaded   Use the direct-threaded interpreter loop\n";
+    std::cout << "  --unchecked  Skip runtime validity checks (for known-good programs)\n";
+    std::cout << "  --jit        Compile hot basic blocks to native code (x86-64 Linux only)\n";
+    std::cout << "  --async-io   Read input and write output on a separate thread (Unix only)\n";
+    std::cout << "  --fusion-report  Print which superinstructions were executed, and how often\n";
+    std::cout << "  --profile FILE   Count executions per address and opcode, print the hottest and dump them all to FILE as CSV\n";
+    std::cout << "  --flamegraph FILE  Follow calls and returns, and write instructions per chain of calls to FILE\n";
+    std::cout << "                   in the collapsed-stack format of flamegraph.pl, and print the hottest subroutines\n";
+    std::cout << "                   Both run one instruction at a time, without --threaded, --jit or superinstructions\n";
+    std::cout << "  --trace FILE     Write a fixed-size record of every instruction executed to FILE, for trace_viewer\n";
+    std::cout << "                   Runs one instruction at a time, without --threaded, --jit, superinstructions or --cache-dir\n";
+    std::cout << "  --debug      Run under an interactive debugger with breakpoints. Type help at its prompt\n";
+    std::cout << "  --memoize    Cache the results of pure subroutines, and print statistics\n";
+    std::cout << "  --stack-limit N  Maximum number of words on the stack (default " << CallStack::default_limit << ")\n";
+    std::cout << "  --resume FILE    Continue from a snapshot instead of loading a program\n";
+    std::cout << "  --snapshot-on-halt FILE  Save the state of the machine once it stops\n";
+    std::cout << "  --script FILE    Read input from FILE before stdin. May be given more than once\n";
+    std::cout << "  --on-script-end halt|snapshot|stdin  What to do once the scripts are over (default halt).\n";
+    std::cout << "                   snapshot stops at the IN, so that --snapshot-on-halt resumes there\n";
+    std::cout << "  --cache-dir DIR  Save the machine at its first IN, and start from there next time\n";
+    std::cout << "  --cache-every-line  With --cache-dir, also save the machine after each line of input\n";
     std::cout << std::endl;
 }
 
-int main(int argc, char * argv[])
+struct Options
+{
+    char const * program = nullptr;
+    char const * resume = nullptr;
+    char const * snapshot_on_halt = nullptr;
+    char const * profile = nullptr;
+    char const * flamegraph = nullptr;
+    char const * trace = nullptr;
+    char const * cache_dir = nullptr;
+    bool cache_every_line = false;
+    std::vector<char const *> scripts;
+    ScriptEnd script_end = ScriptEnd::HALT;
+    bool threaded = false;
+    bool unchecked = false;
+    bool jit = false;
+    bool async_io = false;
+    bool fusion_report = false;
+    bool memoize = false;
+    bool debug = false;
+    std::size_t stack_limit = CallStack::default_limit;
+};
+
+template<typename TVirtualMachine>
+void Resume(TVirtualMachine& vm, Options const& options)
+{
+    if(options.jit)             vm.ResumeJit();
+    else if(options.threaded)   vm.ResumeThreaded();
+    else                        vm.Resume();
+}
+
+/**
+ * @brief Runs the machine one line of input at a time, starting each stretch from the cache
+ *        when an earlier run already went through it with the same input.
+ *        Output is written once the machine stops for input.
+ */
+template<typename TVirtualMachine>
+void ResumeCached(TVirtualMachine& vm, Options const& options, ImageCache const& cache, ImageCache::Key key, OutputSink& output)
+{
+    vm.PauseOnInput(true);
+    bool restored = cache.Restore(key, vm, output);
+
+    CaptureSink segment;
+    while(true)
+    {
+        segment.Clear();
+        vm.SetOutput(segment);
+        Resume(vm, options);
+        vm.SetOutput(output);
+        output.Put(segment.text());
+        output.Flush();
+
+        if(!vm.IsAwaitingInput()) return;
+        if(!restored) cache.Store(key, vm, segment.text());
+
+        const std::optional<std::string_view> line = options.cache_every_line ? vm.BufferNextLine() : std::nullopt;
+        if(!line)
+        {
+            vm.PauseOnInput(false);
+            Resume(vm, options);
+            return;
+        }
+
+        key = ImageCache::Extend(key, *line);
+        restored = cache.Restore(key, vm, output);
+    }
+}
+
+template<typename TVirtualMachine>
+int RunProgram(Options const& options)
 {
-    switch(argc)
+    FileDescriptorSink standard_output(1);
+    OutputSink* output = &standard_output;
+    TVirtualMachine vm;
+#if SYNACOR_ASYNC_IO_AVAILABLE
+    std::optional<AsyncIo> async_io;
+    if(options.async_io)
+    {
+        async_io.emplace(0, 1);
+        vm.SetInput(async_io->input());
+        output = &async_io->output();
+    }
+#endif
+    vm.SetOutput(*output);
+
+    char const * const image = options.resume ? options.resume : options.program;
+    const MappedFile file(image);
+    if(!file)
     {
-        case 1: Help(); return EXIT_SUCCESS;
-        case 2: break;
-        default: Help(); return EXIT_FAILURE;
+        std::cerr << "Failed to open " << image << std::endl;
+        return EXIT_FAILURE;
     }
 
-	VirtualMachine vm;
+    if(options.resume)
+    {
+        if(!vm.LoadSnapshot(file.data()))
+        {
+            std::cerr << "Failed to resume from " << options.resume << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else {
+        auto program = typename TVirtualMachine::program_file_t(options.program, std::ios::binary);
+        vm.LoadMemory(program);
+        vm.SetStackLimit(options.stack_limit);
+        vm.Start();
+    }
+    if(options.memoize) vm.EnableMemoization();
 
-    auto program = VirtualMachine::program_file_t(argv[1], std::ios::binary);
+    std::deque<MappedFile> scripts;
+    for(char const * const path: options.scripts)
+    {
+        if(!scripts.emplace_back(path))
+        {
+            std::cerr << "Failed to open " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+        const std::span<std::byte const> text = scripts.back().data();
+        vm.AppendScript(std::string_view(reinterpret_cast<char const*>(text.data()), text.size()));
+    }
+    if(!scripts.empty()) vm.SetScriptEnd(options.script_end);
 
-    vm.LoadMemory(program);
+    std::optional<TraceWriter> trace;
+    if(options.trace && !trace.emplace(options.trace))
+    {
+        std::cerr << "Failed to open " << options.trace << std::endl;
+        return EXIT_FAILURE;
+    }
 
-    std::cout << ">> Program output:\n";
-    vm.Run();
+    std::cout << ">> Program output:\n" << std::flush;
+    if(options.debug)           Debugger(vm, std::cin, std::cout).Run();
+    else if(trace)              vm.ResumeTraced(*trace);
+    else if(options.cache_dir)  ResumeCached(vm, options, ImageCache(options.cache_dir), ImageCache::Hash(file.data()), *output);
+    else                        Resume(vm, options);
+    vm.FlushOutput();
+#if SYNACOR_ASYNC_IO_AVAILABLE
+    if(async_io) async_io->Sync();
+#endif
 
     std::cout << "\n>> VM exit state:\n";
     vm.Print();
 
+    if(trace)
+    {
+        trace->Close();
+        if(!*trace)
+        {
+            std::cerr << "Failed to write " << options.trace << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Traced " << trace->size() << " instructions to " << options.trace << std::endl;
+    }
+
+    if(options.fusion_report) vm.PrintFusionReport(std::cout);
+    if constexpr(requires { vm.profile(); })
+    {
+        vm.profile().PrintReport(std::cout);
+        if(options.profile)
+        {
+            std::ofstream dump(options.profile);
+            vm.profile().WriteDump(dump);
+            if(!dump)
+            {
+                std::cerr << "Failed to write " << options.profile << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        if(options.flamegraph)
+        {
+            std::ofstream stacks(options.flamegraph);
+            vm.profile().call_graph().WriteCollapsedStacks(stacks);
+            if(!stacks)
+            {
+                std::cerr << "Failed to write " << options.flamegraph << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    if(options.memoize) vm.PrintMemoizationReport(std::cout);
+
+    if(options.snapshot_on_halt)
+    {
+        std::ofstream snapshot(options.snapshot_on_halt, std::ios::binary);
+        vm.SaveSnapshot(snapshot);
+        if(!snapshot)
+        {
+            std::cerr << "Failed to write " << options.snapshot_on_halt << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+
+int main(int argc, char * argv[])
+{
+    if(argc == 1)
+    {
+        Help();
+        return EXIT_SUCCESS;
+    }
+
+    Options options;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string_view option = argv[i];
+        const bool has_value = i + 1 < argc;
+        if(option == "--threaded")
+        {
+            options.threaded = true;
+            continue;
+        }
+        if(option == "--unchecked")
+        {
+            options.unchecked = true;
+            continue;
+        }
+        if(option == "--jit")
+        {
+            options.jit = true;
+            continue;
+        }
+        if(option == "--async-io")
+        {
+            options.async_io = true;
+            continue;
+        }
+        if(option == "--memoize")
+        {
+            options.memoize = true;
+            continue;
+        }
+        if(option == "--debug")
+        {
+            options.debug = true;
+            continue;
+        }
+        if(option == "--fusion-report")
+        {
+            options.fusion_report = true;
+            continue;
+        }
+        if(option == "--stack-limit" && has_value)
+        {
+            char* end;
+            options.stack_limit = std::strtoull(argv[++i], &end, 10);
+            if(*end == '\0') continue;
+        }
+        if(option == "--resume" && has_value)
+        {
+            options.resume = argv[++i];
+            continue;
+        }
+        if(option == "--profile" && has_value)
+        {
+            options.profile = argv[++i];
+            continue;
+        }
+        if(option == "--flamegraph" && has_value)
+        {
+            options.flamegraph = argv[++i];
+            continue;
+        }
+        if(option == "--trace" && has_value)
+        {
+            options.trace = argv[++i];
+            continue;
+        }
+        if(option == "--snapshot-on-halt" && has_value)
+        {
+            options.snapshot_on_halt = argv[++i];
+            continue;
+        }
+        if(option == "--script" && has_value)
+        {
+            options.scripts.push_back(argv[++i]);
+            continue;
+        }
+        if(option == "--on-script-end" && has_value)
+        {
+            const std::string_view action = argv[++i];
+            if(action == "halt")     options.script_end = ScriptEnd::HALT;
+            if(action == "snapshot") options.script_end = ScriptEnd::PAUSE;
+            if(action == "stdin")    options.script_end = ScriptEnd::READ_STREAM;
+            if(action == "halt" || action == "snapshot" || action == "stdin") continue;
+        }
+        if(option == "--cache-dir" && has_value)
+        {
+            options.cache_dir = argv[++i];
+            continue;
+        }
+        if(option == "--cache-every-line")
+        {
+            options.cache_every_line = true;
+            continue;
+        }
+        if(i == argc - 1 && !option.starts_with("--"))
+        {
+            options.program = argv[i];
+            continue;
+        }
+
+        Help();
+        return EXIT_FAILURE;
+    }
+
+    if((options.program == nullptr) == (options.resume == nullptr))
+    {
+        Help();
+        return EXIT_FAILURE;
+    }
+
+    if(options.profile || options.flamegraph) return RunProgram<ProfiledVirtualMachine>(options);
+    if(options.unchecked)   return RunProgram<UncheckedVirtualMachine>(options);
+    else                    return RunProgram<VirtualMachine>(options);
+}
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "address.h"
+#include "decode_cache.h"
+#include "instruction.h"
+#include "virtual_memory.h"
+#include "word.h"
+
+/**
+ * Caches the results of pure subroutines, keyed by the registers they read.
+ *
+ * A subroutine is pure if none of the code reachable from its entry point reads
+ * or writes memory other than through the stack, does I/O, or jumps to an address
+ * taken from a register. Its only effect is then the final value of the registers it writes to.
+ *
+ * Calls are recorded as they run: a frame is opened on CALL and closed by the RET
+ * that brings the stack back to where it was. A frame is dropped if the subroutine
+ * pops more than it pushed, since it would have read its caller's stack.
+ */
+class Memoizer
+{
+public:
+    static constexpr std::size_t num_registers = InstructionData::num_registers;
+    static constexpr std::size_t default_max_entries = 1 << 20;
+    static constexpr std::size_t max_analyzed_instructions = 4096; // Larger subroutines are considered impure
+
+    explicit Memoizer(std::size_t const max_entries = default_max_entries)
+        : m_max_entries(max_entries)
+    { }
+
+    struct Statistics
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t rejected = 0; // Results not stored because the table was full
+        std::size_t entries = 0;
+        std::size_t bytes = 0;      // Approximate size of the table
+    };
+
+    /**
+     * @brief Called by CALL, before the return address is pushed.
+     * @returns true on a cache hit, in which case the registers already hold the
+     *          results and the call must be skipped.
+     */
+    bool Call(DecodeCache& cache, Memory const& memory, Address const target, Address const return_address,
+              std::size_t const stack_size, std::span<Word, num_registers> registers)
+    {
+        Summary const& summary = Analyze(cache, memory, target);
+        if(!summary.is_pure) return false;
+
+        const Key key = MakeKey(target, summary.inputs, registers);
+        if(const auto it = m_table.find(key); it != m_table.end())
+        {
+            ++m_hits;
+            for(std::size_t i=0; i < num_registers; ++i)
+            {
+                if(summary.outputs & (1u << i)) registers[i] = it->second[i];
+            }
+            return true;
+        }
+
+        ++m_misses;
+        m_frames.push_back({key, summary.outputs, stack_size, return_address.get().to_int()});
+        return false;
+    }
+
+    /**
+     * @brief Called by RET, after the return address has been popped.
+     */
+    void Return(std::size_t const stack_size, Address const return_address, std::span<Word const, num_registers> registers)
+    {
+        while(!m_frames.empty() && stack_size <= m_frames.back().stack_size)
+        {
+            Frame const& frame = m_frames.back();
+            if(stack_size == frame.stack_size && return_address.get().to_int() == frame.return_address)
+            {
+                Record(frame, registers);
+            }
+            m_frames.pop_back();
+        }
+    }
+
+    /**
+     * @brief Called by POP. Drops the frames of subroutines that popped their return address.
+     */
+    constexpr void Pop(std::size_t const stack_size) noexcept
+    {
+        while(!m_frames.empty() && stack_size <= m_frames.back().stack_size)
+        {
+            m_frames.pop_back();
+        }
+    }
+
+    /**
+     * @brief Forgets the calls being recorded, for when the machine is reset to another state.
+     */
+    void AbandonCalls() noexcept
+    {
+        m_frames.clear();
+    }
+
+    /**
+     * @brief Forgets everything. Must be called whenever code is overwritten.
+     */
+    void Clear()
+    {
+        m_summaries.clear();
+        m_table.clear();
+        m_frames.clear();
+    }
+
+    Statistics statistics() const noexcept
+    {
+        Statistics stats;
+        stats.hits = m_hits;
+        stats.misses = m_misses;
+        stats.rejected = m_rejected;
+        stats.entries = m_table.size();
+        stats.bytes = m_table.size() * (sizeof(Table::value_type) + 2 * sizeof(void*))
+                    + m_table.bucket_count() * sizeof(void*);
+        return stats;
+    }
+
+private:
+    using Key = std::array<std::uint16_t, 1 + num_registers>;   // Target, then the registers read (others are zero)
+    using Result = std::array<std::uint16_t, num_registers>;    // Registers written (others are unused)
+
+    struct KeyHash
+    {
+        std::size_t operator()(Key const& key) const noexcept
+        {
+            std::uint64_t hash = 0xcbf29ce484222325; // FNV-1a
+            for(std::uint16_t const value: key)
+            {
+                hash = (hash ^ value) * 0x100000001b3;
+            }
+            return hash;
+        }
+    };
+
+    using Table = std::unordered_map<Key, Result, KeyHash>;
+
+    struct Summary
+    {
+        bool is_pure = false;
+        std::uint8_t inputs = 0;  // Bit i is set if register i is read
+        std::uint8_t outputs = 0; // Bit i is set if register i is written
+    };
+
+    struct Frame
+    {
+        Key key;
+        std::uint8_t outputs;
+        std::size_t stack_size;    // Before the return address was pushed
+        raw_word_t return_address;
+    };
+
+    static Key MakeKey(Address const target, std::uint8_t const inputs, std::span<Word const, num_registers> registers) noexcept
+    {
+        Key key {};
+        key[0] = target.get().to_int();
+        for(std::size_t i=0; i < num_registers; ++i)
+        {
+            if(inputs & (1u << i)) key[1 + i] = registers[i].to_int();
+        }
+        return key;
+    }
+
+    void Record(Frame const& frame, std::span<Word const, num_registers> registers)
+    {
+        if(m_table.size() >= m_max_entries)
+        {
+            ++m_rejected;
+            return;
+        }
+
+        Result result {};
+        for(std::size_t i=0; i < num_registers; ++i)
+        {
+            if(frame.outputs & (1u << i)) result[i] = registers[i].to_int();
+        }
+        m_table.emplace(frame.key, result);
+    }
+
+    /**
+     * @brief Follows every path from the entry point, including into the subroutines it calls.
+     *        Instructions are fetched through the decode cache, so that overwriting them is noticed.
+     */
+    Summary const& Analyze(DecodeCache& cache, Memory const& memory, Address const target)
+    {
+        const raw_word_t entry = target.get().to_int();
+        if(const auto it = m_summaries.find(entry); it != m_summaries.end()) return it->second;
+
+        Summary summary;
+        summary.is_pure = true;
+
+        std::vector<bool> visited(Word::max_word);
+        std::vector<raw_word_t> pending = {entry};
+        std::size_t num_visited = 0;
+
+        const auto follow = [&](Operand const& next) {
+            if(next.type != InstructionData::LITERAL) summary.is_pure = false;
+            else pending.push_back(next.value.to_int());
+        };
+
+        while(summary.is_pure && !pending.empty())
+        {
+            const raw_word_t ptr = pending.back();
+            pending.pop_back();
+            if(visited[ptr]) continue;
+            visited[ptr] = true;
+
+            if(++num_visited > max_analyzed_instructions)
+            {
+                summary.is_pure = false;
+                break;
+            }
+
+            DecodedInstruction const& instr = cache.Fetch(memory, ptr);
+            if(instr.may_fault)
+            {
+                summary.is_pure = false;
+                break;
+            }
+
+            const std::size_t num_operands = InstructionData::NumOperands(instr.opcode);
+            const std::size_t first_read = InstructionData::HasRegisterTarget(instr.opcode) ? 1 : 0;
+            if(first_read == 1) summary.outputs |= static_cast<std::uint8_t>(1u << instr.args[0].value.to_int());
+            for(std::size_t i=first_read; i < num_operands; ++i)
+            {
+                if(instr.args[i].type == InstructionData::REGISTER)
+                {
+                    summary.inputs |= static_cast<std::uint8_t>(1u << instr.args[i].value.to_int());
+                }
+            }
+
+            const Operand next = {InstructionData::LITERAL, Word(static_cast<raw_word_t>((ptr + instr.length) % Word::max_word))};
+            switch(instr.opcode)
+            {
+                case InstructionData::RMEM: case InstructionData::WMEM: case InstructionData::OUT:
+                case InstructionData::IN:   case InstructionData::HALT: case InstructionData::WRONG_OPCODE:
+                case InstructionData::NATIVE_HOOK:
+                    summary.is_pure = false;
+                    break;
+                case InstructionData::RET:
+                    break;
+                case InstructionData::JMP:
+                    follow(instr.args[0]);
+                    break;
+                case InstructionData::JT: case InstructionData::JF:
+                    follow(instr.args[1]);
+                    follow(next);
+                    break;
+                case InstructionData::CALL:
+                    follow(instr.args[0]);
+                    follow(next);
+                    break;
+                default:
+                    follow(next);
+                    break;
+            }
+        }
+
+        // A register written on some paths only keeps the caller's value on the others, so that value
+        // is part of the result and must be part of the key as well
+        if(summary.is_pure) summary.inputs |= summary.outputs & ~WrittenOnEveryPath(cache, memory, entry);
+
+        return m_summaries.emplace(entry, summary).first->second;
+    }
+
+    /**
+     * @brief Registers that every path from the entry point writes to before returning, found by
+     *        intersecting what is written along each path. Writes in the subroutines it calls are
+     *        not counted, which only makes the result smaller. Must only be used on pure subroutines.
+     */
+    static std::uint8_t WrittenOnEveryPath(DecodeCache& cache, Memory const& memory, raw_word_t const entry)
+    {
+        std::vector<std::uint8_t> written(Word::max_word); // Before each instruction reached so far
+        std::vector<bool> reached(Word::max_word);
+        std::vector<raw_word_t> pending = {entry};
+        reached[entry] = true;
+        std::uint8_t at_return = 0xFF;
+
+        const auto reach = [&](raw_word_t const ptr, std::uint8_t const mask) {
+            if(reached[ptr] && (written[ptr] & mask) == written[ptr]) return;
+            written[ptr] = reached[ptr] ? written[ptr] & mask : mask;
+            reached[ptr] = true;
+            pending.push_back(ptr);
+        };
+
+        while(!pending.empty())
+        {
+            const raw_word_t ptr = pending.back();
+            pending.pop_back();
+
+            DecodedInstruction const& instr = cache.Fetch(memory, ptr);
+            std::uint8_t mask = written[ptr];
+            if(InstructionData::HasRegisterTarget(instr.opcode)) mask |= static_cast<std::uint8_t>(1u << instr.args[0].value.to_int());
+
+            const raw_word_t next = static_cast<raw_word_t>((ptr + instr.length) % Word::max_word);
+            switch(instr.opcode)
+            {
+                case InstructionData::RET:
+                    at_return &= mask;
+                    break;
+                case InstructionData::JMP:
+                    reach(instr.args[0].value.to_int(), mask);
+                    break;
+                case InstructionData::JT: case InstructionData::JF:
+                    reach(instr.args[1].value.to_int(), mask);
+                    reach(next, mask);
+                    break;
+                case InstructionData::CALL:
+                    reach(instr.args[0].value.to_int(), mask);
+                    reach(next, mask);
+                    break;
+                default:
+                    reach(next, mask);
+                    break;
+            }
+        }
+        return at_return;
+    }
+
+    std::size_t m_max_entries;
+    std::unordered_map<raw_word_t, Summary> m_summaries; // Indexed by entry point
+    Table m_table;
+    std::vector<Frame> m_frames;                         // Calls being recorded, innermost last
+
+    std::uint64_t m_hits = 0;
+    std::uint64_t m_misses = 0;
+    std::uint64_t m_rejected = 0;
+};
@@ -0,0 +1,28 @@
+#include "output_sink.h"
+
+#if defined(__unix__)
+#include <cerrno>
+#include <unistd.h>
+#else
+#include <cstdio>
+#endif
+
+void FileDescriptorSink::Write(std::string_view text)
+{
+#if defined(__unix__)
+    while(!text.empty())
+    {
+        const ssize_t written = ::write(m_fd, text.data(), text.size());
+        if(written < 0)
+        {
+            if(errno == EINTR) continue;
+            return; // Nowhere to report it, as with a failed std::cout
+        }
+        text.remove_prefix(static_cast<std::size_t>(written));
+    }
+#else
+    std::FILE* const file = m_fd == 2 ? stderr : stdout;
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fflush(file);
+#endif
+}
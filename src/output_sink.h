@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * Where OUT writes to. Characters are gathered in a fixed buffer and handed over to Write
+ * in batches: when the buffer fills, and whenever Flush is called. The virtual machine
+ * flushes before IN reads a new line and on HALT, so prompts are shown before waiting on
+ * input; hosts call Flush for anything else, such as reading the output mid-run.
+ *
+ * Derived sinks must flush in their destructor, since Write is not reachable from the base's.
+ */
+class OutputSink
+{
+public:
+    static constexpr std::size_t buffer_size = 4096;
+
+    OutputSink() noexcept = default;
+    OutputSink(OutputSink const&) = delete;
+    OutputSink& operator=(OutputSink const&) = delete;
+    virtual ~OutputSink() = default;
+
+    void Put(char const c)
+    {
+        if(m_size == m_buffer.size()) [[unlikely]] Flush();
+        m_buffer[m_size++] = c;
+    }
+
+    void Put(std::string_view const text)
+    {
+        for(char const c: text) Put(c);
+    }
+
+    void Flush()
+    {
+        if(m_size == 0) return;
+        Write(std::string_view(m_buffer.data(), m_size));
+        m_size = 0;
+    }
+
+protected:
+    /**
+     * @brief Delivers a batch of characters.
+     */
+    virtual void Write(std::string_view text) = 0;
+
+private:
+    std::array<char, buffer_size> m_buffer;
+    std::size_t m_size = 0;
+};
+
+/**
+ * Writes to a file descriptor, such as standard output, bypassing iostreams and stdio.
+ * Anything written to the same file through those must be flushed before this sink writes.
+ */
+class FileDescriptorSink final : public OutputSink
+{
+public:
+    explicit FileDescriptorSink(int const fd) noexcept : m_fd(fd) {}
+    ~FileDescriptorSink() override { Flush(); }
+
+protected:
+    void Write(std::string_view text) override;
+
+private:
+    int m_fd;
+};
+
+/**
+ * Keeps everything written, for tests and for hosts that inspect the output.
+ */
+class CaptureSink final : public OutputSink
+{
+public:
+    ~CaptureSink() override { Flush(); }
+
+    /**
+     * @brief Everything written so far. Flushes first.
+     */
+    std::string_view text()
+    {
+        Flush();
+        return m_text;
+    }
+
+    void Clear()
+    {
+        Flush();
+        m_text.clear();
+    }
+
+protected:
+    void Write(std::string_view const text) override { m_text += text; }
+
+private:
+    std::string m_text;
+};
+
+/**
+ * Drops everything, for runs where only the final state matters.
+ */
+class DiscardSink final : public OutputSink
+{
+protected:
+    void Write(std::string_view) override {}
+};
+
+/**
+ * Writes to a std::ostream, and flushes it along with the sink.
+ */
+class StreamSink final : public OutputSink
+{
+public:
+    explicit StreamSink(std::ostream& os) noexcept : m_stream(&os) {}
+    ~StreamSink() override { Flush(); }
+
+    std::ostream& stream() const noexcept { return *m_stream; }
+
+protected:
+    void Write(std::string_view const text) override
+    {
+        m_stream->write(text.data(), static_cast<std::streamsize>(text.size()));
+        m_stream->flush();
+    }
+
+private:
+    std::ostream* m_stream;
+};
@@ -0,0 +1,163 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+
+namespace
+{
+double Percent(std::uint64_t const count, std::uint64_t const total)
+{
+    return total == 0 ? 0.0 : 100.0 * static_cast<double>(count) / static_cast<double>(total);
+}
+}
+
+void CallGraph::Enter(raw_word_t const address, std::size_t const stack_size)
+{
+    if(m_current == root || m_nodes[m_current].address != address)
+    {
+        std::uint32_t callee = m_nodes[m_current].last_callee;
+        if(callee == root || m_nodes[callee].address != address)
+        {
+            const std::uint64_t key = (std::uint64_t{m_current} << 16) | address;
+            auto [it, inserted] = m_children.try_emplace(key, static_cast<std::uint32_t>(m_nodes.size()));
+            if(inserted)
+            {
+                // The frames are those of the chain, so the subroutine is outermost unless one of them is active
+                m_nodes.push_back(Node{m_current, address, m_active[address] == 0});
+            }
+            callee = it->second;
+            m_nodes[m_current].last_callee = callee;
+        }
+        m_current = callee;
+    }
+    ++m_active[address];
+    ++m_nodes[m_current].calls;
+    m_frames.push_back(Frame{m_current, stack_size});
+}
+
+std::vector<CallGraph::Subroutine> CallGraph::Subroutines() const
+{
+    // Callees are always created after their callers, so a backward pass totals every subtree
+    std::vector<std::uint64_t> totals(m_nodes.size());
+    for(std::size_t i=m_nodes.size(); i-- > 1;)
+    {
+        totals[i] += m_nodes[i].count;
+        totals[m_nodes[i].parent] += totals[i];
+    }
+
+    std::unordered_map<raw_word_t, Subroutine> subroutines;
+    for(std::size_t i=1; i < m_nodes.size(); ++i)
+    {
+        Node const& node = m_nodes[i];
+        Subroutine& subroutine = subroutines.try_emplace(node.address, Subroutine{node.address, 0, 0, 0}).first->second;
+        subroutine.calls += node.calls;
+        subroutine.exclusive += node.count;
+        if(node.outermost) subroutine.inclusive += totals[i];
+    }
+
+    std::vector<Subroutine> sorted;
+    sorted.reserve(subroutines.size());
+    for(auto const& [address, subroutine]: subroutines) sorted.push_back(subroutine);
+    std::sort(sorted.begin(), sorted.end(), [](Subroutine const& lhs, Subroutine const& rhs) {
+        return lhs.inclusive > rhs.inclusive || (lhs.inclusive == rhs.inclusive && lhs.address < rhs.address);
+    });
+    return sorted;
+}
+
+void CallGraph::WriteCollapsedStacks(std::ostream& os) const
+{
+    std::vector<std::uint32_t> chain;
+    for(std::uint32_t i=0; i < m_nodes.size(); ++i)
+    {
+        if(m_nodes[i].count == 0) continue;
+
+        chain.clear();
+        for(std::uint32_t node = i; node != root; node = m_nodes[node].parent) chain.push_back(node);
+
+        os << "main";
+        for(auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            os << ";sub_" << std::hex << std::setw(4) << std::setfill('0') << m_nodes[*it].address;
+        }
+        os << std::dec << std::setfill(' ') << ' ' << m_nodes[i].count << '\n';
+    }
+}
+
+std::uint64_t ExecutionProfile::total() const noexcept
+{
+    return std::accumulate(m_opcodes.begin(), m_opcodes.end(), std::uint64_t{0});
+}
+
+void ExecutionProfile::PrintReport(std::ostream& os, std::size_t const max_addresses) const
+{
+    const std::uint64_t executed = total();
+    os << std::dec << "Profile (" << executed << " instructions):\n";
+
+    std::array<std::size_t, InstructionData::num_opcodes> opcodes;
+    std::iota(opcodes.begin(), opcodes.end(), 0);
+    std::stable_sort(opcodes.begin(), opcodes.end(), [&](std::size_t lhs, std::size_t rhs) {
+        return m_opcodes[lhs] > m_opcodes[rhs];
+    });
+
+    os << "- By opcode:\n";
+    for(std::size_t const op: opcodes)
+    {
+        if(m_opcodes[op] == 0) break;
+        os << "  " << std::setw(12) << std::setfill(' ') << std::left
+           << InstructionData::InstructionName(static_cast<InstructionData::OpCode>(op)) << std::right
+           << std::setw(14) << m_opcodes[op] << "  " << std::fixed << std::setprecision(1)
+           << std::setw(5) << Percent(m_opcodes[op], executed) << "%\n";
+    }
+
+    std::vector<raw_word_t> addresses;
+    for(raw_word_t address=0; address < Word::max_word; ++address)
+    {
+        if(m_addresses[address] != 0) addresses.push_back(address);
+    }
+    const std::size_t shown = std::min(max_addresses, addresses.size());
+    std::partial_sort(addresses.begin(), addresses.begin() + static_cast<std::ptrdiff_t>(shown), addresses.end(), [&](raw_word_t lhs, raw_word_t rhs) {
+        return m_addresses[lhs] > m_addresses[rhs] || (m_addresses[lhs] == m_addresses[rhs] && lhs < rhs);
+    });
+
+    os << "- Hottest of " << addresses.size() << " addresses:\n";
+    for(std::size_t i=0; i < shown; ++i)
+    {
+        const raw_word_t address = addresses[i];
+        os << "  " << std::hex << std::setw(4) << std::setfill('0') << address << std::dec << std::setfill(' ')
+           << "  " << std::setw(12) << std::left
+           << InstructionData::InstructionName(static_cast<InstructionData::OpCode>(m_last_opcodes[address])) << std::right
+           << std::setw(14) << m_addresses[address] << "  " << std::fixed << std::setprecision(1)
+           << std::setw(5) << Percent(m_addresses[address], executed) << "%\n";
+    }
+
+    const std::vector<CallGraph::Subroutine> subroutines = m_call_graph.Subroutines();
+    os << "- Hottest of " << subroutines.size() << " subroutines (inclusive, exclusive, calls):\n";
+    for(std::size_t i=0; i < std::min(max_addresses, subroutines.size()); ++i)
+    {
+        CallGraph::Subroutine const& subroutine = subroutines[i];
+        os << "  " << std::hex << std::setw(4) << std::setfill('0') << subroutine.address << std::dec << std::setfill(' ')
+           << std::setw(16) << subroutine.inclusive << "  " << std::fixed << std::setprecision(1)
+           << std::setw(5) << Percent(subroutine.inclusive, executed) << "%"
+           << std::setw(16) << subroutine.exclusive << "  " << std::setw(5) << Percent(subroutine.exclusive, executed) << "%"
+           << std::setw(12) << subroutine.calls << "\n";
+    }
+    os << std::defaultfloat << std::flush;
+}
+
+void ExecutionProfile::WriteDump(std::ostream& os) const
+{
+    os << std::dec << "kind,key,opcode,count\n";
+    for(std::size_t op=0; op < InstructionData::num_opcodes; ++op)
+    {
+        if(m_opcodes[op] == 0) continue;
+        const auto name = InstructionData::InstructionName(static_cast<InstructionData::OpCode>(op));
+        os << "opcode," << name << ',' << name << ',' << m_opcodes[op] << '\n';
+    }
+    for(raw_word_t address=0; address < Word::max_word; ++address)
+    {
+        if(m_addresses[address] == 0) continue;
+        os << "address," << address << ',' << InstructionData::InstructionName(static_cast<InstructionData::OpCode>(m_last_opcodes[address]))
+           << ',' << m_addresses[address] << '\n';
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "address.h"
+#include "instruction.h"
+#include "word.h"
+
+/**
+ * Instructions executed in each subroutine, following calls through a shadow call stack.
+ *
+ * Every distinct chain of calls from the start of the program is a node of a tree, and each
+ * instruction is counted in the node of the chain it ran under. Subroutines are known by the
+ * address they were called at. Programs may leave a subroutine without RET, or use RET as a
+ * computed jump, so frames are not matched by instruction: each remembers the depth of the
+ * machine stack just after the call pushed its return address, and is left once RET pops
+ * below that.
+ *
+ * A subroutine calling itself directly stays in the same node, so that deep recursion does not
+ * make the tree, and the chains written out, grow with its depth.
+ */
+class CallGraph
+{
+public:
+    struct Subroutine
+    {
+        raw_word_t address;
+        std::uint64_t calls;
+        std::uint64_t inclusive; // Instructions run until it returned, once per outermost call when recursive
+        std::uint64_t exclusive; // Instructions of its own
+    };
+
+    constexpr void Count() noexcept { ++m_nodes[m_current].count; }
+
+    /**
+     * @param stack_size is the size of the machine stack once the return address is pushed
+     */
+    void Enter(raw_word_t address, std::size_t stack_size);
+
+    /**
+     * @param stack_size is the size of the machine stack once the return address is popped
+     */
+    void Leave(std::size_t const stack_size) noexcept
+    {
+        while(!m_frames.empty() && m_frames.back().stack_size > stack_size)
+        {
+            --m_active[m_nodes[m_frames.back().node].address];
+            m_frames.pop_back();
+        }
+        m_current = m_frames.empty() ? root : m_frames.back().node;
+    }
+
+    /**
+     * @brief Every subroutine that was called, by decreasing inclusive count.
+     */
+    std::vector<Subroutine> Subroutines() const;
+
+    /**
+     * @brief Writes one line per chain of calls that ran instructions of its own, as frames from
+     *        the start of the program separated by semicolons, then a space and the count. This is
+     *        the format taken by flamegraph.pl and compatible tools.
+     */
+    void WriteCollapsedStacks(std::ostream& os) const;
+
+private:
+    static constexpr std::uint32_t root = 0;
+
+    struct Node
+    {
+        std::uint32_t parent;
+        raw_word_t address;
+        bool outermost;          // Whether no caller up the chain is the same subroutine
+        std::uint32_t last_callee = root; // Spares a lookup in m_children when calls repeat
+        std::uint64_t calls = 0;
+        std::uint64_t count = 0; // Instructions run in this chain, not in its callees
+    };
+
+    struct Frame
+    {
+        std::uint32_t node;
+        std::size_t stack_size;
+    };
+
+    std::vector<Node> m_nodes = {Node{root, 0, false}};
+    std::unordered_map<std::uint64_t, std::uint32_t> m_children; // Keyed by parent and address
+    std::vector<Frame> m_frames;
+    std::vector<std::uint32_t> m_active = std::vector<std::uint32_t>(Word::max_word); // Frames in m_frames, by address
+    std::uint32_t m_current = root;
+};
+
+/**
+ * How many times each address and each opcode was executed, as counted by
+ * BasicVirtualMachine<ProfiledPolicy>. Counters are flat arrays indexed by address and
+ * by opcode, so counting an instruction is two increments.
+ */
+class ExecutionProfile
+{
+public:
+    constexpr void Count(Address const ptr, InstructionData::OpCode const op) noexcept
+    {
+        const raw_word_t address = ptr.get().to_int();
+        ++m_addresses[address];
+        m_last_opcodes[address] = static_cast<std::uint8_t>(op);
+        ++m_opcodes[op];
+        m_call_graph.Count();
+    }
+
+    void Call(Address const destination, std::size_t const stack_size) { m_call_graph.Enter(destination.get().to_int(), stack_size); }
+    void Return(std::size_t const stack_size) noexcept { m_call_graph.Leave(stack_size); }
+
+    CallGraph const& call_graph() const noexcept { return m_call_graph; }
+
+    std::uint64_t address_count(Address const ptr) const noexcept { return m_addresses[ptr.get().to_int()]; }
+    std::uint64_t opcode_count(InstructionData::OpCode const op) const noexcept { return m_opcodes[op]; }
+    std::uint64_t total() const noexcept;
+
+    /**
+     * @brief Prints the opcodes, addresses and subroutines that ran most often, hottest first.
+     */
+    void PrintReport(std::ostream& os, std::size_t max_addresses = 20) const;
+
+    /**
+     * @brief Writes every non-zero counter as CSV, with columns kind,key,opcode,count.
+     *        Rows of kind "address" are keyed by address, and name the opcode last executed there.
+     *        Rows of kind "opcode" are keyed by opcode name.
+     */
+    void WriteDump(std::ostream& os) const;
+
+private:
+    std::vector<std::uint64_t> m_addresses = std::vector<std::uint64_t>(Word::max_word);
+    std::vector<std::uint8_t> m_last_opcodes = std::vector<std::uint8_t>(Word::max_word); // So that self-modified code is reported as what ran
+    std::array<std::uint64_t, InstructionData::num_opcodes> m_opcodes {};
+    CallGraph m_call_graph;
+};
+
+/**
+ * Stands in for ExecutionProfile when the execution policy does not profile.
+ */
+struct NoProfile {};
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "address.h"
+#include "instruction.h"
+#include "output_sink.h"
+#include "virtual_machine.h"
+#include "word.h"
+
+/**
+ * Ranges of candidates shared by a pool of workers. Each worker takes candidates one at a
+ * time from the front of its own range and, once it runs out, steals the back half of the
+ * largest range left.
+ *
+ * A range is packed in a single atomic word, so taking and stealing are lock-free.
+ */
+class WorkStealingRanges
+{
+public:
+    WorkStealingRanges(std::uint32_t const first, std::uint32_t const last, std::size_t const num_workers)
+        : m_ranges(std::max<std::size_t>(num_workers, 1))
+    {
+        const std::uint64_t size = std::uint64_t{last} + 1 - first;
+        for(std::size_t i=0; i < m_ranges.size(); ++i)
+        {
+            const auto begin = static_cast<std::uint32_t>(first + size * i / m_ranges.size());
+            const auto end = static_cast<std::uint32_t>(first + size * (i + 1) / m_ranges.size());
+            m_ranges[i].store(Pack(begin, end), std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @returns the next candidate of the worker, stolen from another one if needed,
+     *          or nothing if every range is exhausted.
+     */
+    std::optional<std::uint32_t> Next(std::size_t const worker)
+    {
+        if(auto const candidate = TakeFront(worker)) return candidate;
+        while(true)
+        {
+            const std::size_t victim = Largest();
+            if(Size(m_ranges[victim].load(std::memory_order_relaxed)) == 0) return std::nullopt;
+            if(auto const candidate = StealFrom(victim, worker)) return candidate;
+        }
+    }
+
+    std::size_t num_workers() const noexcept { return m_ranges.size(); }
+
+private:
+    static constexpr std::uint64_t Pack(std::uint32_t const begin, std::uint32_t const end) noexcept
+    {
+        return (std::uint64_t{end} << 32) | begin;
+    }
+
+    static constexpr std::uint32_t Begin(std::uint64_t const range) noexcept { return static_cast<std::uint32_t>(range); }
+    static constexpr std::uint32_t End(std::uint64_t const range) noexcept { return static_cast<std::uint32_t>(range >> 32); }
+    static constexpr std::uint32_t Size(std::uint64_t const range) noexcept { return End(range) - Begin(range); }
+
+    std::optional<std::uint32_t> TakeFront(std::size_t const worker)
+    {
+        std::uint64_t range = m_ranges[worker].load(std::memory_order_relaxed);
+        while(Size(range) != 0)
+        {
+            if(m_ranges[worker].compare_exchange_weak(range, Pack(Begin(range) + 1, End(range)), std::memory_order_relaxed))
+            {
+                return Begin(range);
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Moves the back half of the victim's range into the worker's, whose range is empty.
+     * @returns the first stolen candidate, or nothing if the victim's range changed meanwhile.
+     */
+    std::optional<std::uint32_t> StealFrom(std::size_t const victim, std::size_t const worker)
+    {
+        std::uint64_t range = m_ranges[victim].load(std::memory_order_relaxed);
+        if(Size(range) == 0) return std::nullopt;
+
+        const std::uint32_t middle = Begin(range) + Size(range) / 2;
+        if(!m_ranges[victim].compare_exchange_strong(range, Pack(Begin(range), middle), std::memory_order_relaxed))
+        {
+            return std::nullopt;
+        }
+
+        // Nobody steals from an empty range, so the worker's own range can be stored directly
+        m_ranges[worker].store(Pack(middle + 1, End(range)), std::memory_order_relaxed);
+        return middle;
+    }
+
+    std::size_t Largest() const noexcept
+    {
+        std::size_t largest = 0;
+        std::uint32_t largest_size = 0;
+        for(std::size_t i=0; i < m_ranges.size(); ++i)
+        {
+            const std::uint32_t size = Size(m_ranges[i].load(std::memory_order_relaxed));
+            if(size > largest_size)
+            {
+                largest = i;
+                largest_size = size;
+            }
+        }
+        return largest;
+    }
+
+    std::vector<std::atomic<std::uint64_t>> m_ranges; // Packed [begin, end) of each worker
+};
+
+/**
+ * State of a candidate run, as seen by the predicate before every instruction.
+ */
+struct SweepProbe
+{
+    VirtualMachine const& vm;
+    std::string_view output; // Everything the candidate has printed so far
+};
+
+using SweepPredicate = std::function<bool(SweepProbe const&)>;
+
+/**
+ * @brief Fires when the instruction at ptr is about to run with the register set to value.
+ */
+inline SweepPredicate RegisterEqualsAt(Address const ptr, std::size_t const reg, raw_word_t const value)
+{
+    return [=](SweepProbe const& probe) {
+        return probe.vm.instr_ptr() == ptr && probe.vm.registers()[reg].to_int() == value;
+    };
+}
+
+/**
+ * @brief Fires as soon as the program has printed text. Since the predicate runs after
+ *        every character, the text can only appear at the end of the output.
+ */
+inline SweepPredicate OutputContains(std::string text)
+{
+    return [text = std::move(text)](SweepProbe const& probe) {
+        return probe.output.ends_with(text);
+    };
+}
+
+/**
+ * Runs a program many times from the same state, each time with a different initial
+ * value of one register, until a predicate fires.
+ */
+class RegisterSweep
+{
+public:
+    struct Options
+    {
+        std::size_t reg = InstructionData::num_registers - 1;
+        raw_word_t first = 1;
+        raw_word_t last = Word::max_word - 1;
+        std::size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+        std::uint64_t max_instructions = 1'000'000'000; // Per candidate
+        std::string input;  // Given to every candidate. A candidate stops when it needs more.
+    };
+
+    struct Result
+    {
+        std::optional<raw_word_t> value; // Candidate for which the predicate fired
+        std::string output;              // What that candidate printed
+        std::uint64_t candidates = 0;    // Candidates that were run, in part or in full
+        std::uint64_t instructions = 0;
+    };
+
+    RegisterSweep(VirtualMachine const& base, SweepPredicate predicate, Options options)
+        : m_base(base), m_predicate(std::move(predicate)), m_options(std::move(options))
+    { }
+
+    /**
+     * @brief Splits the range of candidates among the worker threads. Each one clones the
+     *        base machine once, and resets it before every candidate. All workers stop as
+     *        soon as one candidate is found.
+     */
+    Result Run()
+    {
+        WorkStealingRanges ranges(m_options.first, m_options.last, m_options.num_threads);
+        std::vector<Result> results(ranges.num_workers());
+        std::atomic<bool> found = false;
+
+        std::vector<std::jthread> workers;
+        for(std::size_t i=0; i < ranges.num_workers(); ++i)
+        {
+            workers.emplace_back([&, i]{ Work(ranges, i, found, results[i]); });
+        }
+        workers.clear();
+
+        Result total;
+        for(Result& result: results)
+        {
+            total.candidates += result.candidates;
+            total.instructions += result.instructions;
+            if(result.value && !total.value)
+            {
+                total.value = result.value;
+                total.output = std::move(result.output);
+            }
+        }
+        return total;
+    }
+
+private:
+    static constexpr std::uint64_t stop_check_interval = 4096; // Instructions between checks for a result found elsewhere
+
+    void Work(WorkStealingRanges& ranges, std::size_t const worker, std::atomic<bool>& found, Result& result) const
+    {
+        VirtualMachine vm(m_base);
+        CaptureSink output;
+        std::istringstream input;
+        vm.SetOutput(output);
+        vm.SetInput(input);
+
+        while(!found.load(std::memory_order_relaxed))
+        {
+            const auto candidate = ranges.Next(worker);
+            if(!candidate) return;
+
+            ++result.candidates;
+            vm.CopyStateFrom(m_base);
+            vm.registers()[m_options.reg] = Word(static_cast<raw_word_t>(*candidate));
+            output.Clear();
+            input.clear();
+            input.str(m_options.input);
+
+            if(RunCandidate(vm, output, found, result.instructions))
+            {
+                found.store(true, std::memory_order_relaxed);
+                result.value = static_cast<raw_word_t>(*candidate);
+                result.output = output.text();
+                return;
+            }
+        }
+    }
+
+    /**
+     * @returns whether the predicate fired
+     */
+    bool RunCandidate(VirtualMachine& vm, CaptureSink& output, std::atomic<bool> const& found, std::uint64_t& instructions) const
+    {
+        for(std::uint64_t i=0; i < m_options.max_instructions; ++i)
+        {
+            if(m_predicate(SweepProbe{vm, output.text()})) return true;
+            if(!vm.IsRunning()) return false;
+            if(std::as_const(vm).memory()[vm.instr_ptr()].to_int() == InstructionData::IN && !vm.HasPendingInput()) return false;
+            if(i % stop_check_interval == 0 && found.load(std::memory_order_relaxed)) return false;
+
+            vm.Step();
+            ++instructions;
+        }
+        return false;
+    }
+
+    VirtualMachine const& m_base;
+    SweepPredicate m_predicate;
+    Options m_options;
+};
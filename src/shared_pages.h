@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Fixed-size table of pages that copies of the table share until one of them writes
+ * to a page. Copying the table only copies the pointers to the pages.
+ *
+ * Reading goes straight to the page. Writing must go through mutable_page, which first
+ * copies the page if some other table still points to it. Reference counts are atomic,
+ * so tables that share pages may live in different threads.
+ *
+ * A new table points to a single page for all of its slots.
+ */
+template<typename TPage, std::size_t TNumPages>
+class SharedPages
+{
+    struct Node
+    {
+        std::atomic<std::uint32_t> refs;
+        TPage page;
+    };
+
+public:
+    static constexpr std::size_t num_pages = TNumPages;
+
+    // For code that reads pages through table(): where the reference count and the page are in each node
+    static constexpr std::size_t refs_offset = offsetof(Node, refs);
+    static constexpr std::size_t page_offset = offsetof(Node, page);
+
+    SharedPages()
+    {
+        Node* const blank = new Node{num_pages, TPage{}};
+        m_nodes.fill(blank);
+    }
+
+    SharedPages(SharedPages const& other)
+        : m_nodes(other.m_nodes)
+    {
+        for(Node* node: m_nodes) node->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    SharedPages& operator=(SharedPages const& other)
+    {
+        for(std::size_t i=0; i < num_pages; ++i) Share(other, i);
+        return *this;
+    }
+
+    ~SharedPages()
+    {
+        for(Node* node: m_nodes) Release(node);
+    }
+
+    constexpr TPage const& page(std::size_t const i) const noexcept
+    {
+        return m_nodes[i]->page;
+    }
+
+    /**
+     * @brief The page, for writing. It is copied first if shared.
+     */
+    TPage& mutable_page(std::size_t const i)
+    {
+        if(m_nodes[i]->refs.load(std::memory_order_acquire) != 1) [[unlikely]]
+        {
+            Unshare(i);
+        }
+        return m_nodes[i]->page;
+    }
+
+    bool SharesPage(SharedPages const& other, std::size_t const i) const noexcept
+    {
+        return m_nodes[i] == other.m_nodes[i];
+    }
+
+    /**
+     * @brief Points the slot to the other table's page, dropping its own.
+     */
+    void Share(SharedPages const& other, std::size_t const i)
+    {
+        if(SharesPage(other, i)) return;
+        other.m_nodes[i]->refs.fetch_add(1, std::memory_order_relaxed);
+        Release(m_nodes[i]);
+        m_nodes[i] = other.m_nodes[i];
+    }
+
+    /**
+     * @brief Number of distinct pages this table points to that no other table does.
+     */
+    std::size_t num_private_pages() const noexcept
+    {
+        std::size_t count = 0;
+        for(Node* node: m_nodes)
+        {
+            count += node->refs.load(std::memory_order_relaxed) == 1;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Address of the array of pointers to the pages, for compiled code. A page
+     *        is at page_offset bytes from where its pointer points to, and may be written
+     *        there only while its reference count is one. Pointers change whenever a page
+     *        is copied, so they must not be kept across writes.
+     */
+    void const* table() const noexcept { return m_nodes.data(); }
+
+private:
+    [[gnu::noinline]] void Unshare(std::size_t const i)
+    {
+        Node* const copy = new Node{1, m_nodes[i]->page};
+        Release(m_nodes[i]);
+        m_nodes[i] = copy;
+    }
+
+    static void Release(Node* const node) noexcept
+    {
+        if(node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete node;
+    }
+
+    std::array<Node*, num_pages> m_nodes;
+};
@@ -0,0 +1,60 @@
+#include "snapshot.h"
+
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(char const* const path)
+{
+#if defined(__unix__)
+    const int fd = open(path, O_RDONLY);
+    if(fd < 0) return;
+
+    struct stat status;
+    if(fstat(fd, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        close(fd); // Directories and devices have no contents to map nor read
+        return;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(status.st_size);
+    void* const data = size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(size == 0 || data != MAP_FAILED)
+    {
+        m_is_open = true;
+        m_is_mapped = size != 0;
+        m_data = size == 0 ? nullptr : static_cast<std::byte const*>(data);
+        m_size = size;
+        return;
+    }
+#endif
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file) return;
+    const std::streamoff length = file.tellg();
+    if(length < 0) return;
+
+    std::vector<std::byte> buffer(static_cast<std::size_t>(length));
+    file.seekg(0);
+    if(!file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()))) return;
+
+    m_buffer = std::move(buffer);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    m_is_open = true;
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(__unix__)
+    if(m_is_mapped) munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+}
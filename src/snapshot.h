@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "word.h"
+
+/**
+ * On-disk format of the state of a virtual machine. Every field is little-endian, and
+ * sections are laid out back to back so that a snapshot mapped into memory can be copied
+ * straight into a machine on little-endian hosts:
+ *
+ *   SnapshotHeader   64 bytes
+ *   memory           the whole address space, one word per address
+ *   stack            stack_size words, from the bottom of the stack up
+ *   input            input_size bytes that IN has buffered but not consumed yet
+ *
+ * The version is bumped whenever the layout changes. Older versions are rejected.
+ */
+struct SnapshotHeader
+{
+    static constexpr std::array<char, 8> expected_magic = {'S', 'Y', 'N', 'A', 'C', 'O', 'R', 'S'};
+    static constexpr std::uint32_t current_version = 1;
+
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::array<std::uint16_t, 8> registers;
+    std::uint16_t instr_ptr;
+    std::array<std::uint16_t, 3> reserved; // Zero
+    std::uint64_t stack_size;              // Words
+    std::uint64_t stack_limit;             // Words
+    std::uint64_t input_size;              // Bytes
+};
+
+static_assert(sizeof(SnapshotHeader) == 64 && std::is_trivially_copyable_v<SnapshotHeader>);
+
+/**
+ * @brief Converts between host and little-endian byte order. The conversion is its own inverse.
+ */
+template<std::unsigned_integral T>
+constexpr T LittleEndian(T const value) noexcept
+{
+    if constexpr(std::endian::native == std::endian::little)
+    {
+        return value;
+    } else {
+        T swapped = 0;
+        for(std::size_t i=0; i < sizeof(T); ++i)
+        {
+            swapped = static_cast<T>((swapped << 8) | ((value >> (8 * i)) & 0xFF));
+        }
+        return swapped;
+    }
+}
+
+constexpr SnapshotHeader LittleEndian(SnapshotHeader header) noexcept
+{
+    header.version = LittleEndian(header.version);
+    header.flags = LittleEndian(header.flags);
+    for(auto& reg: header.registers) reg = LittleEndian(reg);
+    header.instr_ptr = LittleEndian(header.instr_ptr);
+    header.stack_size = LittleEndian(header.stack_size);
+    header.stack_limit = LittleEndian(header.stack_limit);
+    header.input_size = LittleEndian(header.input_size);
+    return header;
+}
+
+/**
+ * @brief Writes words in little-endian order.
+ */
+inline void WriteWords(std::ostream& os, std::span<Word const> const words)
+{
+    static_assert(sizeof(Word) == sizeof(raw_word_t) && std::is_trivially_copyable_v<Word>);
+    if constexpr(std::endian::native == std::endian::little)
+    {
+        os.write(reinterpret_cast<char const*>(words.data()), static_cast<std::streamsize>(words.size_bytes()));
+    } else {
+        for(Word const& word: words)
+        {
+            const raw_word_t value = LittleEndian(word.to_int());
+            os.write(reinterpret_cast<char const*>(&value), sizeof(value));
+        }
+    }
+}
+
+/**
+ * @brief Reads words stored in little-endian order. Bytes need not be aligned.
+ */
+inline void ReadWords(std::byte const* const bytes, std::span<Word> const words) noexcept
+{
+    if(words.empty()) return; // memcpy must not be given the null data of an empty span
+    std::memcpy(words.data(), bytes, words.size_bytes());
+    if constexpr(std::endian::native != std::endian::little)
+    {
+        for(Word& word: words) word = Word(LittleEndian(word.to_int()));
+    }
+}
+
+/**
+ * A whole file, mapped read-only into memory where the platform allows it and read into
+ * a buffer otherwise.
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(char const* path);
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    /**
+     * @brief Whether the file could be opened.
+     */
+    explicit operator bool() const noexcept { return m_is_open; }
+
+    std::span<std::byte const> data() const noexcept { return {m_data, m_size}; }
+
+private:
+    bool m_is_open = false;
+    std::byte const* m_data = nullptr;
+    std::size_t m_size = 0;
+    bool m_is_mapped = false;
+    std::vector<std::byte> m_buffer; // Contents, when the file could not be mapped
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/**
+ * Lock-free ring of bytes between exactly one producer thread and one consumer thread.
+ *
+ * Head and tail count every byte ever consumed and produced, so that their difference is
+ * the size, and each is written by one side only. They live on separate cache lines so that
+ * the two threads do not invalidate each other's line on every call.
+ *
+ * Either side may block: the consumer until there is data or the producer has closed the
+ * ring, and the producer until there is space. Sides that poll file descriptors instead,
+ * as AsyncIo does, need some other way to be woken up.
+ */
+class SpscRing
+{
+public:
+    /**
+     * @param capacity is rounded up to a power of two
+     */
+    explicit SpscRing(std::size_t const capacity)
+        : m_data(std::bit_ceil(std::max<std::size_t>(capacity, 1)))
+        , m_mask(m_data.size() - 1)
+    { }
+
+    SpscRing(SpscRing const&) = delete;
+    SpscRing& operator=(SpscRing const&) = delete;
+
+    std::size_t capacity() const noexcept { return m_data.size(); }
+    std::size_t size() const noexcept { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+    bool empty() const noexcept { return size() == 0; }
+    bool full() const noexcept { return size() == capacity(); }
+
+    /**
+     * @brief Producer only. Appends as many bytes as fit.
+     * @returns how many were appended
+     */
+    std::size_t Push(std::string_view const bytes) noexcept
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        const std::size_t count = std::min(bytes.size(), capacity() - (tail - m_head.load(std::memory_order_acquire)));
+        if(count == 0) return 0;
+
+        const std::size_t begin = tail & m_mask;
+        const std::size_t first = std::min(count, capacity() - begin);
+        std::memcpy(m_data.data() + begin, bytes.data(), first);
+        std::memcpy(m_data.data(), bytes.data() + first, count - first);
+
+        m_tail.store(tail + count, std::memory_order_release);
+        Signal();
+        return count;
+    }
+
+    /**
+     * @brief Producer only. Lets the consumer know that nothing else will be pushed.
+     */
+    void Close() noexcept
+    {
+        m_closed.store(true, std::memory_order_release);
+        Signal();
+    }
+
+    bool closed() const noexcept { return m_closed.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Consumer only. The bytes at the head that are contiguous in the buffer.
+     */
+    std::span<char const> Readable() const noexcept
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        const std::size_t begin = head & m_mask;
+        const std::size_t count = std::min(m_tail.load(std::memory_order_acquire) - head, capacity() - begin);
+        return {m_data.data() + begin, count};
+    }
+
+    /**
+     * @brief Consumer only. Drops bytes from the head, after reading them through Readable.
+     */
+    void Consume(std::size_t const count) noexcept
+    {
+        m_head.store(m_head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        m_head.notify_one();
+    }
+
+    /**
+     * @brief Consumer only. Moves as many bytes as are available, up to the size of the destination.
+     * @returns how many were moved
+     */
+    std::size_t Pop(std::span<char> destination) noexcept
+    {
+        std::size_t count = 0;
+        while(!destination.empty())
+        {
+            const std::span<char const> readable = Readable();
+            if(readable.empty()) break;
+            const std::size_t n = std::min(readable.size(), destination.size());
+            std::memcpy(destination.data(), readable.data(), n);
+            Consume(n);
+            destination = destination.subspan(n);
+            count += n;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Consumer only. Blocks until there is data, or the ring is empty and closed.
+     */
+    void WaitForData() const noexcept
+    {
+        while(true)
+        {
+            const std::uint32_t signals = m_signals.load(std::memory_order_acquire);
+            if(!empty() || closed()) return;
+            m_signals.wait(signals, std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * @brief Producer only. Blocks until the consumer has made room for at least one byte,
+     *        or has consumed everything if all is set.
+     */
+    void WaitForSpace(bool const all = false) const noexcept
+    {
+        while(true)
+        {
+            const std::size_t head = m_head.load(std::memory_order_acquire);
+            if(all ? empty() : !full()) return;
+            m_head.wait(head, std::memory_order_acquire);
+        }
+    }
+
+private:
+    /**
+     * @brief Wakes up a consumer in WaitForData. Head and tail cannot be waited on for this,
+     *        since closing the ring does not change them.
+     */
+    void Signal() noexcept
+    {
+        m_signals.fetch_add(1, std::memory_order_release);
+        m_signals.notify_one();
+    }
+
+    std::vector<char> m_data;
+    std::size_t m_mask;
+    alignas(64) std::atomic<std::size_t> m_head = 0;      // Bytes consumed, written by the consumer
+    alignas(64) std::atomic<std::size_t> m_tail = 0;      // Bytes produced, written by the producer
+    alignas(64) std::atomic<std::uint32_t> m_signals = 0; // Bumped by the producer on every push and on close
+    std::atomic<bool> m_closed = false;
+};
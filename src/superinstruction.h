@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include "instruction.h"
+
+/**
+ * Groups of adjacent instructions that are dispatched once and executed by a single handler.
+ * Only the last instruction of a group may transfer control.
+ */
+class SuperinstructionData
+{
+public:
+
+    enum Kind : std::uint8_t
+    {
+        NONE,
+        PUSH_PUSH_PUSH,
+        POP_POP_POP,
+        PUSH_PUSH,
+        POP_POP,
+        PUSH_CALL,
+        POP_RET,
+        EQ_JT,
+        EQ_JF,
+        GT_JT,
+        GT_JF,
+        ADD_JMP,
+        NUM_KINDS
+    };
+
+    static constexpr std::size_t max_instructions = 3;
+
+    struct Pattern
+    {
+        std::array<InstructionData::OpCode, max_instructions> opcodes;
+        std::size_t size;
+        std::string_view name;
+    };
+
+    static constexpr std::array<Pattern, NUM_KINDS> patterns = {{
+        {{},                                                                  0, "NONE"},
+        {{InstructionData::PUSH, InstructionData::PUSH, InstructionData::PUSH}, 3, "PUSH+PUSH+PUSH"},
+        {{InstructionData::POP,  InstructionData::POP,  InstructionData::POP},  3, "POP+POP+POP"},
+        {{InstructionData::PUSH, InstructionData::PUSH},                      2, "PUSH+PUSH"},
+        {{InstructionData::POP,  InstructionData::POP},                       2, "POP+POP"},
+        {{InstructionData::PUSH, InstructionData::CALL},                      2, "PUSH+CALL"},
+        {{InstructionData::POP,  InstructionData::RET},                       2, "POP+RET"},
+        {{InstructionData::EQ,   InstructionData::JT},                        2, "EQ+JT"},
+        {{InstructionData::EQ,   InstructionData::JF},                        2, "EQ+JF"},
+        {{InstructionData::GT,   InstructionData::JT},                        2, "GT+JT"},
+        {{InstructionData::GT,   InstructionData::JF},                        2, "GT+JF"},
+        {{InstructionData::ADD,  InstructionData::JMP},                       2, "ADD+JMP"},
+    }};
+
+    /**
+     * @brief Finds the group that starts with the given run of opcodes.
+     *        Longer groups are listed first, so they take precedence over their prefixes.
+     * @param size is the number of valid opcodes in the run
+     */
+    static constexpr Kind Match(std::array<InstructionData::OpCode, max_instructions> const& run, std::size_t const size) noexcept
+    {
+        for(std::size_t kind = NONE + 1; kind < NUM_KINDS; ++kind)
+        {
+            Pattern const& pattern = patterns[kind];
+            if(pattern.size > size) continue;
+
+            bool matches = true;
+            for(std::size_t i=0; i < pattern.size; ++i)
+            {
+                matches &= pattern.opcodes[i] == run[i];
+            }
+            if(matches) return static_cast<Kind>(kind);
+        }
+        return NONE;
+    }
+
+private:
+    constexpr SuperinstructionData() = default;
+
+};
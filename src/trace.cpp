@@ -0,0 +1,55 @@
+#include "trace.h"
+
+#include <string_view>
+
+TraceWriter::TraceWriter(char const* const path, std::size_t const ring_size)
+    : m_file(path, std::ios::binary | std::ios::trunc)
+    , m_ring(ring_size)
+{
+    const TraceHeader header = LittleEndian(TraceHeader{TraceHeader::expected_magic, TraceHeader::current_version, sizeof(TraceRecord)});
+    m_file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    m_failed = !m_file;
+    m_thread = std::thread(&TraceWriter::Loop, this);
+}
+
+TraceWriter::~TraceWriter()
+{
+    if(m_thread.joinable()) Close();
+}
+
+void TraceWriter::Close()
+{
+    Submit();
+    m_ring.Close();
+    m_thread.join();
+}
+
+void TraceWriter::Submit()
+{
+    std::string_view bytes(reinterpret_cast<char const*>(m_batch.data()), m_batch_size * sizeof(TraceRecord));
+    m_batch_size = 0;
+    while(true)
+    {
+        bytes.remove_prefix(m_ring.Push(bytes));
+        if(bytes.empty()) return;
+        m_ring.WaitForSpace();
+    }
+}
+
+void TraceWriter::Loop()
+{
+    while(true)
+    {
+        m_ring.WaitForData();
+        const std::span<char const> readable = m_ring.Readable();
+        if(readable.empty()) break; // Closed, and everything written
+        if(!m_failed)
+        {
+            m_file.write(readable.data(), static_cast<std::streamsize>(readable.size()));
+            m_failed = !m_file;
+        }
+        m_ring.Consume(readable.size());
+    }
+    m_file.flush();
+    if(!m_file) m_failed = true;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <thread>
+#include <type_traits>
+
+#include "instruction.h"
+#include "snapshot.h"
+#include "spsc_ring.h"
+#include "word.h"
+
+/**
+ * On-disk format of an execution trace, as written by TraceWriter. Every field is little-endian.
+ * The file is a TraceHeader followed by one TraceRecord per executed instruction, in order, so
+ * that record n is found at a fixed offset and a trace can be mapped into memory and indexed.
+ */
+struct TraceHeader
+{
+    static constexpr std::array<char, 8> expected_magic = {'S', 'Y', 'N', 'T', 'R', 'A', 'C', 'E'};
+    static constexpr std::uint32_t current_version = 1;
+
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t record_size; // Bytes
+};
+
+static_assert(sizeof(TraceHeader) == 16 && std::is_trivially_copyable_v<TraceHeader>);
+
+struct TraceRecord
+{
+    // What the instruction wrote, if anything, and where destination points to
+    enum Destination : std::uint8_t
+    {
+        NONE,
+        REGISTER, // destination is the register index
+        MEMORY,   // destination is the address
+        STACK,    // value was pushed. destination is unused
+        FAULT     // The instruction raised an error, and the machine stopped
+    };
+
+    std::uint64_t step;                                            // Index of the instruction since tracing started
+    raw_word_t instr_ptr;
+    std::uint8_t opcode;                                           // InstructionData::OpCode
+    Destination destination_kind;
+    std::array<raw_word_t, InstructionData::max_operands> operands; // As encoded in memory: registers are 32768 and up. Unused ones are zero.
+    raw_word_t destination;
+    raw_word_t value;                                              // Written to the destination
+    std::uint16_t stack_size;                                      // Words on the stack afterwards, saturated at 65535
+};
+
+static_assert(sizeof(TraceRecord) == 24 && std::is_trivially_copyable_v<TraceRecord>);
+
+constexpr TraceHeader LittleEndian(TraceHeader header) noexcept
+{
+    header.version = LittleEndian(header.version);
+    header.record_size = LittleEndian(header.record_size);
+    return header;
+}
+
+constexpr TraceRecord LittleEndian(TraceRecord record) noexcept
+{
+    record.step = LittleEndian(record.step);
+    record.instr_ptr = LittleEndian(record.instr_ptr);
+    for(raw_word_t& operand: record.operands) operand = LittleEndian(operand);
+    record.destination = LittleEndian(record.destination);
+    record.value = LittleEndian(record.value);
+    record.stack_size = LittleEndian(record.stack_size);
+    return record;
+}
+
+/**
+ * Streams trace records to a file without slowing the traced machine down to the speed of
+ * the disk. Records are gathered in a batch, which is copied into an SpscRing once full, and
+ * a background thread writes the ring out. The machine only waits when the ring is full.
+ */
+class TraceWriter
+{
+public:
+    static constexpr std::size_t batch_size = 4096;          // Records
+    static constexpr std::size_t default_ring_size = 1 << 24; // Bytes
+
+    explicit TraceWriter(char const* path, std::size_t ring_size = default_ring_size);
+
+    /**
+     * @brief Closes the writer, unless it already is.
+     */
+    ~TraceWriter();
+
+    TraceWriter(TraceWriter const&) = delete;
+    TraceWriter& operator=(TraceWriter const&) = delete;
+
+    /**
+     * @brief Whether the file could be opened, and the records written so far could be written.
+     *        Only covers every record once the writer is closed.
+     */
+    explicit operator bool() const noexcept { return !m_failed; }
+
+    /**
+     * @brief Number of records appended so far.
+     */
+    std::uint64_t size() const noexcept { return m_next_step; }
+
+    /**
+     * @brief Appends a record, numbering it with the next step.
+     */
+    void Append(TraceRecord record)
+    {
+        record.step = m_next_step++;
+        m_batch[m_batch_size++] = LittleEndian(record);
+        if(m_batch_size == m_batch.size()) Submit();
+    }
+
+    /**
+     * @brief Hands the current batch over to the background thread.
+     */
+    void Submit();
+
+    /**
+     * @brief Writes the remaining records out, and waits for the background thread to finish.
+     *        Nothing may be appended afterwards.
+     */
+    void Close();
+
+private:
+    void Loop();
+
+    std::ofstream m_file;
+    std::atomic<bool> m_failed = false; // Written by the background thread
+    std::uint64_t m_next_step = 0;
+    std::array<TraceRecord, batch_size> m_batch;
+    std::size_t m_batch_size = 0;
+    SpscRing m_ring;
+    std::thread m_thread; // Last, so that it starts once everything else is ready
+};
@@ -1,86 +1,479 @@
 #include "address.h"
+#include "breakpoints.h"
+#include "call_stack.h"
+#include "decode_cache.h"
+#include "execution_policy.h"
 #include "instruction.h"
+#include "jit_compiler.h"
+#include "machine_task.h"
+#include "memoizer.h"
+#include "output_sink.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "superinstruction.h"
+#include "trace.h"
 #include "flags.h"
+#include "history.h"
 #include "virtual_memory.h"
+#include "watchpoints.h"
+#include <array>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <istream>
+#include <optional>
 #include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 #pragma once
 
-class VirtualMachine
+/**
+ * @brief What IN does once every script has been read.
+ */
+enum class ScriptEnd
+{
+    HALT,        // Set HALTED, with the instruction pointer left at the IN
+    PAUSE,       // Set AWAITING_INPUT, so that a snapshot taken then resumes at the IN
+    READ_STREAM, // Read from the input stream
+};
+
+template<typename TPolicy>
+class BasicVirtualMachine
 {
 public:
     using program_file_t = Memory::program_file_t;
 
+    BasicVirtualMachine() = default;
+
+    /**
+     * @brief Clones the machine: memory, registers, stack, pending input and hooks.
+     *        Compiled blocks are not copied.
+     */
+    BasicVirtualMachine(BasicVirtualMachine const& other);
+    BasicVirtualMachine& operator=(BasicVirtualMachine const&) = delete;
+
+    /**
+     * @brief Clones the machine, for branching a search. Memory and decoded instructions
+     *        are shared page by page with this machine, and each side copies a page the first
+     *        time it writes to it, so a fork costs little more than the pages it dirties.
+     *        The memoization table, if enabled, is copied in full.
+     */
+    BasicVirtualMachine Fork() const { return BasicVirtualMachine(*this); }
+
+    /**
+     * @brief Continues from the state of another machine with the same hooks.
+     *        Pages of memory that differ are shared with the other machine, and decoded
+     *        instructions, compiled blocks and memoized results are only dropped for the
+     *        words that differ. Streams are not copied.
+     */
+    void CopyStateFrom(BasicVirtualMachine const& other);
+
     void LoadMemory(program_file_t& source);
+    void LoadMemory(std::span<raw_word_t const> image);
     void Run();
-    void RunDebug();
+
+    /**
+     * @brief Same as Resume, but runs one instruction at a time and appends a record of each to
+     *        the trace: its operands, and the value it wrote and where. Nothing else is slowed down.
+     */
+    void ResumeTraced(TraceWriter& trace);
+
+    /**
+     * @brief Same as Resume, but stops before an instruction at which a breakpoint is set and its
+     *        condition holds, other than the first one run. Straight-line blocks of code are only
+     *        looked up in the breakpoints when entered. Without breakpoints, this is ResumeThreaded.
+     * @returns whether it stopped at a breakpoint
+     */
+    bool ResumeUntilBreakpoint(Breakpoints& breakpoints);
+
+    /**
+     * @brief Same as above, but also records every RMEM and WMEM of a watched word, and stops
+     *        right after one that a watchpoint asks to pause at. Without breakpoints, watchpoints
+     *        nor history, this is ResumeThreaded.
+     * @returns whether it stopped at a breakpoint or a watchpoint
+     */
+    bool ResumeUntilBreakpoint(Breakpoints& breakpoints, Watchpoints& watchpoints);
+
+    /**
+     * @brief Makes Step and ResumeUntilBreakpoint record what every instruction they run changes,
+     *        so that TravelTo can bring the machine back. The history is owned by the caller, and is
+     *        cleared. nullptr stops recording. Forks do not record.
+     */
+    void SetHistory(History<BasicVirtualMachine>* history);
+
+    /**
+     * @brief Brings registers, memory, stack and instruction pointer back, or forward, to the state
+     *        after the given number of recorded instructions. Characters read by IN since then are
+     *        put back into the input, so that running forward again reads them again. Output is not undone.
+     * @returns false if that step is not in the history
+     */
+    bool TravelTo(std::uint64_t step);
+
+    /**
+     * @brief Same as Run, but each instruction jumps straight to the handler of the next one.
+     *        Falls back to Run on compilers without labels-as-values.
+     */
+    void RunThreaded();
+
+    /**
+     * @brief Same as Run, but basic blocks that run often are compiled to native code.
+     *        Blocks hand control back to the interpreter for I/O and for any instruction
+     *        that may raise an error. Falls back to Run where the JIT is not available.
+     */
+    void RunJit();
+
+    /**
+     * @brief Same as RunThreaded and RunJit, from the current state.
+     */
+    void ResumeThreaded();
+    void ResumeJit();
+
+    /**
+     * @brief Prepares the machine to be driven one instruction at a time, or by code
+     *        outside of the interpreter (such as a recompiled program). Run does this itself.
+     */
+    void Start();
+
+    /**
+     * @brief Executes the instruction at the instruction pointer, and records it into the history if
+     *        there is one. No-op once halted.
+     */
+    void Step();
+
+    /**
+     * @brief Runs from the current state until the program halts.
+     */
+    void Resume();
+
+    /**
+     * @brief Runs the program as a coroutine, which suspends whenever IN needs a line that has
+     *        not been handed over with ProvideInput yet, and carries on once it is and the task is
+     *        resumed. Lines are never read from the input stream or scripts. Uses RunThreaded.
+     */
+    MachineTask RunAsync();
+
+    /**
+     * @brief Same as RunAsync, from the current state.
+     */
+    MachineTask ResumeAsync();
+
+    constexpr bool IsRunning() const noexcept { return !m_flags.Is(Flags::HALTED | Flags::ERROR | Flags::AWAITING_INPUT); }
+
+    /**
+     * @brief Makes IN stop the machine, before reading anything, whenever the previous line has been
+     *        consumed. AWAITING_INPUT is then set and the instruction pointer is left at the IN, so that
+     *        the caller can choose the next line and hand it over with ProvideInput. Turning it off lets
+     *        a paused machine read from its input stream again.
+     */
+    constexpr void PauseOnInput(bool const pause) noexcept
+    {
+        m_pause_on_input = pause;
+        if(!pause) m_flags.UnSet(Flags::AWAITING_INPUT);
+    }
+
+    constexpr bool IsAwaitingInput() const noexcept { return m_flags.Is(Flags::AWAITING_INPUT); }
+
+    /**
+     * @brief Buffers a line, without its newline, for IN to read next. Clears AWAITING_INPUT.
+     */
+    void ProvideInput(std::string_view line);
+
+    /**
+     * @brief Writes registers, instruction pointer, flags, memory, stack and pending input
+     *        in the format described by SnapshotHeader. AWAITING_INPUT is not saved.
+     */
+    void SaveSnapshot(std::ostream& os) const;
+
+    /**
+     * @brief Continues from a state written by SaveSnapshot, for instance from a mapped file.
+     *        Decoded instructions, compiled blocks and memoized results are dropped; hooks are kept.
+     * @returns false if the snapshot is not valid, in which case the machine is left untouched
+     */
+    bool LoadSnapshot(std::span<std::byte const> snapshot);
+
+    /**
+     * @brief Writes a word to memory, dropping any decoded instruction it overwrites.
+     */
+    constexpr void WriteMemory(Address const ptr, Word const& val);
 
     constexpr Memory const& memory() const noexcept {return m_memory; }
-    void Print() const;
 
+    /**
+     * @brief Mutable access to memory. Writes that may hit code must go through WriteMemory instead.
+     *        Reading through it copies pages shared with forks: prefer the const overload.
+     */
+    constexpr Memory& memory() noexcept {return m_memory; }
+    constexpr std::span<Word, InstructionData::num_registers> registers() noexcept { return std::span(m_registers); }
+    constexpr std::span<Word const, InstructionData::num_registers> registers() const noexcept { return std::span(m_registers); }
+    constexpr Address& instr_ptr() noexcept { return m_instr_ptr; }
+    constexpr Address instr_ptr() const noexcept { return m_instr_ptr; }
+    constexpr CallStack& stack() noexcept { return m_stack; }
+    constexpr CallStack const& stack() const noexcept { return m_stack; }
+
+    /**
+     * @brief Sets the number of words the stack may hold. Pushing beyond it raises STACK_OVERFLOW.
+     */
+    constexpr void SetStackLimit(std::size_t const words) noexcept { m_stack.set_limit(words); }
+
+    /**
+     * @brief Prints registers, flags, memory around the instruction pointer and the top of the stack.
+     */
+    void Print(std::ostream& os = std::cout) const;
+
+    /**
+     * @brief Lists the superinstructions that were executed, how often, and from how many addresses.
+     */
+    void PrintFusionReport(std::ostream& os) const;
+
+    /**
+     * @brief Executions of each address and opcode so far.
+     */
+    ExecutionProfile const& profile() const noexcept requires TPolicy::profiled { return m_profile; }
+
+    /**
+     * @brief Caches the results of pure subroutines, so that calling them again with the same
+     *        inputs skips straight to their return. Not compatible with RunJit, which then falls back to Run.
+     * @param max_entries is the number of results after which no more are stored
+     */
+    void EnableMemoization(std::size_t max_entries = Memoizer::default_max_entries);
+
+    /**
+     * @brief Prints the hit rate and size of the memoization table.
+     */
+    void PrintMemoizationReport(std::ostream& os) const;
+
+    /**
+     * @brief Host function that replaces a subroutine. It reads its arguments from, and
+     *        leaves its results in, the registers and memory of the machine it is given.
+     */
+    using NativeHook = std::function<void(BasicVirtualMachine&)>;
+
+    /**
+     * @brief Replaces the subroutine at entry with a host function. Whenever control reaches
+     *        entry, the hook runs and then returns to the caller as if RET had been executed.
+     *        Calls to other addresses are not slowed down, since hooked addresses are
+     *        decoded as a NATIVE_HOOK instruction. Hooks are kept across LoadMemory.
+     */
+    void RegisterHook(Address entry, NativeHook hook);
+    void RemoveHook(Address entry);
+
+    /**
+     * @brief Sink that OUT writes to, for hooks that print.
+     */
+    constexpr OutputSink& output() noexcept { return *m_output; }
+
+    /**
+     * @brief Makes OUT write to a sink owned by the caller. Whatever the previous one buffered is flushed.
+     */
+    void SetOutput(OutputSink& sink);
+
+    /**
+     * @brief Makes OUT write to a stream, through a StreamSink owned by the machine.
+     */
+    void SetOutput(std::ostream& os);
+
+    /**
+     * @brief Delivers the characters that OUT has buffered. This happens on its own before IN
+     *        reads a new line and on HALT.
+     */
+    void FlushOutput() { m_output->Flush(); }
+
+    /**
+     * @brief Stream that IN reads lines from. Characters already read from the previous one are kept.
+     */
+    constexpr void SetInput(std::istream& is) noexcept { m_input_buffer.SetStream(is); }
+
+    /**
+     * @brief Whether IN would get a character that is either buffered or still in a script or the input stream.
+     */
+    bool HasPendingInput() { return m_input_buffer.HasPending(); }
+
+    /**
+     * @brief Queues text for IN to read before the input stream. The text is read in place rather
+     *        than copied, so it must outlive the machine, as a MappedFile of a script file would.
+     */
+    void AppendScript(std::string_view const text) { m_input_buffer.AppendScript(text); }
+    constexpr void SetScriptEnd(ScriptEnd const action) noexcept { m_input_buffer.SetScriptEnd(action); }
+
+    /**
+     * @brief Buffers the next line of a machine awaiting input, from the scripts or the input stream,
+     *        and clears AWAITING_INPUT. Lets the caller see the line before IN reads it.
+     * @returns the line without its newline, or nothing if there is no input left
+     */
+    std::optional<std::string_view> BufferNextLine();
 
 private:
     constexpr void ExecuteNextInstruction();
 
     /**
-     * @brief Obtain the register from its integer alias withput checking validity.
+     * @brief Same as ExecuteNextInstruction, but adds the instruction to the history, if any.
+     */
+    void ExecuteNextInstructionRecorded();
+
+    /**
+     * @brief Same as ExecuteNextInstruction, but also executes the instructions fused to it, if any.
+     */
+    constexpr void ExecuteNextSuperinstruction();
+
+    /**
+     * @brief Obtain the register from its decoded index withput checking validity.
      */
-    constexpr Word& DecodeRegisterUnsafe(Word const& w) noexcept;
+    constexpr Word& DecodeRegisterUnsafe(Operand const& arg) noexcept;
 
     /**
-     * @brief Obtain the register from its integer alias withput checking validity.
+     * @brief Obtain the register from its decoded index withput checking validity.
      */
-    constexpr Word const& DecodeRegisterUnsafe(Word const& w) const noexcept;
+    constexpr Word const& DecodeRegisterUnsafe(Operand const& arg) const noexcept;
 
     /**
-     * @brief Obtain the register from its integer alias
-     *        May set WRITE_ON_LITERAL, BAD_INTEGER and ERROR flags
+     * @brief Obtain the register a decoded operand refers to
+     *        May set WRITE_ON_LITERAL, BAD_INTEGER and ERROR flags under checked execution
      */
-    constexpr Word& DecodeRegister(Word & w);
+    constexpr Word& DecodeRegister(Operand const& arg);
 
     /**
-     * @brief Get the Word, or decode the register it aliases to.
-     *        Sets ERROR and BAD_INTEGER flags if the value is not valid
+     * @brief Get the literal, or the value of the register the operand refers to.
+     *        Sets ERROR and BAD_INTEGER flags under checked execution if the operand is not valid
      * 
-     * @param arg: The word to interpret
+     * @param arg: The decoded operand to interpret
+     */
+    constexpr Word const& GetValue(Operand const& arg);
+
+    /**
+     * @brief Obtain the register the N-th operand refers to.
+     *        Only checks validity if the operand types are not known at compile time.
+     */
+    template<std::size_t N, InstructionData::WordType... TModes>
+    constexpr Word& DecodeRegister(Operands<TModes...> const& args);
+
+    /**
+     * @brief Get the value of the N-th operand.
+     *        Only checks validity if the operand types are not known at compile time.
+     */
+    template<std::size_t N, InstructionData::WordType... TModes>
+    constexpr Word const& GetValue(Operands<TModes...> const& args);
+
+    /**
+     * @brief Interprets a word as an address.
+     *        Checked execution terminates on addresses outside of memory,
+     *        unchecked execution wraps them around.
+     */
+    constexpr Address ToAddress(Word const& w) const;
+
+    /**
+     * @brief Drops the decoded instructions, compiled blocks and memoized results that
+     *        depend on the word at ptr, if it may hold code.
+     */
+    constexpr void InvalidateCode(Address ptr);
+
+    /**
+     * @brief WriteMemory, as called from compiled blocks.
      */
-    constexpr Word const& GetValue(Word const& arg);
+    static void JitWriteCode(void* vm, std::uint32_t address, std::uint32_t value);
 
     /**
-     * @brief Executes the operation.
+     * @brief Executes the operation. There is one overload per opcode, and each is
+     *        instantiated once per combination of operand types.
      *        The instruction pointer is expected to be at the current instruction's opcode.
      *        After execution, the instruction pointer is left pointing at the next instruction. 
+     * @param args are the operands of the decoded instruction at the instruction pointer
+     */
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::HALT) void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::SET)  constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::PUSH) constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::POP)  constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::EQ)   constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::GT)   constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::JMP)  constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::JT)   constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::JF)   constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::ADD)  constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::MULT) constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::MOD)  constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::AND)  constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::OR)   constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::NOT)  constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::RMEM) constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::WMEM) constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::CALL) constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::RET)  constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::OUT)  void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::IN)   void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::NOOP) constexpr void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::NATIVE_HOOK) void Execute(TOperands const& args);
+    template<InstructionData::OpCode TOp, typename TOperands> constexpr void Execute(TOperands const& args);
+
+    /**
+     * @brief Executes the decoded instruction, with operand types fixed by TModeBits
+     *        (bit i is set if operand i is a register) or classified at run time.
+     */
+    template<InstructionData::OpCode TOp, std::uint8_t TModeBits>
+    static constexpr void ExecuteWithModes(BasicVirtualMachine& vm, DecodedInstruction const& instr);
+
+    using Handler = void (*)(BasicVirtualMachine&, DecodedInstruction const&);
+    using HandlerTable = std::array<std::array<Handler, DecodedInstruction::runtime_modes + 1>, InstructionData::num_opcodes>;
+
+    /**
+     * @brief Table of ExecuteWithModes instantiations, indexed by opcode and operand modes.
+     */
+    static constexpr HandlerTable MakeHandlerTable() noexcept;
+    static const HandlerTable handler_table;
+
+    /**
+     * @brief Executes a group of fused instructions, starting at head.
+     *        Execution stops early if an instruction raises an error or overwrites the group.
      */
-    template<InstructionData::OpCode TOp>
-    constexpr void Execute();
+    template<SuperinstructionData::Kind TKind>
+    static constexpr void ExecuteFused(BasicVirtualMachine& vm, DecodedInstruction const& head);
+
+    /**
+     * @brief Executes one of the instructions of a group and moves instr to the next one.
+     * @returns whether the rest of the group should be executed
+     */
+    template<InstructionData::OpCode TOp, bool TLast>
+    constexpr bool ExecuteFusedStep(DecodedInstruction const*& instr);
+
+    using FusedHandlerTable = std::array<Handler, SuperinstructionData::NUM_KINDS>;
+
+    /**
+     * @brief Table of ExecuteFused instantiations, indexed by kind of group.
+     */
+    static constexpr FusedHandlerTable MakeFusedHandlerTable() noexcept;
+    static const FusedHandlerTable fused_handler_table;
 
     /**
      * @brief Utility for instructions of type a=f(b,c).
      * @param op is expected to be of type (Word const&, Word const&) -> Word
      */
-    template<typename TOperator>
-    constexpr void ExecuteBinaryOp(TOperator const& op) noexcept;
+    template<typename TOperands, typename TOperator>
+    constexpr void ExecuteBinaryOp(TOperands const& args, TOperator const& op) noexcept;
 
     /**
      * @brief Utility for instructions of type a=f(b).
      * @param op is expected to be of type (Word const&) -> Word
      */
-    template<typename TOperator>
-    constexpr void ExecuteUnaryOp(TOperator const& op) noexcept;
+    template<typename TOperands, typename TOperator>
+    constexpr void ExecuteUnaryOp(TOperands const& args, TOperator const& op) noexcept;
 
     /**
-     * @brief Sets the base and stack pointers to the first free row of memory
+     * @brief Empties the stack
      */
     constexpr void StackInit() noexcept;
 
     /**
-     * @brief Pushes a value onto the stack and advances the stack pointer
+     * @brief Pushes a value onto the stack.
+     * Sets STACK_OVERFLOW and ERROR flags under any execution policy if the stack is at its limit.
      */
-    constexpr void StackPush(Word const& val) noexcept;
+    constexpr void StackPush(Word const& val);
 
     /**
-     * @brief Pulls a value from the stack and decreases the stack pointer
-     * Note that the value will not be removed until overwritten.
+     * @brief Pulls a value from the stack.
+     * Popping an empty stack sets STACK_UNDERFLOW and ERROR flags under checked execution,
+     * and HALTED otherwise. Either way, it returns zero.
      */
     constexpr Word StackPop() noexcept;
 
@@ -89,34 +482,128 @@ private:
     Flags m_flags;                         // Flags indicating side-effects of instructions
     Word m_registers[num_registers];       // General-purpose registers
     Address m_instr_ptr = 0;               // Register containing the instruction pointer: points to the next instruction's opcode
-    Address m_stack_base_ptr = 0;          // Register containing the base of the stack in memory
-    Address m_stack_ptr = 0;               // Register containing the current top of the stack
+    CallStack m_stack;                     // The stack, outside of the address space
     Word m_nul_register = 0;               // A register to read/write from when a worng adress is given.
     Memory m_memory;                       // The RAM
-    std::ostream * m_ostream = &std::cout; // Stream that OUT instruction ouputs to
+    DecodeCache m_decode_cache;            // Instructions decoded from m_memory, indexed by address
+    std::array<std::uint64_t, SuperinstructionData::NUM_KINDS> m_fusion_counts {}; // Executions of each kind of superinstruction
+    std::unique_ptr<JitCompiler> m_jit;    // Native code for hot blocks, only while running RunJit
+    std::unique_ptr<Memoizer> m_memoizer;  // Results of pure subroutines, if enabled
+    [[no_unique_address]] std::conditional_t<TPolicy::profiled, ExecutionProfile, NoProfile> m_profile; // Only under profiled execution
+    std::unordered_map<raw_word_t, NativeHook> m_hooks; // Host functions, indexed by the address they replace
+    std::unique_ptr<StreamSink> m_stream_sink = std::make_unique<StreamSink>(std::cout); // Set by SetOutput(std::ostream&)
+    OutputSink * m_output = m_stream_sink.get(); // Sink that OUT instruction ouputs to
+    bool m_pause_on_input = false;         // Whether IN stops the machine instead of reading a new line
+    History<BasicVirtualMachine>* m_history = nullptr; // Owned by the caller of SetHistory. Not copied.
 
     class TextBuffer
     {
     public:
         TextBuffer() noexcept {}
 
-        friend TextBuffer& operator>>(TextBuffer& tbuffer, Word& t)
+        TextBuffer(TextBuffer const& other)
+            : stream(other.stream)
+            , scripts(other.scripts)
+            , script_end(other.script_end)
+        {
+            CopyPending(other);
+        }
+
+        TextBuffer& operator=(TextBuffer const&) = delete;
+
+        constexpr void SetStream(std::istream& is) noexcept { stream = &is; }
+
+        void AppendScript(std::string_view const text) { scripts.push_back(text); }
+        constexpr void SetScriptEnd(ScriptEnd const action) noexcept { script_end = action; }
+        constexpr ScriptEnd GetScriptEnd() const noexcept { return script_end; }
+
+        void CopyPending(TextBuffer const& other) { SetPending(other.pending); }
+
+        std::string_view Pending() const noexcept { return pending; }
+
+        void SetPending(std::string_view const text)
+        {
+            line = text;
+            pending = line;
+        }
+
+        bool HasBuffered() const noexcept { return !pending.empty(); }
+
+        void Push(std::string_view const text)
+        {
+            line = text;
+            line.push_back('\n');
+            pending = line;
+        }
+
+        bool HasPending()
         {
-            if(tbuffer.ptr == tbuffer.data.size())
+            if(HasBuffered()) return true;
+            for(std::string_view const script: scripts)
             {
-                tbuffer.data.clear();
-                std::getline(std::cin, tbuffer.data);
-                tbuffer.data.push_back('\n');
-                tbuffer.ptr = 0;
+                if(!script.empty()) return true;
             }
-            t.lo() = tbuffer.data[tbuffer.ptr++];
-            t.hi() = 0;
-            return tbuffer;
+            return script_end == ScriptEnd::READ_STREAM && stream->peek() != std::istream::traits_type::eof();
         }
-    
+
+        /**
+         * @brief Buffers the next line, from the scripts while they last, and from the stream afterwards.
+         *        Lines of a script are not copied unless the last one is missing its newline.
+         * @returns false if the scripts are over and the stream is not to be read
+         */
+        bool Refill()
+        {
+            while(!scripts.empty())
+            {
+                std::string_view& script = scripts.front();
+                const std::size_t newline = script.find('\n');
+                if(newline != std::string_view::npos)
+                {
+                    pending = script.substr(0, newline + 1);
+                    script.remove_prefix(newline + 1);
+                    return true;
+                }
+                const std::string_view last = script;
+                scripts.pop_front();
+                if(!last.empty())
+                {
+                    Push(last);
+                    return true;
+                }
+            }
+            if(script_end != ScriptEnd::READ_STREAM) return false;
+
+            line.clear();
+            std::getline(*stream, line);
+            line.push_back('\n');
+            pending = line;
+            return true;
+        }
+
+        /**
+         * @brief Takes the next buffered character. There must be one.
+         */
+        char Take() noexcept
+        {
+            const char c = pending.front();
+            pending.remove_prefix(1);
+            return c;
+        }
+
     private:
-        std::string data;
-        std::size_t ptr = 0;
+        std::string_view pending;        // Characters of the current line yet to be read, in line or in a script
+        std::string line;                // Current line, if it is not a view into a script
+        std::istream* stream = &std::cin;
+        std::deque<std::string_view> scripts; // Text to read before the stream, owned by the caller
+        ScriptEnd script_end = ScriptEnd::READ_STREAM;
 
     } m_input_buffer; // Stream that IN instruction uses as a buffer
-};
\ No newline at end of file
+};
+
+extern template class BasicVirtualMachine<CheckedPolicy>;
+extern template class BasicVirtualMachine<UncheckedPolicy>;
+extern template class BasicVirtualMachine<ProfiledPolicy>;
+
+using VirtualMachine = BasicVirtualMachine<CheckedPolicy>;
+using UncheckedVirtualMachine = BasicVirtualMachine<UncheckedPolicy>;
+using ProfiledVirtualMachine = BasicVirtualMachine<ProfiledPolicy>;
@@ -0,0 +1,1334 @@
+#pragma once
+
+/**
+ * Member definitions of BasicVirtualMachine. Each execution policy is
+ * instantiated in its own translation unit so that the compiler's inlining
+ * budget is not shared between them.
+ */
+
+#include "virtual_machine.h"
+#include "address.h"
+#include "instruction.h"
+#include "word.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template<typename TPolicy>
+BasicVirtualMachine<TPolicy>::BasicVirtualMachine(BasicVirtualMachine const& other)
+    : m_flags(other.m_flags)
+    , m_instr_ptr(other.m_instr_ptr)
+    , m_stack(other.m_stack)
+    , m_memory(other.m_memory)
+    , m_decode_cache(other.m_decode_cache)
+    , m_memoizer(other.m_memoizer ? std::make_unique<Memoizer>(*other.m_memoizer) : nullptr)
+    , m_hooks(other.m_hooks)
+    , m_stream_sink(other.m_stream_sink ? std::make_unique<StreamSink>(other.m_stream_sink->stream()) : nullptr)
+    , m_output(other.m_output == other.m_stream_sink.get() ? m_stream_sink.get() : other.m_output)
+    , m_pause_on_input(other.m_pause_on_input)
+    , m_input_buffer(other.m_input_buffer)
+{
+    std::copy(std::begin(other.m_registers), std::end(other.m_registers), m_registers);
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::CopyStateFrom(BasicVirtualMachine const& other)
+{
+    m_flags = other.m_flags;
+    std::copy(std::begin(other.m_registers), std::end(other.m_registers), m_registers);
+    m_instr_ptr = other.m_instr_ptr;
+    m_stack = other.m_stack;
+    m_input_buffer.CopyPending(other.m_input_buffer);
+    if(m_memoizer) m_memoizer->AbandonCalls();
+
+    Memory const& mine = m_memory;
+    for(std::size_t page=0; page < Memory::num_pages; ++page)
+    {
+        if(mine.pages().SharesPage(other.m_memory.pages(), page)) continue;
+        for(std::size_t i=page * Memory::page_size; i < (page + 1) * Memory::page_size; ++i)
+        {
+            const Address ptr(static_cast<raw_word_t>(i));
+            if(mine[ptr] != other.m_memory[ptr]) InvalidateCode(ptr);
+        }
+        m_memory.pages().Share(other.m_memory.pages(), page);
+    }
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::LoadMemory(program_file_t& source)
+{
+    Address load_ptr = 0;
+    m_memory.load(source, load_ptr);
+    m_decode_cache.Clear();
+    m_jit.reset();
+    if(m_memoizer) m_memoizer->Clear();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::LoadMemory(std::span<raw_word_t const> const image)
+{
+    Address load_ptr = 0;
+    m_memory.load(image, load_ptr);
+    m_decode_cache.Clear();
+    m_jit.reset();
+    if(m_memoizer) m_memoizer->Clear();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::SaveSnapshot(std::ostream& os) const
+{
+    const std::string_view input = m_input_buffer.Pending();
+
+    SnapshotHeader header {};
+    header.magic = SnapshotHeader::expected_magic;
+    header.version = SnapshotHeader::current_version;
+    header.flags = m_flags.m_flags & ~Flags::AWAITING_INPUT;
+    for(std::size_t i=0; i < num_registers; ++i) header.registers[i] = m_registers[i].to_int();
+    header.instr_ptr = m_instr_ptr.get().to_int();
+    header.stack_size = m_stack.size();
+    header.stack_limit = m_stack.limit();
+    header.input_size = input.size();
+
+    header = LittleEndian(header);
+    os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    for(std::size_t page=0; page < Memory::num_pages; ++page)
+    {
+        WriteWords(os, m_memory.pages().page(page));
+    }
+    WriteWords(os, std::span(m_stack.begin(), m_stack.end()));
+    os.write(input.data(), static_cast<std::streamsize>(input.size()));
+}
+
+template<typename TPolicy>
+bool BasicVirtualMachine<TPolicy>::LoadSnapshot(std::span<std::byte const> const snapshot)
+{
+    constexpr std::size_t page_bytes = Memory::page_size * sizeof(Word);
+    constexpr std::size_t memory_bytes = Memory::num_pages * page_bytes;
+
+    if(snapshot.size() < sizeof(SnapshotHeader) + memory_bytes) return false;
+    SnapshotHeader header;
+    std::memcpy(&header, snapshot.data(), sizeof(header));
+    header = LittleEndian(header);
+
+    if(header.magic != SnapshotHeader::expected_magic || header.version != SnapshotHeader::current_version) return false;
+    if(header.flags > std::numeric_limits<Flags::flag_storage_t>::max()) return false;
+    if(header.instr_ptr >= Word::max_word || header.stack_size > header.stack_limit) return false;
+
+    const std::size_t stack_offset = sizeof(SnapshotHeader) + memory_bytes;
+    const std::size_t input_offset = stack_offset + header.stack_size * sizeof(Word);
+    if(header.stack_size > snapshot.size() / sizeof(Word) || input_offset > snapshot.size()) return false;
+    if(snapshot.size() - input_offset != header.input_size) return false;
+
+    m_flags = Flags(static_cast<Flags::flag_storage_t>(header.flags));
+    for(std::size_t i=0; i < num_registers; ++i) m_registers[i] = Word(header.registers[i]);
+    m_instr_ptr = Address(header.instr_ptr);
+
+    for(std::size_t page=0; page < Memory::num_pages; ++page)
+    {
+        ReadWords(snapshot.data() + sizeof(SnapshotHeader) + page * page_bytes, m_memory.pages().mutable_page(page));
+    }
+    m_decode_cache.Clear();
+    m_jit.reset();
+    if(m_memoizer) m_memoizer->Clear();
+
+    std::vector<Word> stack(header.stack_size);
+    ReadWords(snapshot.data() + stack_offset, stack);
+    m_stack.Clear();
+    m_stack.set_limit(header.stack_limit);
+    for(Word const& word: stack) m_stack.Push(word);
+
+    m_input_buffer.SetPending(std::string_view(reinterpret_cast<char const*>(snapshot.data() + input_offset), header.input_size));
+    return true;
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::ProvideInput(std::string_view const line)
+{
+    m_input_buffer.Push(line);
+    m_flags.UnSet(Flags::AWAITING_INPUT);
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::SetOutput(OutputSink& sink)
+{
+    FlushOutput();
+    m_output = &sink;
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::SetOutput(std::ostream& os)
+{
+    FlushOutput();
+    m_stream_sink = std::make_unique<StreamSink>(os);
+    m_output = m_stream_sink.get();
+}
+
+template<typename TPolicy>
+std::optional<std::string_view> BasicVirtualMachine<TPolicy>::BufferNextLine()
+{
+    if(!m_input_buffer.HasPending() || !m_input_buffer.Refill()) return std::nullopt;
+    m_flags.UnSet(Flags::AWAITING_INPUT);
+    std::string_view line = m_input_buffer.Pending();
+    line.remove_suffix(1);
+    return line;
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::Run()
+{
+    Start();
+    Resume();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::Start()
+{
+    StackInit();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::Step()
+{
+    if(!IsRunning()) return;
+    if(m_history) ExecuteNextInstructionRecorded();
+    else ExecuteNextInstruction();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::Resume()
+{
+    while(IsRunning())
+    {
+        ExecuteNextSuperinstruction();
+    }
+}
+
+template<typename TPolicy>
+MachineTask BasicVirtualMachine<TPolicy>::RunAsync()
+{
+    Start();
+    return ResumeAsync();
+}
+
+template<typename TPolicy>
+MachineTask BasicVirtualMachine<TPolicy>::ResumeAsync()
+{
+    PauseOnInput(true);
+    while(true)
+    {
+        ResumeThreaded();
+        if(!IsAwaitingInput()) co_return;
+        co_await std::suspend_always{};
+    }
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::RunJit()
+{
+    Start();
+    ResumeJit();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::ResumeJit()
+{
+    if(!JitCompiler::is_available || m_memoizer || TPolicy::profiled)
+    {
+        Resume();
+        return;
+    }
+
+    static_assert(sizeof(Word) == sizeof(std::uint16_t) && std::is_standard_layout_v<Word>);
+    static_assert(sizeof(Address) == sizeof(std::uint16_t) && std::is_standard_layout_v<Address>);
+
+    m_jit = std::make_unique<JitCompiler>();
+    JitContext context {
+        .registers = reinterpret_cast<std::uint16_t*>(m_registers),
+        .memory_pages = m_memory.pages().table(),
+        .stack_top = reinterpret_cast<std::uint16_t**>(m_stack.top_location()),
+        .stack_begin = reinterpret_cast<std::uint16_t* const*>(m_stack.begin_location()),
+        .stack_end = reinterpret_cast<std::uint16_t**>(m_stack.end_location()),
+        .stack_capacity = reinterpret_cast<std::uint16_t* const*>(m_stack.capacity_location()),
+        .code_pages = m_decode_cache.pages().table(),
+        .vm = this,
+        .write_code = &JitWriteCode
+    };
+
+    while(IsRunning())
+    {
+        if(const JitCompiler::Block block = m_jit->Find(m_instr_ptr))
+        {
+            const std::uint32_t exit = block(&context);
+            m_instr_ptr = Address(exit & 0xFFFF);
+            if(exit & JitCompiler::side_exit) ExecuteNextInstruction();
+            continue;
+        }
+
+        if(m_jit->CountRun(m_instr_ptr) && m_jit->Compile(m_decode_cache, m_memory, m_instr_ptr, TPolicy::checked))
+        {
+            continue;
+        }
+
+        ExecuteNextSuperinstruction();
+    }
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::EnableMemoization(std::size_t const max_entries)
+{
+    m_memoizer = std::make_unique<Memoizer>(max_entries);
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::RegisterHook(Address const entry, NativeHook hook)
+{
+    m_hooks.insert_or_assign(entry.get().to_int(), std::move(hook));
+    m_decode_cache.SetHook(entry, true);
+    if(m_jit) m_jit->Invalidate(entry);
+    if(m_memoizer) m_memoizer->Clear();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::RemoveHook(Address const entry)
+{
+    m_hooks.erase(entry.get().to_int());
+    m_decode_cache.SetHook(entry, false);
+    if(m_jit) m_jit->Invalidate(entry);
+    if(m_memoizer) m_memoizer->Clear();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::PrintMemoizationReport(std::ostream& os) const
+{
+    os << std::dec << "Memoization:\n";
+    if(!m_memoizer)
+    {
+        os << "- Disabled" << std::endl;
+        return;
+    }
+
+    const Memoizer::Statistics stats = m_memoizer->statistics();
+    const std::uint64_t calls = stats.hits + stats.misses;
+    os << "- Calls    : " << calls << '\n';
+    os << "- Hits     : " << stats.hits;
+    if(calls != 0) os << " (" << std::fixed << std::setprecision(1) << 100.0 * static_cast<double>(stats.hits) / static_cast<double>(calls) << "%)";
+    os << '\n';
+    os << "- Entries  : " << stats.entries << " (~" << stats.bytes / 1024 << " KiB)\n";
+    os << "- Rejected : " << stats.rejected << " (table full)" << std::endl;
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::ResumeTraced(TraceWriter& trace)
+{
+    const auto value_of = [&](Operand const& operand) {
+        return operand.type == InstructionData::REGISTER ? m_registers[operand.value.to_int()] : operand.value;
+    };
+
+    while(IsRunning())
+    {
+        // Copied before running the instruction, which may overwrite itself
+        DecodedInstruction const instr = m_decode_cache.Fetch(m_memory, m_instr_ptr);
+        const Address instr_ptr = m_instr_ptr;
+        const Word memory_destination = instr.opcode == InstructionData::WMEM ? value_of(instr.args[0]) : Word(0);
+
+        ExecuteNextInstruction();
+        if(instr.opcode == InstructionData::IN && m_instr_ptr == instr_ptr) break; // Stopped before reading
+
+        TraceRecord record {};
+        record.instr_ptr = instr_ptr.get().to_int();
+        record.opcode = static_cast<std::uint8_t>(instr.opcode);
+        for(std::size_t i=0; i < InstructionData::NumOperands(instr.opcode); ++i)
+        {
+            const raw_word_t value = instr.args[i].value.to_int();
+            record.operands[i] = instr.args[i].type == InstructionData::REGISTER ? static_cast<raw_word_t>(Word::max_word + value) : value;
+        }
+
+        if(m_flags.Is(Flags::ERROR))
+        {
+            record.destination_kind = TraceRecord::FAULT;
+        } else if(InstructionData::HasRegisterTarget(instr.opcode)) {
+            record.destination_kind = TraceRecord::REGISTER;
+            record.destination = instr.args[0].value.to_int();
+            record.value = m_registers[record.destination].to_int();
+        } else if(instr.opcode == InstructionData::WMEM) {
+            record.destination_kind = TraceRecord::MEMORY;
+            record.destination = memory_destination.to_int();
+            record.value = std::as_const(m_memory)[Address(memory_destination)].to_int();
+        } else if((instr.opcode == InstructionData::PUSH || instr.opcode == InstructionData::CALL) && !m_stack.empty()) {
+            record.destination_kind = TraceRecord::STACK;
+            record.value = m_stack.top().to_int();
+        }
+        record.stack_size = static_cast<std::uint16_t>(std::min<std::size_t>(m_stack.size(), 0xFFFF));
+        trace.Append(record);
+    }
+}
+
+namespace {
+
+/**
+ * @brief Whether an instruction never falls through to the next one. Conditional jumps do,
+ *        so a block scanned for breakpoints covers both of their outcomes.
+ */
+constexpr bool EndsBlock(InstructionData::OpCode const op) noexcept
+{
+    switch(op)
+    {
+        case InstructionData::HALT: case InstructionData::JMP: case InstructionData::CALL: case InstructionData::RET:
+        case InstructionData::WRONG_OPCODE: case InstructionData::NATIVE_HOOK:
+            return true;
+        default:
+            return false;
+    }
+}
+
+}
+
+template<typename TPolicy>
+bool BasicVirtualMachine<TPolicy>::ResumeUntilBreakpoint(Breakpoints& breakpoints)
+{
+    Watchpoints none;
+    return ResumeUntilBreakpoint(breakpoints, none);
+}
+
+template<typename TPolicy>
+bool BasicVirtualMachine<TPolicy>::ResumeUntilBreakpoint(Breakpoints& breakpoints, Watchpoints& watchpoints)
+{
+    if(breakpoints.empty() && watchpoints.empty() && !m_history)
+    {
+        ResumeThreaded();
+        return false;
+    }
+
+    const auto block_has_breakpoint = [&](raw_word_t const entry) {
+        if(const std::optional<bool> cached = breakpoints.CachedBlock(entry)) return *cached;
+        std::size_t address = entry;
+        bool found = false;
+        while(address < Word::max_word && !found)
+        {
+            found = breakpoints.Has(static_cast<raw_word_t>(address));
+            DecodedInstruction const& instr = m_decode_cache.Fetch(m_memory, Address(address));
+            address += instr.length;
+            if(EndsBlock(instr.opcode)) break;
+        }
+        breakpoints.CacheBlock(entry, std::min<std::size_t>(address, Word::max_word), found);
+        return found;
+    };
+
+    bool first = true;
+    while(IsRunning())
+    {
+        const bool checked = block_has_breakpoint(m_instr_ptr.get().to_int());
+        while(true)
+        {
+            if(checked && !first && breakpoints.ShouldStop(m_instr_ptr.get().to_int(), registers())) return true;
+            first = false;
+
+            DecodedInstruction const& instr = m_decode_cache.Fetch(m_memory, m_instr_ptr);
+            const InstructionData::OpCode op = instr.opcode;
+            Address next = m_instr_ptr;
+            next += instr.length;
+            if(op != InstructionData::RMEM && op != InstructionData::WMEM)
+            {
+                Step();
+                if(!IsRunning() || m_instr_ptr != next || EndsBlock(op)) break;
+                continue;
+            }
+
+            // Copied before running the instruction, which may overwrite itself
+            const raw_word_t instr_ptr = m_instr_ptr.get().to_int();
+            const Operand operand = instr.args[op == InstructionData::RMEM ? 1 : 0];
+            const raw_word_t address = (operand.type == InstructionData::REGISTER ? m_registers[operand.value.to_int()] : operand.value).to_int();
+            const auto access = op == InstructionData::RMEM ? Watchpoints::READ : Watchpoints::WRITE;
+            const bool watched = address < Word::max_word && watchpoints.Watches(address, access);
+            const raw_word_t old_value = watched ? std::as_const(m_memory)[Address(address)].to_int() : 0;
+
+            Step();
+            if(op == InstructionData::WMEM && address < Word::max_word) breakpoints.OnWrite(address);
+            if(watched && !m_flags.Is(Flags::ERROR))
+            {
+                const raw_word_t new_value = std::as_const(m_memory)[Address(address)].to_int();
+                if(watchpoints.Record(instr_ptr, address, access, old_value, new_value)) return true;
+            }
+            if(!IsRunning() || m_instr_ptr != next) break;
+        }
+    }
+    return false;
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::SetHistory(History<BasicVirtualMachine>* const history)
+{
+    m_history = history;
+    if(m_history) m_history->Clear();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::ExecuteNextInstructionRecorded()
+{
+    using Delta = typename History<BasicVirtualMachine>::Delta;
+
+    if(m_history->NeedsCheckpoint()) m_history->AddCheckpoint(*this);
+
+    // Copied before running the instruction, which may overwrite itself
+    DecodedInstruction const instr = m_decode_cache.Fetch(m_memory, m_instr_ptr);
+    const std::size_t stack_size = m_stack.size();
+    const raw_word_t memory_destination = instr.opcode == InstructionData::WMEM
+        ? (instr.args[0].type == InstructionData::REGISTER ? m_registers[instr.args[0].value.to_int()] : instr.args[0].value).to_int()
+        : 0;
+
+    ExecuteNextInstruction();
+    if(!IsRunning()) return; // Halted, failed or waiting for input: nothing to redo
+
+    Delta delta {m_instr_ptr.get().to_int(), Delta::NONE, 0, 0, static_cast<std::uint32_t>(m_stack.size())};
+    if(instr.opcode == InstructionData::NATIVE_HOOK || (instr.opcode == InstructionData::CALL && m_stack.size() != stack_size + 1))
+    {
+        delta.kind = Delta::OPAQUE;
+    } else if(InstructionData::HasRegisterTarget(instr.opcode)) {
+        delta.kind = instr.opcode == InstructionData::IN ? Delta::INPUT : Delta::REGISTER;
+        delta.destination = instr.args[0].value.to_int();
+        delta.value = m_registers[delta.destination].to_int();
+    } else if(instr.opcode == InstructionData::WMEM) {
+        delta.kind = Delta::MEMORY;
+        delta.destination = memory_destination;
+        delta.value = std::as_const(m_memory)[Address(memory_destination)].to_int();
+    } else if(m_stack.size() > stack_size) {
+        delta.kind = Delta::PUSH;
+        delta.value = m_stack.top().to_int();
+    }
+
+    m_history->Record(delta);
+    if(delta.kind == Delta::OPAQUE) m_history->AddCheckpoint(*this);
+}
+
+template<typename TPolicy>
+bool BasicVirtualMachine<TPolicy>::TravelTo(std::uint64_t const step)
+{
+    using Delta = typename History<BasicVirtualMachine>::Delta;
+
+    if(!m_history || step < m_history->oldest() || step > m_history->latest()) return false;
+    if(m_history->num_checkpoints() == 0) return true; // Nothing recorded yet, and step is now
+
+    // Input read between that step and now goes back in front of what is left to read, or is
+    // dropped from it when going forward, as it was read from there after travelling back
+    std::string read;
+    for(std::uint64_t s = std::min(step, m_history->now()); s < std::max(step, m_history->now()); ++s)
+    {
+        Delta const& delta = m_history->delta(s);
+        if(delta.kind == Delta::INPUT) read.push_back(static_cast<char>(delta.value));
+    }
+    std::string_view const pending = m_input_buffer.Pending();
+    const std::string input = step < m_history->now()
+        ? read + std::string(pending)
+        : std::string(pending.substr(std::min(read.size(), pending.size())));
+
+    auto const& checkpoint = m_history->CheckpointBefore(step);
+    CopyStateFrom(checkpoint.vm);
+    for(std::uint64_t s = checkpoint.step; s < step; ++s)
+    {
+        Delta const& delta = m_history->delta(s);
+        m_instr_ptr = delta.instr_ptr;
+        while(m_stack.size() > delta.stack_size) m_stack.Pop();
+        switch(delta.kind)
+        {
+            case Delta::NONE: case Delta::OPAQUE:       break;
+            case Delta::REGISTER: case Delta::INPUT:    m_registers[delta.destination] = delta.value; break;
+            case Delta::MEMORY:                         WriteMemory(Address(delta.destination), delta.value); break;
+            case Delta::PUSH:                           m_stack.Push(delta.value); break;
+        }
+    }
+
+    m_input_buffer.SetPending(input);
+    m_history->SetNow(step);
+    return true;
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::Print(std::ostream& os) const
+{
+    os << "Registers:\n";
+    os << "-instr : " 
+              << m_instr_ptr.get().hex_dump() <<" ("
+              << InstructionData::InstructionName(InstructionData::to_opcode(m_memory[m_instr_ptr]))
+              << ")\n";
+
+    for(size_t i=0; i<8; ++i)
+    {
+        os << "-data " << (char) ('a' + i) << ": " 
+                  << m_registers[i].hex_dump() 
+                  << " | " << std::setw(5) << std::setfill(' ') << m_registers[i].to_int()
+                  << " | " << m_registers[i].hi() << m_registers[i].lo() << '\n';
+    }
+
+    os << "\nFlags:\n";
+    os << "- HALTED   : " << m_flags.Is(Flags::HALTED) << '\n';
+    os << "- ERROR    : " << m_flags.Is(Flags::ERROR) << '\n';
+    os << "- BAD_INT  : " << m_flags.Is(Flags::BAD_INTEGER) << '\n';
+    os << "- STACK_UF : " << m_flags.Is(Flags::STACK_UNDERFLOW) << '\n';
+    os << "- W_ON_LIT : " << m_flags.Is(Flags::WRITE_ON_LITERAL) << '\n';
+    os << "- STACK_OF : " << m_flags.Is(Flags::STACK_OVERFLOW) << '\n';
+
+    os << "\nMemory around instruction pointer:\n";
+    const std::size_t instr_ptr_row = m_instr_ptr.get().to_int() / 8;
+    memory().hex_dump(instr_ptr_row, instr_ptr_row+2, m_instr_ptr.get().to_int(), os);
+
+    os << "\nStack (" << std::dec << m_stack.size() << " words, high-water mark " << m_stack.high_water_mark() << "):\n";
+    constexpr std::size_t max_printed = 16;
+    Word const* const first = m_stack.end() - std::min(m_stack.size(), max_printed);
+    if(first != m_stack.begin()) os << "  ...";
+    for(Word const* w = first; w != m_stack.end(); ++w)
+    {
+        os << "  " << w->hex_dump();
+    }
+    os << std::endl;
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::PrintFusionReport(std::ostream& os) const
+{
+    const auto sites = m_decode_cache.CountFusions();
+
+    std::array<std::size_t, SuperinstructionData::NUM_KINDS - 1> kinds;
+    std::iota(kinds.begin(), kinds.end(), SuperinstructionData::NONE + 1);
+    std::stable_sort(kinds.begin(), kinds.end(), [&](std::size_t lhs, std::size_t rhs) {
+        return m_fusion_counts[lhs] > m_fusion_counts[rhs];
+    });
+
+    os << std::dec << "Superinstructions:\n";
+    bool any_fired = false;
+    for(std::size_t kind: kinds)
+    {
+        if(m_fusion_counts[kind] == 0) continue;
+        any_fired = true;
+        os << "- " << std::setw(16) << std::setfill(' ') << std::left << SuperinstructionData::patterns[kind].name << std::right
+           << ": " << std::setw(12) << m_fusion_counts[kind] << " runs from "
+           << sites[kind] << " addresses\n";
+    }
+    if(!any_fired) os << "- None fired\n";
+    os << std::flush;
+}
+
+template<typename TPolicy>
+constexpr Word& BasicVirtualMachine<TPolicy>::DecodeRegisterUnsafe(Operand const& arg) noexcept
+{
+    return m_registers[arg.value.lo()];
+}
+
+template<typename TPolicy>
+constexpr Word const& BasicVirtualMachine<TPolicy>::DecodeRegisterUnsafe(Operand const& arg) const noexcept
+{
+    return m_registers[arg.value.lo()];
+}
+
+template<typename TPolicy>
+constexpr Word& BasicVirtualMachine<TPolicy>::DecodeRegister(Operand const& arg)
+{
+    switch(arg.type)
+    {
+        case InstructionData::REGISTER:
+            return DecodeRegisterUnsafe(arg);
+
+        case InstructionData::LITERAL:
+            if constexpr(TPolicy::checked) m_flags.Set(Flags::WRITE_ON_LITERAL | Flags::ERROR);
+            return m_nul_register;
+        
+        case InstructionData::INVALID:
+            if constexpr(TPolicy::checked) m_flags.Set(Flags::BAD_INTEGER | Flags::ERROR);
+            return m_nul_register;
+    }
+
+    if constexpr(TPolicy::checked) m_flags.Set(Flags::ERROR);
+    return m_nul_register;
+}
+
+template<typename TPolicy>
+constexpr Word const& BasicVirtualMachine<TPolicy>::GetValue(Operand const& arg)
+{
+    switch(arg.type)
+    {
+        case InstructionData::REGISTER: return DecodeRegisterUnsafe(arg);
+        case InstructionData::LITERAL:  return arg.value;
+        case InstructionData::INVALID:
+            if constexpr(TPolicy::checked) m_flags.Set(Flags::BAD_INTEGER | Flags::ERROR);
+            return m_nul_register;
+    }
+
+    if constexpr(TPolicy::checked) m_flags.Set(Flags::ERROR);
+    return m_nul_register;
+}
+
+template<typename TPolicy>
+template<std::size_t N, InstructionData::WordType... TModes>
+constexpr Word& BasicVirtualMachine<TPolicy>::DecodeRegister(Operands<TModes...> const& args)
+{
+    using TOperands = Operands<TModes...>;
+
+    if constexpr(TOperands::is_runtime)
+    {
+        return DecodeRegister(args.instr.args[N]);
+    } else {
+        static_assert(TOperands::Mode(N) == InstructionData::REGISTER);
+        return DecodeRegisterUnsafe(args.instr.args[N]);
+    }
+}
+
+template<typename TPolicy>
+template<std::size_t N, InstructionData::WordType... TModes>
+constexpr Word const& BasicVirtualMachine<TPolicy>::GetValue(Operands<TModes...> const& args)
+{
+    using TOperands = Operands<TModes...>;
+
+    if constexpr(TOperands::is_runtime)
+    {
+        return GetValue(args.instr.args[N]);
+    } else if constexpr(TOperands::Mode(N) == InstructionData::REGISTER) {
+        return DecodeRegisterUnsafe(args.instr.args[N]);
+    } else {
+        return args.instr.args[N].value;
+    }
+}
+
+template<typename TPolicy>
+constexpr Address BasicVirtualMachine<TPolicy>::ToAddress(Word const& w) const
+{
+    if constexpr(TPolicy::checked)
+    {
+        if(!Memory::IsValidAddress(w.to_int())) Memory::InvalidAccess(w.to_int());
+        return Address(w);
+    } else {
+        return Address(w.to_int() % Word::max_word);
+    }
+}
+
+template<typename TPolicy>
+constexpr void BasicVirtualMachine<TPolicy>::WriteMemory(Address const ptr, Word const& val)
+{
+    m_memory[ptr] = val;
+    InvalidateCode(ptr);
+}
+
+template<typename TPolicy>
+constexpr void BasicVirtualMachine<TPolicy>::InvalidateCode(Address const ptr)
+{
+    if(!m_decode_cache.Invalidate(ptr)) return;
+    if(m_jit) m_jit->Invalidate(ptr);
+    if(m_memoizer) m_memoizer->Clear();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::JitWriteCode(void* vm, std::uint32_t const address, std::uint32_t const value)
+{
+    static_cast<BasicVirtualMachine*>(vm)->WriteMemory(Address(address), Word(static_cast<raw_word_t>(value)));
+}
+
+template<typename TPolicy>
+constexpr void BasicVirtualMachine<TPolicy>::StackInit() noexcept
+{
+    m_stack.Clear();
+}
+
+template<typename TPolicy>
+constexpr void BasicVirtualMachine<TPolicy>::StackPush(Word const& val)
+{
+    if(!m_stack.Push(val)) [[unlikely]]
+    {
+        m_flags.Set(Flags::STACK_OVERFLOW | Flags::ERROR);
+    }
+}
+
+template<typename TPolicy>
+constexpr Word BasicVirtualMachine<TPolicy>::StackPop() noexcept
+{
+    if(m_stack.empty()) [[unlikely]]
+    {
+        if constexpr(TPolicy::checked) m_flags.Set(Flags::STACK_UNDERFLOW | Flags::ERROR);
+        else m_flags.Set(Flags::HALTED);
+        return Word(0);
+    }
+
+    return m_stack.Pop();
+}
+
+template<typename TPolicy>
+template<typename TOperands, typename TOperator>
+constexpr void BasicVirtualMachine<TPolicy>::ExecuteBinaryOp(TOperands const& args, TOperator const& Op) noexcept
+{
+    Word& a = DecodeRegister<0>(args);
+    const Word b = GetValue<1>(args);
+    const Word c = GetValue<2>(args);
+
+    a = Op(b,c);
+
+    m_instr_ptr += args.instr.length;
+}
+
+template<typename TPolicy>
+template<typename TOperands, typename TOperator>
+constexpr void BasicVirtualMachine<TPolicy>::ExecuteUnaryOp(TOperands const& args, TOperator const& Op) noexcept
+{
+    Word& a = DecodeRegister<0>(args);
+    const Word b = GetValue<1>(args);
+
+    a = Op(b);
+
+    m_instr_ptr += args.instr.length;
+}
+
+/** halt: 0
+ *      stop execution and terminate the program
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::HALT)
+void BasicVirtualMachine<TPolicy>::Execute(TOperands const&)
+{
+    m_flags.Set(Flags::HALTED);
+    FlushOutput();
+}
+
+/** set: 1 a b
+ *     set register <a> to the value of <b>
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::SET)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    ExecuteUnaryOp(args, [](Word const& b) { return b; });
+}
+
+/** push: 2 a
+ *       push <a> onto the stack
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::PUSH)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    StackPush(GetValue<0>(args));
+    m_instr_ptr += args.instr.length;
+}
+
+/** pop: 3 a
+ *      remove the top element from the stack and write it into <a>; empty stack = error
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::POP)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    Word& a = DecodeRegister<0>(args);
+    a = StackPop();
+    m_instr_ptr += args.instr.length;
+    if(m_memoizer) m_memoizer->Pop(m_stack.size());
+}
+
+/** eq: 4 a b c
+ *     set <a> to 1 if <b> is equal to <c>; set it to 0 otherwise
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::EQ)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    ExecuteBinaryOp(args, [](Word const& b, Word const& c){ return b == c; });
+}
+
+
+/** gt: 5 a b c
+ *     set <a> to 1 if <b> is greater than <c>; set it to 0 otherwise
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::GT)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+   ExecuteBinaryOp(args, [](Word const& b, Word const& c){ return b > c; });
+}
+
+/** jmp: 6 a
+ *      jump to <a>
+ */ 
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::JMP)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    const Word A = GetValue<0>(args);
+    m_instr_ptr = ToAddress(A);
+}
+
+/** jt: 7 a b
+ *     if <a> is nonzero, jump to <b>
+ */ 
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::JT)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    const Word A = GetValue<0>(args);
+    
+    if(!A.is_zero())
+    {
+        const auto B = ToAddress(GetValue<1>(args));
+        m_instr_ptr = B;
+    } else {
+        m_instr_ptr += args.instr.length;
+    }
+}
+
+/** jf: 8 a b
+ *      if <a> is zero, jump to <b>
+ */ 
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::JF)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    const Word A = GetValue<0>(args);
+    
+    if(A.is_zero())
+    {
+        const auto B = ToAddress(GetValue<1>(args));
+        m_instr_ptr = B;
+    } else {
+        m_instr_ptr += args.instr.length;
+    }
+}
+
+/** add: 9 a b c
+ *    assign into <a> the sum of <b> and <c> (modulo 32768)
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::ADD)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    ExecuteBinaryOp(args, [](Word const& b, Word const& c){ return b + c; });
+}
+
+/** mult: 10 a b c
+ *      store into <a> the product of <b> and <c> (modulo 32768)
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::MULT)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    ExecuteBinaryOp(args, [](Word const& b, Word const& c){ return b * c; });
+}
+
+/** mod: 11 a b c
+ *      store into <a> the remainder of <b> divided by <c>
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::MOD)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    ExecuteBinaryOp(args, [](Word const& b, Word const& c){ return b % c; });
+}
+
+/**and: 12 a b c
+ *     stores into <a> the bitwise and of <b> and <c>
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::AND)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    ExecuteBinaryOp(args, [](Word const& b, Word const& c){ return b & c; });
+}
+
+/**or: 13 a b c
+ *     stores into <a> the bitwise or of <b> and <c>
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::OR)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    ExecuteBinaryOp(args, [](Word const& b, Word const& c){ return b | c; });
+}
+
+/**not: 14 a b
+ *     stores 15-bit bitwise inverse of <b> in <a>
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::NOT)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    ExecuteUnaryOp(args, [](Word const& b) { return ~b; });
+}
+
+/** rmem: 15 a b
+ *      read memory at address <b> and write it to <a>
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::RMEM)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    Word& a = DecodeRegister<0>(args);
+    const auto b = ToAddress(GetValue<1>(args));
+
+    a = std::as_const(m_memory)[b];
+
+    m_instr_ptr += args.instr.length;
+}
+
+/** wmem: 16 a b
+ *      write the value from <b> into memory at address <a>
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::WMEM)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    const auto a = ToAddress(GetValue<0>(args));
+    const Word b = GetValue<1>(args);
+
+    m_instr_ptr += args.instr.length;
+
+    WriteMemory(a, b); // May invalidate args
+}
+
+/** call: 17 a
+ *      write the address of the next instruction to the stack and jump to <a>
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::CALL)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    const auto call_destination = ToAddress(GetValue<0>(args));
+    const auto return_destination = (m_instr_ptr += args.instr.length).get();
+    // A call answered from the memo must still overflow where the interpreter would
+    if(m_memoizer && m_stack.size() < m_stack.limit() && m_memoizer->Call(m_decode_cache, m_memory, call_destination, m_instr_ptr, m_stack.size(), registers()))
+    {
+        return; // Results are already in the registers
+    }
+    StackPush(return_destination);
+    m_instr_ptr = call_destination;
+    if constexpr(TPolicy::profiled) m_profile.Call(call_destination, m_stack.size());
+}
+
+/** ret: 18
+ *      remove the top element from the stack and jump to it; empty stack = halt
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::RET)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const&)
+{
+    const auto return_destination = ToAddress(StackPop());
+    m_instr_ptr = return_destination;
+    if(m_memoizer) m_memoizer->Return(m_stack.size(), m_instr_ptr, registers());
+    if constexpr(TPolicy::profiled) m_profile.Return(m_stack.size());
+}
+
+/** out: 19 a
+ *     write the character represented by ascii code <a> to the terminal
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::OUT)
+void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    m_output->Put(static_cast<char>(GetValue<0>(args).lo()));
+    m_instr_ptr += args.instr.length;
+}
+
+/** in: 20 a
+ *    read a character from the terminal and write its ascii code to <a>; it
+ *    can be assumed that once input starts, it will continue until a newline
+ *    is encountered; this means that you can safely read whole lines from the
+ *    keyboard and trust that they will be fully read
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::IN)
+void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    if(!m_input_buffer.HasBuffered())
+    {
+        FlushOutput();
+        if(m_pause_on_input)
+        {
+            m_flags.Set(Flags::AWAITING_INPUT);
+            return;
+        }
+        if(!m_input_buffer.Refill())
+        {
+            m_flags.Set(m_input_buffer.GetScriptEnd() == ScriptEnd::HALT ? Flags::HALTED : Flags::AWAITING_INPUT);
+            return;
+        }
+    }
+    Word& destination = DecodeRegister<0>(args);
+    destination.lo() = m_input_buffer.Take();
+    destination.hi() = 0;
+    m_instr_ptr += args.instr.length;
+}
+
+/** noop: 21
+ *      no operation
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::NOOP)
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    m_instr_ptr += args.instr.length;
+}
+
+/** native_hook
+ *      run the host function that replaces the subroutine at this address, then return as ret does
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands> requires (TOp == InstructionData::NATIVE_HOOK)
+void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    m_hooks.find(m_instr_ptr.get().to_int())->second(*this);
+    Execute<InstructionData::RET>(args);
+}
+
+/** wrong_opcode: 22 -- 0x7FFF
+ *      wrong opcode or instruction not implemented
+ */
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, typename TOperands>
+constexpr void BasicVirtualMachine<TPolicy>::Execute(TOperands const& args)
+{
+    m_flags.Set(Flags::ERROR);
+    Execute<InstructionData::HALT>(args);
+}
+
+namespace {
+
+/**
+ * Operand modes that the decoder can produce for an opcode. Other combinations either
+ * do not fit the opcode or write to a literal, and are classified at run time instead.
+ */
+template<InstructionData::OpCode TOp, std::uint8_t TModeBits>
+constexpr bool IsSpecializable() noexcept
+{
+    if(TModeBits == DecodedInstruction::runtime_modes) return false;
+    if((TModeBits >> InstructionData::NumOperands(TOp)) != 0) return false;
+    if(InstructionData::HasRegisterTarget(TOp) && (TModeBits & 1) == 0) return false;
+    return true;
+}
+
+template<std::uint8_t TModeBits, std::size_t... I>
+constexpr auto OperandsWithModes(std::index_sequence<I...>)
+    -> Operands<(((TModeBits >> I) & 1) ? InstructionData::REGISTER : InstructionData::LITERAL)...>;
+
+}
+
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, std::uint8_t TModeBits>
+constexpr void BasicVirtualMachine<TPolicy>::ExecuteWithModes(BasicVirtualMachine& vm, DecodedInstruction const& instr)
+{
+    if constexpr(IsSpecializable<TOp, TModeBits>())
+    {
+        using TOperands = decltype(OperandsWithModes<TModeBits>(std::make_index_sequence<InstructionData::NumOperands(TOp)>{}));
+        vm.template Execute<TOp>(TOperands{instr});
+    } else {
+        vm.template Execute<TOp>(Operands<>{instr});
+    }
+}
+
+template<typename TPolicy>
+constexpr auto BasicVirtualMachine<TPolicy>::MakeHandlerTable() noexcept -> HandlerTable
+{
+    constexpr auto table = []<std::size_t... TOps>(std::index_sequence<TOps...>)
+    {
+        constexpr auto row = []<InstructionData::OpCode TOp, std::uint8_t... TModeBits>(std::integer_sequence<std::uint8_t, TModeBits...>)
+        {
+            return std::array<Handler, sizeof...(TModeBits)>{ &BasicVirtualMachine::template ExecuteWithModes<TOp, TModeBits>... };
+        };
+
+        constexpr auto modes = std::make_integer_sequence<std::uint8_t, DecodedInstruction::runtime_modes + 1>{};
+        return HandlerTable{ row.template operator()<static_cast<InstructionData::OpCode>(TOps)>(modes)... };
+    };
+
+    return table(std::make_index_sequence<InstructionData::num_opcodes>{});
+}
+
+template<typename TPolicy>
+constinit const typename BasicVirtualMachine<TPolicy>::HandlerTable BasicVirtualMachine<TPolicy>::handler_table = MakeHandlerTable();
+
+template<typename TPolicy>
+template<InstructionData::OpCode TOp, bool TLast>
+constexpr bool BasicVirtualMachine<TPolicy>::ExecuteFusedStep(DecodedInstruction const*& instr)
+{
+    Execute<TOp>(Operands<>{*instr});
+    if constexpr(TLast)
+    {
+        return false;
+    } else {
+        if constexpr(TOp == InstructionData::POP || TOp == InstructionData::PUSH)
+        {
+            if(m_flags.Is(Flags::HALTED | Flags::ERROR)) return false;
+        }
+        instr += instr->length; // Instructions in a group are contiguous in the decode cache
+        return true;
+    }
+}
+
+template<typename TPolicy>
+template<SuperinstructionData::Kind TKind>
+constexpr void BasicVirtualMachine<TPolicy>::ExecuteFused(BasicVirtualMachine& vm, DecodedInstruction const& head)
+{
+    ++vm.m_fusion_counts[TKind];
+
+    DecodedInstruction const* instr = &head;
+    [&]<std::size_t... I>(std::index_sequence<I...>)
+    {
+        constexpr std::size_t size = SuperinstructionData::patterns[TKind].size;
+        static_cast<void>((vm.template ExecuteFusedStep<SuperinstructionData::patterns[TKind].opcodes[I], I + 1 == size>(instr) && ...));
+    }(std::make_index_sequence<SuperinstructionData::patterns[TKind].size>{});
+}
+
+template<typename TPolicy>
+constexpr auto BasicVirtualMachine<TPolicy>::MakeFusedHandlerTable() noexcept -> FusedHandlerTable
+{
+    return []<std::size_t... TKinds>(std::index_sequence<TKinds...>)
+    {
+        return FusedHandlerTable{ &BasicVirtualMachine::template ExecuteFused<static_cast<SuperinstructionData::Kind>(TKinds)>... };
+    }(std::make_index_sequence<SuperinstructionData::NUM_KINDS>{});
+}
+
+template<typename TPolicy>
+constinit const typename BasicVirtualMachine<TPolicy>::FusedHandlerTable BasicVirtualMachine<TPolicy>::fused_handler_table = MakeFusedHandlerTable();
+
+template<typename TPolicy>
+constexpr void BasicVirtualMachine<TPolicy>::ExecuteNextInstruction()
+{
+    DecodedInstruction const& instr = m_decode_cache.Fetch(m_memory, m_instr_ptr);
+    if constexpr(TPolicy::profiled) m_profile.Count(m_instr_ptr, instr.opcode);
+    handler_table[instr.opcode][instr.operand_modes](*this, instr);
+}
+
+template<typename TPolicy>
+constexpr void BasicVirtualMachine<TPolicy>::ExecuteNextSuperinstruction()
+{
+    if constexpr(TPolicy::profiled)
+    {
+        ExecuteNextInstruction();
+        return;
+    }
+
+    DecodedInstruction const& instr = m_decode_cache.Fetch(m_memory, m_instr_ptr);
+    if(instr.fusion != SuperinstructionData::NONE)
+    {
+        fused_handler_table[instr.fusion](*this, instr);
+        return;
+    }
+    handler_table[instr.opcode][instr.operand_modes](*this, instr);
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic" // Labels as values are a GNU extension
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::RunThreaded()
+{
+    Start();
+    ResumeThreaded();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::ResumeThreaded()
+{
+    if constexpr(TPolicy::profiled)
+    {
+        Resume();
+        return;
+    }
+    if(!IsRunning()) return;
+
+    // Indexed by opcode. The extra entry is for instructions whose operands may raise errors.
+    static constexpr void* dispatch_table[] = {
+        &&op_halt, &&op_set, &&op_push, &&op_pop, &&op_eq, &&op_gt, &&op_jmp, &&op_jt,
+        &&op_jf, &&op_add, &&op_mult, &&op_mod, &&op_and, &&op_or, &&op_not, &&op_rmem,
+        &&op_wmem, &&op_call, &&op_ret, &&op_out, &&op_in, &&op_noop, &&op_wrong_opcode,
+        &&op_native_hook, &&op_may_fault
+    };
+    static_assert(std::size(dispatch_table) == InstructionData::num_opcodes + 1);
+
+    DecodedInstruction const* instr;
+    std::size_t group_left = 0; // Instructions of the current superinstruction that have yet to start
+
+#define SYNACOR_DISPATCH()                                                  \
+    instr = &m_decode_cache.Fetch(m_memory, m_instr_ptr);                   \
+    if(instr->fusion != SuperinstructionData::NONE)                         \
+    {                                                                       \
+        ++m_fusion_counts[instr->fusion];                                   \
+        group_left = SuperinstructionData::patterns[instr->fusion].size - 1; \
+    }                                                                       \
+    goto *dispatch_table[instr->may_fault ? InstructionData::NATIVE_HOOK + 1 : instr->opcode]
+
+#define SYNACOR_STOP_ON_ERROR()                                             \
+    if(TPolicy::checked && m_flags.Is(Flags::HALTED | Flags::ERROR)) return
+
+#define SYNACOR_DISPATCH_CHECKED()                                          \
+    SYNACOR_STOP_ON_ERROR();                                                \
+    SYNACOR_DISPATCH()
+
+// Overflowing or emptying the stack stops the program, whatever the execution policy
+#define SYNACOR_STOP_ON_STACK_ERROR()                                       \
+    if(m_flags.Is(Flags::HALTED | Flags::ERROR)) return
+
+// IN may have stopped the machine to wait for input, or because the scripts are over
+#define SYNACOR_STOP_AFTER_INPUT()                                          \
+    if(m_flags.Is(Flags::HALTED | Flags::AWAITING_INPUT)) return
+
+// Instructions in a superinstruction are contiguous in the decode cache, and never fault.
+// If the current one was invalidated, so was the rest of the group.
+#define SYNACOR_CONTINUE_GROUP()                                            \
+    if(group_left != 0 && instr->is_decoded())                              \
+    {                                                                       \
+        --group_left;                                                       \
+        instr += instr->length;                                             \
+        goto *dispatch_table[instr->opcode];                                \
+    }                                                                       \
+    group_left = 0
+
+    SYNACOR_DISPATCH();
+
+    op_halt:          Execute<InstructionData::HALT>(Operands<>{*instr});         return;
+    op_set:           Execute<InstructionData::SET>(Operands<>{*instr});          SYNACOR_DISPATCH();
+    op_push:          Execute<InstructionData::PUSH>(Operands<>{*instr});         SYNACOR_STOP_ON_STACK_ERROR(); SYNACOR_CONTINUE_GROUP(); SYNACOR_DISPATCH();
+    op_pop:           Execute<InstructionData::POP>(Operands<>{*instr});          SYNACOR_STOP_ON_STACK_ERROR(); SYNACOR_CONTINUE_GROUP(); SYNACOR_DISPATCH();
+    op_eq:            Execute<InstructionData::EQ>(Operands<>{*instr});           SYNACOR_CONTINUE_GROUP(); SYNACOR_DISPATCH();
+    op_gt:            Execute<InstructionData::GT>(Operands<>{*instr});           SYNACOR_CONTINUE_GROUP(); SYNACOR_DISPATCH();
+    op_jmp:           Execute<InstructionData::JMP>(Operands<>{*instr});          SYNACOR_DISPATCH();
+    op_jt:            Execute<InstructionData::JT>(Operands<>{*instr});           SYNACOR_DISPATCH();
+    op_jf:            Execute<InstructionData::JF>(Operands<>{*instr});           SYNACOR_DISPATCH();
+    op_add:           Execute<InstructionData::ADD>(Operands<>{*instr});          SYNACOR_CONTINUE_GROUP(); SYNACOR_DISPATCH();
+    op_mult:          Execute<InstructionData::MULT>(Operands<>{*instr});         SYNACOR_DISPATCH();
+    op_mod:           Execute<InstructionData::MOD>(Operands<>{*instr});          SYNACOR_DISPATCH();
+    op_and:           Execute<InstructionData::AND>(Operands<>{*instr});          SYNACOR_DISPATCH();
+    op_or:            Execute<InstructionData::OR>(Operands<>{*instr});           SYNACOR_DISPATCH();
+    op_not:           Execute<InstructionData::NOT>(Operands<>{*instr});          SYNACOR_DISPATCH();
+    op_rmem:          Execute<InstructionData::RMEM>(Operands<>{*instr});         SYNACOR_DISPATCH();
+    op_wmem:          Execute<InstructionData::WMEM>(Operands<>{*instr});         SYNACOR_DISPATCH();
+    op_call:          Execute<InstructionData::CALL>(Operands<>{*instr});         SYNACOR_STOP_ON_STACK_ERROR(); SYNACOR_DISPATCH();
+    op_ret:           Execute<InstructionData::RET>(Operands<>{*instr});          SYNACOR_STOP_ON_STACK_ERROR(); SYNACOR_DISPATCH();
+    op_out:           Execute<InstructionData::OUT>(Operands<>{*instr});          SYNACOR_DISPATCH();
+    op_in:            Execute<InstructionData::IN>(Operands<>{*instr});           SYNACOR_STOP_AFTER_INPUT(); SYNACOR_DISPATCH();
+    op_noop:          Execute<InstructionData::NOOP>(Operands<>{*instr});         SYNACOR_DISPATCH();
+    op_wrong_opcode:  Execute<InstructionData::WRONG_OPCODE>(Operands<>{*instr}); return;
+    op_native_hook:   Execute<InstructionData::NATIVE_HOOK>(Operands<>{*instr});  SYNACOR_STOP_ON_STACK_ERROR(); SYNACOR_DISPATCH();
+    op_may_fault:     ExecuteNextInstruction();                                   SYNACOR_STOP_AFTER_INPUT(); SYNACOR_DISPATCH_CHECKED();
+
+#undef SYNACOR_CONTINUE_GROUP
+#undef SYNACOR_STOP_AFTER_INPUT
+#undef SYNACOR_STOP_ON_STACK_ERROR
+#undef SYNACOR_DISPATCH_CHECKED
+#undef SYNACOR_STOP_ON_ERROR
+#undef SYNACOR_DISPATCH
+}
+
+#pragma GCC diagnostic pop
+#else
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::RunThreaded()
+{
+    Run();
+}
+
+template<typename TPolicy>
+void BasicVirtualMachine<TPolicy>::ResumeThreaded()
+{
+    Resume();
+}
+
+#endif
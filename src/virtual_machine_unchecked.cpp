@@ -0,0 +1,3 @@
+#include "virtual_machine_impl.h"
+
+template class BasicVirtualMachine<UncheckedPolicy>;
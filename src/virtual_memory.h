@@ -1,45 +1,59 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <array>
 #include <ostream>
+#include <span>
 #include <sys/types.h>
 
 #include "word.h"
 #include "instruction.h"
 #include "address.h"
-
+#include "shared_pages.h"
+
+/**
+ * The address space, split into pages that copies of the memory share until one of them
+ * writes to a page. Copying the memory is then cheap, and only the pages that each copy
+ * writes to take space.
+ *
+ * Reading through a non-const Memory counts as writing: the page is copied if shared.
+ * Code that only reads should go through a const reference.
+ */
 class Memory
 {
+public:
+    static constexpr std::size_t page_size = 512; // Words
+    using Page = std::array<Word, page_size>;
+
+private:
     static constexpr raw_word_t address_space = Word::max_word;
 
     constexpr void AssertValidAddress(
         [[maybe_unused]] const raw_word_t raw_ptr) const noexcept
     {
-#ifndef DNDEBUG
-        if(raw_ptr < address_space) return;
-
-        std::cerr << "Invalid access to address " << raw_ptr << std::endl;
-        exit(EXIT_FAILURE);
+#ifndef NDEBUG
+        if(IsValidAddress(raw_ptr)) return;
+        InvalidAccess(raw_ptr);
 #endif
     }
 
-    constexpr Word& dereference(const raw_word_t raw_ptr)
+    Word& dereference(const raw_word_t raw_ptr)
     {
         AssertValidAddress(raw_ptr);
-        return m_data[raw_ptr];
+        return m_pages.mutable_page(raw_ptr / page_size)[raw_ptr % page_size];
     }
 
     constexpr Word const& dereference(const raw_word_t raw_ptr) const
     {
         AssertValidAddress(raw_ptr);
-        return m_data[raw_ptr];
+        return m_pages.page(raw_ptr / page_size)[raw_ptr % page_size];
     }
 
-    constexpr Word& dereference(const Address ptr)
+    Word& dereference(const Address ptr)
     {
         return dereference(ptr.get().to_int());
     }
@@ -52,10 +66,18 @@ class Memory
 
 public:
     using program_file_t = std::ifstream;
+    using Pages = SharedPages<Page, address_space / page_size>;
+    static constexpr std::size_t num_pages = Pages::num_pages;
+
+    static constexpr bool IsValidAddress(const raw_word_t raw_ptr) noexcept
+    {
+        return raw_ptr < address_space;
+    }
 
-    constexpr Memory()
+    [[noreturn]] static void InvalidAccess(const raw_word_t raw_ptr)
     {
-        std::fill(m_data.begin(), m_data.end(), static_cast<raw_word_t>(0));
+        std::cerr << "Invalid access to address " << raw_ptr << std::endl;
+        exit(EXIT_FAILURE);
     }
 
     void load(program_file_t& source, Address& load_ptr)
@@ -78,7 +100,19 @@ public:
         }
     };
 
-    constexpr Word& operator[](auto const& ptr)
+    /**
+     * @brief Copies an image of the program into memory, starting at load_ptr.
+     *        Leaves load_ptr one past the last word.
+     */
+    void load(std::span<raw_word_t const> const image, Address& load_ptr)
+    {
+        for(raw_word_t const word: image)
+        {
+            dereference(load_ptr++) = Word(word);
+        }
+    }
+
+    Word& operator[](auto const& ptr)
     {
         return dereference(ptr);
     }
@@ -88,47 +122,54 @@ public:
         return dereference(ptr);
     }
 
-    void hex_dump(const std::size_t row_begin, const std::size_t row_end, const std::size_t highlight = address_space+1) const
+    /**
+     * @brief Pages, for comparing memories page by page and for compiled code.
+     */
+    constexpr Pages const& pages() const noexcept { return m_pages; }
+    constexpr Pages& pages() noexcept { return m_pages; }
+
+    void hex_dump(const std::size_t row_begin, const std::size_t row_end, const std::size_t highlight = address_space+1, std::ostream& os = std::cout) const
     {
         constexpr std::size_t row_size = 0x08;
+        const std::size_t end = std::min(row_end, address_space / row_size) * row_size; // Rows past the address space are left out
 
-        for(std::size_t i = row_begin*row_size; i != row_end*row_size; i += row_size)
+        for(std::size_t i = row_begin*row_size; i < end; i += row_size)
         {
-            std::cout << std::hex << std::setfill('0') << std::setw(4) << i;
-            std::cout << ':';
+            os << std::hex << std::setfill('0') << std::setw(4) << i;
+            os << ':';
 
             for(std::size_t j=0; j < row_size; ++j)
             {
                 const auto address = i + j;
                 
-                if(address == highlight)    std::cout << '[';
-                else                        std::cout << ' ';
+                if(address == highlight)    os << '[';
+                else                        os << ' ';
 
-                std::cout << m_data[address].hex_dump();
+                os << dereference(static_cast<raw_word_t>(address)).hex_dump();
 
-                if(address == highlight)    std::cout << ']';
-                else                        std::cout << ' ';
+                if(address == highlight)    os << ']';
+                else                        os << ' ';
 
             }
 
-            std::cout << " | ";
+            os << " | ";
 
             for(std::size_t j=0; j < row_size; ++j)
             {
-                const auto lo = m_data[i+j].lo();
+                const auto lo = dereference(static_cast<raw_word_t>(i+j)).lo();
                 if(lo > 32)
-                    std::cout << static_cast<char>(lo);
+                    os << static_cast<char>(lo);
                 else
-                    std::cout << '.';
+                    os << '.';
             }
 
-            std::cout << '\n';
+            os << '\n';
         }
-        std::cout << '\n';
+        os << '\n';
     }
 
 private:
-    std::array<Word, address_space> m_data;
+    Pages m_pages; // All zero at first
 
     static constexpr Address first = 0;
     static constexpr Address last = address_space-1;
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+
+#include "word.h"
+
+/**
+ * Ranges of memory that BasicVirtualMachine::ResumeUntilBreakpoint watches for reads through
+ * RMEM and writes through WMEM. Whether an access is watched takes a single bit test, in one
+ * bitmap for reads and one for writes, so accesses elsewhere cost next to nothing.
+ *
+ * Every access to a watched word is recorded, with the instruction that made it. The machine
+ * also stops right after it if a watchpoint covering the word asks to pause or to snapshot.
+ */
+class Watchpoints
+{
+public:
+    static constexpr std::size_t max_hits = 1 << 16; // Oldest ones are dropped first
+
+    enum Access : std::uint8_t { READ = 1, WRITE = 2, READ_WRITE = READ | WRITE };
+
+    enum Action : std::uint8_t
+    {
+        LOG,     // Only record the access
+        PAUSE,   // Record it, and stop
+        SNAPSHOT // Record it, and stop so that the state of the machine can be saved
+    };
+
+    struct Watchpoint
+    {
+        raw_word_t last; // Inclusive
+        Access access;
+        Action action;
+    };
+
+    struct Hit
+    {
+        std::uint64_t index; // Number of hits before this one
+        raw_word_t instr_ptr;
+        raw_word_t address;
+        Access access;
+        Action action;       // The strongest of the watchpoints covering the address
+        raw_word_t old_value;
+        raw_word_t new_value; // Same as old_value for a read
+    };
+
+    /**
+     * @brief Watches the words from first to last, inclusive, replacing any watchpoint starting at first.
+     */
+    void Set(raw_word_t const first, raw_word_t const last, Access const access, Action const action = LOG)
+    {
+        m_watchpoints[first] = Watchpoint{std::max(first, last), access, action};
+        Rebuild();
+    }
+
+    /**
+     * @returns whether there was a watchpoint starting at the address
+     */
+    bool Remove(raw_word_t const first)
+    {
+        if(m_watchpoints.erase(first) == 0) return false;
+        Rebuild();
+        return true;
+    }
+
+    bool empty() const noexcept { return m_watchpoints.empty(); }
+
+    /**
+     * @brief Every watchpoint, by first address.
+     */
+    std::map<raw_word_t, Watchpoint> const& all() const noexcept { return m_watchpoints; }
+
+    bool Watches(raw_word_t const address, Access const access) const noexcept
+    {
+        return access == READ ? m_reads.test(address) : m_writes.test(address);
+    }
+
+    /**
+     * @brief Records an access to a watched word.
+     * @returns whether the machine should stop
+     */
+    bool Record(raw_word_t const instr_ptr, raw_word_t const address, Access const access, raw_word_t const old_value, raw_word_t const new_value)
+    {
+        Action action = LOG;
+        for(auto const& [first, watchpoint]: m_watchpoints)
+        {
+            if(first > address) break;
+            if(address <= watchpoint.last && (watchpoint.access & access) != 0) action = std::max(action, watchpoint.action);
+        }
+
+        if(m_hits.size() == max_hits) m_hits.pop_front();
+        m_hits.push_back(Hit{m_num_hits++, instr_ptr, address, access, action, old_value, new_value});
+        return action != LOG;
+    }
+
+    /**
+     * @brief The latest hits, oldest first.
+     */
+    std::deque<Hit> const& hits() const noexcept { return m_hits; }
+
+    /**
+     * @brief Number of hits recorded since the last ClearHits, including dropped ones.
+     */
+    std::uint64_t num_hits() const noexcept { return m_num_hits; }
+
+    void ClearHits() noexcept
+    {
+        m_hits.clear();
+        m_num_hits = 0;
+    }
+
+private:
+    void Rebuild() noexcept
+    {
+        m_reads.reset();
+        m_writes.reset();
+        for(auto const& [first, watchpoint]: m_watchpoints)
+        {
+            for(std::size_t address = first; address <= watchpoint.last; ++address)
+            {
+                if(watchpoint.access & READ)  m_reads.set(address);
+                if(watchpoint.access & WRITE) m_writes.set(address);
+            }
+        }
+    }
+
+    std::map<raw_word_t, Watchpoint> m_watchpoints;
+    std::bitset<Word::max_word> m_reads;
+    std::bitset<Word::max_word> m_writes;
+
+    std::deque<Hit> m_hits;
+    std::uint64_t m_num_hits = 0;
+};
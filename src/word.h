@@ -18,23 +18,47 @@ public:
     enum byte{LO, HI};
     static constexpr raw_word_t max_word = 0x8000;
 
-    raw_byte_t data[2] = {0, 0};
+    /**
+     * Mutable view of one of the bytes of a word
+     */
+    class ByteReference
+    {
+    public:
+        constexpr ByteReference(raw_word_t& word, byte b) noexcept
+            : m_word(word), m_shift(b == LO ? 0 : 8)
+        { }
+
+        constexpr ByteReference& operator=(raw_byte_t in) noexcept
+        {
+            m_word = static_cast<raw_word_t>((m_word & ~(0x00FF << m_shift)) | (in << m_shift));
+            return *this;
+        }
+
+        constexpr operator raw_byte_t() const noexcept
+        {
+            return static_cast<raw_byte_t>(m_word >> m_shift);
+        }
+
+    private:
+        raw_word_t& m_word;
+        unsigned m_shift;
+    };
 
     constexpr Word() = default;
-    constexpr Word(const bool in) noexcept {lo() = in; }
+    constexpr Word(const bool in) noexcept : m_value(in) { }
     constexpr Word(Word const& word) = default;
 
-    constexpr Word(raw_byte_t in) noexcept { lo() = in; }
+    constexpr Word(raw_byte_t in) noexcept : m_value(in) { }
 
     constexpr Word(std::integral auto in) noexcept;
 
     constexpr Word& operator=(Word const& word) = default;
 
-    constexpr raw_byte_t& lo() noexcept { return data[LO];};
-    constexpr raw_byte_t& hi() noexcept { return data[HI];};
+    constexpr ByteReference lo() noexcept { return {m_value, LO}; };
+    constexpr ByteReference hi() noexcept { return {m_value, HI}; };
 
-    constexpr raw_byte_t lo() const noexcept { return data[LO];};
-    constexpr raw_byte_t hi() const noexcept { return data[HI];};
+    constexpr raw_byte_t lo() const noexcept { return static_cast<raw_byte_t>(m_value); };
+    constexpr raw_byte_t hi() const noexcept { return static_cast<raw_byte_t>(m_value >> 8); };
 
     constexpr Word& operator++() noexcept;
     constexpr Word operator++(int) noexcept;
@@ -71,33 +95,31 @@ public:
 
     constexpr bool is_zero() const noexcept
     {
-        return hi() == 0 && lo() == 0;
+        return m_value == 0;
     }
 
     constexpr Word flip() const noexcept;
 
     constexpr raw_word_t get_raw() const noexcept
     {
-        return (static_cast<raw_word_t>(lo()) << 8) | hi();
+        return static_cast<raw_word_t>((m_value << 8) | (m_value >> 8));
     }
 
     constexpr Word& set_raw(raw_word_t inp) noexcept
     {
-        data[LO] = inp & 0x00FF;
-        data[HI] = inp >> 8;
+        m_value = inp;
         return *this;
     }
     
     constexpr Word& set_raw(raw_byte_t lo, raw_byte_t hi) noexcept
     {
-        data[LO] = lo;
-        data[HI] = hi;
+        m_value = static_cast<raw_word_t>((hi << 8) | lo);
         return *this;
     }
 
     constexpr raw_word_t to_int() const noexcept
     {
-        return (static_cast<raw_word_t>(hi()) << 8) | lo();
+        return m_value;
     }
 
     std::string hex_dump() const
@@ -107,31 +129,20 @@ public:
         return ss.str();
     }
 
+private:
+    raw_word_t m_value = 0; // Native integer. Only arithmetic results are reduced modulo max_word.
 };
 
 
 
 constexpr Word::Word(std::integral auto in) noexcept
+    : m_value(static_cast<raw_word_t>(in))
 {
-    lo() = (in & 0x00FF);
-    hi() = (in >> 8) & 0x00FF;
 }
 
 constexpr Word& Word::operator+=(const raw_word_t jump) noexcept
 {
-    const raw_byte_t jump_lo = jump & 0x00FF;
-    const raw_byte_t jump_hi = jump >> 8;
-
-    if(lo() > (0x00FF-jump_lo))
-    {
-        hi() += 1;
-    }
-
-    lo() += jump_lo;
-    hi() += jump_hi;
-
-    hi() %= (max_word>>8);
-
+    m_value = (m_value + jump) % max_word;
     return *this;
 }
 
@@ -154,19 +165,7 @@ constexpr Word Word::operator+(Word const& other) const noexcept
 
 constexpr Word& Word::operator-=(const raw_word_t jump) noexcept
 {
-    const raw_byte_t jump_lo = jump & 0x00FF;
-    const raw_byte_t jump_hi = jump >> 8;
-
-    if(lo() < jump_lo)
-    {
-        --hi();
-    }
-
-    lo() -= jump_lo;
-    hi() -= jump_hi;
-
-    hi() %= (max_word>>8);
-
+    m_value = static_cast<raw_word_t>(m_value - jump) % max_word;
     return *this;
 }
 
@@ -189,7 +188,8 @@ constexpr Word Word::operator-(Word const& other) const noexcept
 
 constexpr Word& Word::operator*=(Word const& other) noexcept
 {
-    return *this = (this->to_int() * other.to_int()) % max_word;
+    m_value = static_cast<raw_word_t>((std::uint32_t{m_value} * other.m_value) % max_word);
+    return *this;
 }
 
 constexpr Word Word::operator*(Word const& other) const noexcept
@@ -199,7 +199,8 @@ constexpr Word Word::operator*(Word const& other) const noexcept
 
 constexpr Word& Word::operator%=(Word const& other) noexcept
 {
-    return *this = (this->to_int() % other.to_int());
+    m_value %= other.m_value;
+    return *this;
 }
 
 constexpr Word Word::operator%(Word const& other) const noexcept
@@ -210,8 +211,7 @@ constexpr Word Word::operator%(Word const& other) const noexcept
 
 constexpr Word& Word::operator&=(Word const& other) noexcept
 {
-    this->data[LO] &= other.data[LO];
-    this->data[HI] &= other.data[HI];
+    m_value &= other.m_value;
     return *this;
 }
 
@@ -222,8 +222,7 @@ constexpr Word Word::operator&(Word const& other) const noexcept
 
 constexpr Word& Word::operator|=(Word const& other) noexcept
 {
-    this->data[LO] |= other.data[LO];
-    this->data[HI] |= other.data[HI];
+    m_value |= other.m_value;
     return *this;
 }
 
@@ -234,26 +233,17 @@ constexpr Word Word::operator|(Word const& other) const noexcept
 
 constexpr Word Word::operator~() const noexcept
 {
-    return Word((~ this->to_int()) & (max_word-1));
+    return Word((~ m_value) & (max_word-1));
 }
 
 constexpr std::strong_ordering Word::operator<=>(Word const& other) const noexcept
 {
-    if(this->hi() < other.hi()) return std::strong_ordering::less;
-    if(this->hi() > other.hi()) return std::strong_ordering::greater;
-
-    if(this->lo() < other.lo()) return std::strong_ordering::less;
-    if(this->lo() > other.lo()) return std::strong_ordering::greater;
-
-    return std::strong_ordering::equivalent;
+    return m_value <=> other.m_value;
 }
 
 constexpr Word Word::flip() const noexcept
 {
-    Word out;
-    out.lo() = this->hi();
-    out.hi() = this->lo();
-    return out;
+    return Word().set_raw(get_raw());
 }
 
 inline std::ostream& operator<<(std::ostream& os, Word const& in)
@@ -0,0 +1,192 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <utility>
+
+#include "register_sweep.h"
+#include "virtual_machine.h"
+
+void Help()
+{
+    std::cout << "          SYNACOR CHALLENGE REGISTER SWEEP\n";
+    std::cout << "Runs a program once per initial value of a register, in parallel, until a condition is met.\n";
+    std::cout << "Pass the name of the program as the last argument, and exactly one condition.\n";
+    std::cout << "\nConditions:\n";
+    std::cout << "  --until-output TEXT                 The program prints TEXT\n";
+    std::cout << "  --until-register ADDRESS REG VALUE  Register REG (0-7) holds VALUE when the instruction at ADDRESS is about to run\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --prelude FILE     Input that brings the program to the state to start every run from\n";
+    std::cout << "  --input FILE       Input given to every run. A run stops when it needs more.\n";
+    std::cout << "  --register REG     Register to sweep (default 7)\n";
+    std::cout << "  --range FIRST LAST Values to try (default 1 32767)\n";
+    std::cout << "  --threads N        Number of worker threads (default: one per core)\n";
+    std::cout << "  --max-instructions N  Instructions after which a run is given up\n";
+    std::cout << "  --memoize          Cache the results of pure subroutines, separately in every thread\n";
+    std::cout << std::endl;
+}
+
+std::string ReadFile(char const* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        std::cerr << "Failed to open " << path << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+/**
+ * @brief Runs the program until it needs more input than the prelude provides.
+ */
+void RunPrelude(VirtualMachine& vm, std::string const& prelude)
+{
+    std::istringstream input(prelude);
+    vm.SetInput(input);
+    while(vm.IsRunning())
+    {
+        if(std::as_const(vm).memory()[vm.instr_ptr()].to_int() == InstructionData::IN && !vm.HasPendingInput()) break;
+        vm.Step();
+    }
+    vm.SetInput(std::cin);
+}
+
+int main(int argc, char * argv[])
+{
+    if(argc == 1)
+    {
+        Help();
+        return EXIT_SUCCESS;
+    }
+
+    RegisterSweep::Options options;
+    SweepPredicate predicate;
+    std::optional<std::string> prelude;
+    bool memoize = false;
+
+    const auto number = [&](int const i) {
+        char* end;
+        const unsigned long long value = std::strtoull(argv[i], &end, 0);
+        if(*end != '\0')
+        {
+            Help();
+            std::exit(EXIT_FAILURE);
+        }
+        return value;
+    };
+
+    // Checked before narrowing, so that out-of-range values are rejected rather than wrapped around
+    const auto below = [&](int const i, unsigned long long const limit) {
+        const unsigned long long value = number(i);
+        if(value >= limit)
+        {
+            Help();
+            std::exit(EXIT_FAILURE);
+        }
+        return value;
+    };
+
+    for(int i = 1; i < argc - 1; ++i)
+    {
+        const std::string_view option = argv[i];
+        const int num_values = argc - 2 - i;
+        if(option == "--until-output" && num_values >= 1)
+        {
+            predicate = OutputContains(argv[++i]);
+            continue;
+        }
+        if(option == "--until-register" && num_values >= 3)
+        {
+            const auto address = static_cast<raw_word_t>(below(++i, Word::max_word));
+            const auto reg = static_cast<std::size_t>(below(++i, InstructionData::num_registers));
+            const auto value = static_cast<raw_word_t>(below(++i, Word::max_word));
+            predicate = RegisterEqualsAt(address, reg, value);
+            continue;
+        }
+        if(option == "--prelude" && num_values >= 1)
+        {
+            prelude = ReadFile(argv[++i]);
+            continue;
+        }
+        if(option == "--input" && num_values >= 1)
+        {
+            options.input = ReadFile(argv[++i]);
+            continue;
+        }
+        if(option == "--register" && num_values >= 1)
+        {
+            options.reg = static_cast<std::size_t>(below(++i, InstructionData::num_registers));
+            continue;
+        }
+        if(option == "--range" && num_values >= 2)
+        {
+            options.first = static_cast<raw_word_t>(below(++i, Word::max_word));
+            options.last = static_cast<raw_word_t>(below(++i, Word::max_word));
+            continue;
+        }
+        if(option == "--threads" && num_values >= 1)
+        {
+            options.num_threads = static_cast<std::size_t>(number(++i));
+            continue;
+        }
+        if(option == "--max-instructions" && num_values >= 1)
+        {
+            options.max_instructions = number(++i);
+            continue;
+        }
+        if(option == "--memoize")
+        {
+            memoize = true;
+            continue;
+        }
+
+        Help();
+        return EXIT_FAILURE;
+    }
+
+    if(!predicate || options.num_threads == 0 || options.first > options.last)
+    {
+        Help();
+        return EXIT_FAILURE;
+    }
+
+    auto vm = std::make_unique<VirtualMachine>();
+    auto program = VirtualMachine::program_file_t(argv[argc-1], std::ios::binary);
+    vm->LoadMemory(program);
+    if(memoize) vm->EnableMemoization();
+    vm->Start();
+
+    if(prelude)
+    {
+        std::cout << ">> Prelude output:\n";
+        RunPrelude(*vm, *prelude);
+        std::cout << '\n';
+    }
+
+    std::cout << ">> Sweeping register " << options.reg << " from " << options.first << " to " << options.last
+              << " on " << options.num_threads << " threads" << std::endl;
+
+    const auto start = std::chrono::steady_clock::now();
+    const RegisterSweep::Result result = RegisterSweep(*vm, predicate, options).Run();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "- Candidates   : " << result.candidates << '\n';
+    std::cout << "- Instructions : " << result.instructions << '\n';
+    std::cout << "- Time         : " << elapsed.count() << " s\n";
+    if(!result.value)
+    {
+        std::cout << "\n>> No value found" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "\n>> Found: " << *result.value << '\n';
+    std::cout << ">> Output of that run:\n" << result.output << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -1,4 +1,22 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 
 #include "test_word.h"
-#include "test_address.h"
\ No newline at end of file
+#include "test_address.h"
+#include "test_call_stack.h"
+#include "test_execution_policy.h"
+#include "test_decode_cache.h"
+#include "test_jit_compiler.h"
+#include "test_memoizer.h"
+#include "test_native_hooks.h"
+#include "test_register_sweep.h"
+#include "test_shared_pages.h"
+#include "test_snapshot.h"
+#include "test_image_cache.h"
+#include "test_script_input.h"
+#include "test_output_sink.h"
+#include "test_async_io.h"
+#include "test_machine_task.h"
+#include "test_profiler.h"
+#include "test_trace.h"
+#include "test_debugger.h"
+#include "test_history.h"
@@ -0,0 +1,139 @@
+#include "doctest/doctest.h"
+#include "async_io.h"
+#include "spsc_ring.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <random>
+#include <string>
+#include <thread>
+
+#if SYNACOR_ASYNC_IO_AVAILABLE
+#include <unistd.h>
+#endif
+
+TEST_CASE("SpscRing")
+{
+    SpscRing ring(5);
+    CHECK_EQ(ring.capacity(), 8);
+
+    CHECK_EQ(ring.Push("abcdef"), 6);
+    std::array<char, 4> buffer;
+    CHECK_EQ(ring.Pop(buffer), 4);
+    CHECK_EQ(std::string_view(buffer.data(), 4), "abcd");
+
+    CHECK_EQ(ring.Push("ghijklmn"), 6); // Wraps around
+    CHECK(ring.full());
+    CHECK_EQ(ring.Readable().size(), 4);
+
+    std::array<char, 16> all;
+    CHECK_EQ(ring.Pop(all), 8);
+    CHECK_EQ(std::string_view(all.data(), 8), "efghijkl");
+    CHECK(ring.empty());
+
+    SUBCASE("Across threads")
+    {
+        constexpr std::size_t total = 1 << 20;
+        std::thread producer([&]{
+            for(std::size_t sent=0; sent < total; )
+            {
+                const char c = static_cast<char>(sent % 251);
+                if(ring.Push(std::string_view(&c, 1)) == 1) ++sent;
+                else ring.WaitForSpace();
+            }
+            ring.Close();
+        });
+
+        std::size_t received = 0;
+        bool in_order = true;
+        while(true)
+        {
+            ring.WaitForData();
+            const std::size_t count = ring.Pop(all);
+            if(count == 0) break;
+            for(std::size_t i=0; i < count; ++i) in_order = in_order && all[i] == static_cast<char>((received + i) % 251);
+            received += count;
+        }
+        producer.join();
+        CHECK_EQ(received, total);
+        CHECK(in_order);
+    }
+}
+
+#if SYNACOR_ASYNC_IO_AVAILABLE
+TEST_CASE("AsyncIo")
+{
+    int input[2];
+    int output[2];
+    REQUIRE_EQ(pipe(input), 0);
+    REQUIRE_EQ(pipe(output), 0);
+
+    // in a; eq b a '\n'; out a; jf b 0; halt
+    const std::array<raw_word_t, 12> program = {20, 0x8000, 4, 0x8001, 0x8000, '\n', 19, 0x8000, 8, 0x8001, 0, 0};
+    {
+        AsyncIo io(input[0], output[1], 4);
+        VirtualMachine vm;
+        vm.SetInput(io.input());
+        vm.SetOutput(io.output());
+        vm.LoadMemory(program);
+
+        const std::string_view line = "hello async world\n";
+        CHECK_EQ(write(input[1], line.data(), line.size()), static_cast<ssize_t>(line.size()));
+        vm.Run();
+        io.Sync();
+    }
+
+    std::array<char, 64> buffer;
+    const ssize_t count = read(output[0], buffer.data(), buffer.size());
+    CHECK_EQ(std::string_view(buffer.data(), static_cast<std::size_t>(std::max<ssize_t>(count, 0))), "hello async world\n");
+
+    for(int const fd: {input[0], input[1], output[0], output[1]}) close(fd);
+}
+
+TEST_CASE("AsyncIo does not lose wake-ups")
+{
+    int input[2];
+    int output[2];
+    REQUIRE_EQ(pipe(input), 0);
+    REQUIRE_EQ(pipe(output), 0);
+
+    // Drains the output, so that only a lost wake-up can leave text in the ring
+    std::thread reader([fd = output[0]] {
+        std::array<char, 256> buffer;
+        while(read(fd, buffer.data(), buffer.size()) > 0) {}
+    });
+
+    // The input stays open and empty, so that only wake-ups get the I/O thread out of poll
+    std::mt19937 random(42);
+    for(int round = 0; round < 20000; ++round)
+    {
+        const std::uint32_t seed = static_cast<std::uint32_t>(random());
+        auto finished = std::async(std::launch::async, [&, seed] {
+            std::mt19937 delays(seed);
+            AsyncIo io(input[0], output[1], 64);
+            for(int i = 0; i < 20; ++i)
+            {
+                io.output().Put("wake up\n");
+                io.output().Flush();
+                if(delays() % 2) std::this_thread::sleep_for(std::chrono::microseconds(delays() % 50));
+            }
+            io.Sync();
+        }); // The destructor also needs the I/O thread to wake up, to join it
+        if(finished.wait_for(std::chrono::seconds(10)) != std::future_status::ready)
+        {
+            std::fprintf(stderr, "AsyncIo lost a wake-up in round %d\n", round);
+            std::abort(); // Waiting for the round would hang the tests
+        }
+    }
+
+    close(output[1]);
+    reader.join();
+    for(int const fd: {input[0], input[1], output[0]}) close(fd);
+}
+#endif
@@ -0,0 +1,36 @@
+#include "doctest/doctest.h"
+#include "call_stack.h"
+
+TEST_CASE("CallStack")
+{
+    CallStack stack(3 * CallStack::initial_capacity);
+    CHECK(stack.empty());
+
+    SUBCASE("Push and pop")
+    {
+        CHECK(stack.Push(Word(1)));
+        CHECK(stack.Push(Word(2)));
+        CHECK_EQ(stack.size(), 2);
+        CHECK_EQ(stack.top().to_int(), 2);
+        CHECK_EQ(stack.Pop().to_int(), 2);
+        CHECK_EQ(stack.Pop().to_int(), 1);
+        CHECK(stack.empty());
+        CHECK_EQ(stack.high_water_mark(), 2);
+    }
+
+    SUBCASE("Growth and limit")
+    {
+        for(std::size_t i=0; i < stack.limit(); ++i)
+        {
+            REQUIRE(stack.Push(Word(static_cast<raw_word_t>(i % Word::max_word))));
+        }
+        CHECK_FALSE(stack.Push(Word(0)));
+        CHECK_EQ(stack.size(), stack.limit());
+        CHECK_EQ(stack.Pop().to_int(), (stack.limit() - 1) % Word::max_word);
+        CHECK_EQ(stack.begin()->to_int(), 0);
+
+        stack.Clear();
+        CHECK(stack.empty());
+        CHECK_EQ(stack.high_water_mark(), 0);
+    }
+}
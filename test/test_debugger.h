@@ -0,0 +1,196 @@
+#include "doctest/doctest.h"
+#include "breakpoints.h"
+#include "debugger.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <sstream>
+#include <string>
+
+TEST_CASE("VirtualMachine::ResumeUntilBreakpoint")
+{
+    VirtualMachine vm;
+    Breakpoints breakpoints;
+
+    SUBCASE("Stops every time, except where it is resumed from")
+    {
+        // set a 3; 3: add a a 32767; jt a 3; halt
+        const std::array<raw_word_t, 11> program = {1, 0x8000, 3, 9, 0x8000, 0x8000, 32767, 7, 0x8000, 3, 0};
+        vm.LoadMemory(program);
+        vm.Start();
+        breakpoints.Set(7);
+
+        for(raw_word_t expected: {2, 1, 0})
+        {
+            REQUIRE(vm.ResumeUntilBreakpoint(breakpoints));
+            CHECK_EQ(vm.instr_ptr().get().to_int(), 7);
+            CHECK_EQ(vm.registers()[0].to_int(), expected);
+        }
+        CHECK_FALSE(vm.ResumeUntilBreakpoint(breakpoints));
+        CHECK_FALSE(vm.IsRunning());
+    }
+
+    SUBCASE("Conditions")
+    {
+        const std::array<raw_word_t, 11> program = {1, 0x8000, 3, 9, 0x8000, 0x8000, 32767, 7, 0x8000, 3, 0};
+        vm.LoadMemory(program);
+        vm.Start();
+        breakpoints.Set(7, Breakpoints::Condition{0, Breakpoints::Condition::LESS, 2});
+
+        REQUIRE(vm.ResumeUntilBreakpoint(breakpoints));
+        CHECK_EQ(vm.registers()[0].to_int(), 1);
+        REQUIRE(vm.ResumeUntilBreakpoint(breakpoints));
+        CHECK_EQ(vm.registers()[0].to_int(), 0);
+        CHECK_FALSE(vm.ResumeUntilBreakpoint(breakpoints));
+    }
+
+    SUBCASE("Code written by the program is scanned again")
+    {
+        // jmp 5; 2: halt; halt; halt; 5: wmem 0 noop; wmem 1 noop; jmp 0
+        const std::array<raw_word_t, 13> program = {6, 5, 0, 0, 0, 16, 0, 21, 16, 1, 21, 6, 0};
+        vm.LoadMemory(program);
+        vm.Start();
+        breakpoints.Set(2);
+
+        REQUIRE(vm.ResumeUntilBreakpoint(breakpoints));
+        CHECK_EQ(vm.instr_ptr().get().to_int(), 2);
+    }
+
+    SUBCASE("Runs to the end without breakpoints")
+    {
+        const std::array<raw_word_t, 11> program = {1, 0x8000, 3, 9, 0x8000, 0x8000, 32767, 7, 0x8000, 3, 0};
+        vm.LoadMemory(program);
+        vm.Start();
+        CHECK_FALSE(vm.ResumeUntilBreakpoint(breakpoints));
+        CHECK_FALSE(vm.IsRunning());
+    }
+}
+
+TEST_CASE("Debugger")
+{
+    // set a 3; 3: add a a 32767; jt a 3; halt
+    const std::array<raw_word_t, 11> program = {1, 0x8000, 3, 9, 0x8000, 0x8000, 32767, 7, 0x8000, 3, 0};
+    VirtualMachine vm;
+    vm.LoadMemory(program);
+    vm.Start();
+
+    std::istringstream commands;
+    std::ostringstream os;
+    Debugger debugger(vm, commands, os);
+
+    CHECK(debugger.Execute("break 0x7 if a == 1"));
+    CHECK(debugger.Execute("b 3"));
+    CHECK(debugger.Execute("list"));
+    CHECK_NE(os.str().find("0x0007 if a == 1"), std::string::npos);
+    CHECK_EQ(debugger.breakpoints().all().size(), 2);
+
+    CHECK(debugger.Execute("d 3"));
+    CHECK(debugger.Execute("continue"));
+    CHECK_EQ(vm.instr_ptr().get().to_int(), 7);
+    CHECK_EQ(vm.registers()[0].to_int(), 1);
+
+    CHECK(debugger.Execute("step 2"));
+    CHECK_EQ(vm.instr_ptr().get().to_int(), 7);
+    CHECK_EQ(vm.registers()[0].to_int(), 0);
+
+    os.str("");
+    CHECK(debugger.Execute("break 40000"));
+    CHECK(debugger.Execute("break 5 if z == 1"));
+    CHECK(debugger.Execute("frobnicate"));
+    CHECK_EQ(debugger.breakpoints().all().size(), 1);
+    CHECK_NE(os.str().find("Unknown command"), std::string::npos);
+
+    os.str("");
+    CHECK(debugger.Execute("regs"));
+    CHECK_NE(os.str().find("-instr : 0700 (JT)"), std::string::npos); // Words are dumped low byte first
+    CHECK_NE(os.str().find("-data a: 0000"), std::string::npos);
+
+    os.str("");
+    CHECK(debugger.Execute("mem 3 4"));
+    CHECK_EQ(os.str().find("0000: 0100  0080  0300 [0900] 0080"), 0);
+
+    CHECK(debugger.Execute("c"));
+    CHECK_FALSE(vm.IsRunning());
+    CHECK_FALSE(debugger.Execute("quit"));
+}
+
+TEST_CASE("Watchpoints")
+{
+    // set a 3; 3: wmem 100 a; rmem b 100; add a a 32767; jt a 3; halt
+    const std::array<raw_word_t, 17> program = {1, 0x8000, 3, 16, 100, 0x8000, 15, 0x8001, 100, 9, 0x8000, 0x8000, 32767, 7, 0x8000, 3, 0};
+    VirtualMachine vm;
+    vm.LoadMemory(program);
+    vm.Start();
+    Breakpoints breakpoints;
+    Watchpoints watchpoints;
+
+    SUBCASE("Writes are recorded with the old and new values")
+    {
+        watchpoints.Set(100, 100, Watchpoints::WRITE);
+        CHECK_FALSE(vm.ResumeUntilBreakpoint(breakpoints, watchpoints));
+        CHECK_FALSE(vm.IsRunning());
+
+        REQUIRE_EQ(watchpoints.hits().size(), 3);
+        for(raw_word_t i = 0; i < 3; ++i)
+        {
+            Watchpoints::Hit const& hit = watchpoints.hits()[i];
+            CHECK_EQ(hit.index, i);
+            CHECK_EQ(hit.instr_ptr, 3);
+            CHECK_EQ(hit.address, 100);
+            CHECK_EQ(hit.access, Watchpoints::WRITE);
+            CHECK_EQ(hit.old_value, i == 0 ? 0 : 4 - i);
+            CHECK_EQ(hit.new_value, 3 - i);
+        }
+    }
+
+    SUBCASE("Pausing")
+    {
+        watchpoints.Set(100, 100, Watchpoints::READ, Watchpoints::PAUSE);
+        REQUIRE(vm.ResumeUntilBreakpoint(breakpoints, watchpoints));
+        CHECK_EQ(vm.instr_ptr().get().to_int(), 9);
+        CHECK_EQ(vm.registers()[1].to_int(), 3);
+        REQUIRE_EQ(watchpoints.hits().size(), 1);
+        CHECK_EQ(watchpoints.hits()[0].access, Watchpoints::READ);
+        CHECK_EQ(watchpoints.hits()[0].old_value, 3);
+        CHECK_EQ(watchpoints.hits()[0].new_value, 3);
+
+        REQUIRE(vm.ResumeUntilBreakpoint(breakpoints, watchpoints));
+        CHECK_EQ(vm.registers()[1].to_int(), 2);
+    }
+
+    SUBCASE("Ranges")
+    {
+        watchpoints.Set(99, 101, Watchpoints::READ_WRITE);
+        watchpoints.Set(200, 300, Watchpoints::READ_WRITE, Watchpoints::PAUSE);
+        CHECK_FALSE(vm.ResumeUntilBreakpoint(breakpoints, watchpoints));
+        CHECK_EQ(watchpoints.num_hits(), 6);
+
+        CHECK(watchpoints.Remove(99));
+        CHECK_FALSE(watchpoints.Remove(100));
+        CHECK_FALSE(watchpoints.Watches(100, Watchpoints::WRITE));
+        CHECK(watchpoints.Watches(300, Watchpoints::READ));
+    }
+
+    SUBCASE("Debugger snapshots")
+    {
+        std::istringstream commands;
+        std::ostringstream os;
+        Debugger debugger(vm, commands, os);
+
+        CHECK(debugger.Execute("watch 0x64 write snapshot"));
+        CHECK(debugger.Execute("watch 10-5"));
+        CHECK(debugger.Execute("list"));
+        CHECK_NE(os.str().find("watch 0x0064 write snapshot"), std::string::npos);
+        CHECK_EQ(debugger.watchpoints().all().size(), 1);
+
+        CHECK(debugger.Execute("continue"));
+        CHECK_FALSE(vm.IsRunning());
+        CHECK_NE(os.str().find("Saved snapshot 2"), std::string::npos);
+
+        CHECK(debugger.Execute("restore 1"));
+        CHECK(vm.IsRunning());
+        CHECK_EQ(vm.instr_ptr().get().to_int(), 6);
+        CHECK_EQ(vm.registers()[0].to_int(), 2);
+        CHECK_EQ(std::as_const(vm).memory()[Address(100)].to_int(), 2);
+    }
+}
@@ -0,0 +1,122 @@
+#include "doctest/doctest.h"
+#include "decode_cache.h"
+
+TEST_CASE("DecodeCache")
+{
+    Memory memory;
+    memory[Address(0)] = InstructionData::ADD;
+    memory[Address(1)] = 0x8000;
+    memory[Address(2)] = 0x8007;
+    memory[Address(3)] = 0x0123;
+    memory[Address(4)] = InstructionData::OUT;
+    memory[Address(5)] = 0x8008;
+
+    SUBCASE("Decode")
+    {
+        const auto instr = DecodeCache::Decode(memory, 0);
+
+        CHECK_EQ(instr.opcode, InstructionData::ADD);
+        CHECK_EQ(instr.length, 4);
+        CHECK_EQ(instr.args[0].type, InstructionData::REGISTER);
+        CHECK_EQ(instr.args[0].value.to_int(), 0);
+        CHECK_EQ(instr.args[1].type, InstructionData::REGISTER);
+        CHECK_EQ(instr.args[1].value.to_int(), 7);
+        CHECK_EQ(instr.args[2].type, InstructionData::LITERAL);
+        CHECK_EQ(instr.args[2].value.to_int(), 0x0123);
+        CHECK_FALSE(instr.may_fault);
+        CHECK_EQ(instr.operand_modes, 0b011);
+    }
+
+    SUBCASE("Invalid operand")
+    {
+        const auto instr = DecodeCache::Decode(memory, 4);
+
+        CHECK_EQ(instr.opcode, InstructionData::OUT);
+        CHECK_EQ(instr.length, 2);
+        CHECK_EQ(instr.args[0].type, InstructionData::INVALID);
+        CHECK(instr.may_fault);
+        CHECK_EQ(instr.operand_modes, DecodedInstruction::runtime_modes);
+    }
+
+    SUBCASE("Literal target")
+    {
+        memory[Address(1)] = 0x0001;
+        CHECK(DecodeCache::Decode(memory, 0).may_fault);
+    }
+
+    SUBCASE("Wrong opcode")
+    {
+        memory[Address(6)] = 0x0016;
+        memory[Address(7)] = 0x0100;
+
+        CHECK_EQ(DecodeCache::Decode(memory, 6).opcode, InstructionData::WRONG_OPCODE);
+        CHECK_EQ(DecodeCache::Decode(memory, 7).opcode, InstructionData::WRONG_OPCODE);
+    }
+
+    SUBCASE("Invalidation")
+    {
+        DecodeCache cache;
+        CHECK_EQ(cache.Fetch(memory, 0).args[2].value.to_int(), 0x0123);
+
+        memory[Address(3)] = 0x0456;
+        CHECK_EQ(cache.Fetch(memory, 0).args[2].value.to_int(), 0x0123); // Stale until invalidated
+
+        cache.Invalidate(3);
+        CHECK_EQ(cache.Fetch(memory, 0).args[2].value.to_int(), 0x0456);
+    }
+
+    SUBCASE("Hook")
+    {
+        DecodeCache cache;
+        CHECK_EQ(cache.Fetch(memory, 0).opcode, InstructionData::ADD);
+
+        cache.SetHook(0, true);
+        CHECK_EQ(cache.Fetch(memory, 0).opcode, InstructionData::NATIVE_HOOK);
+        CHECK_EQ(cache.Fetch(memory, 0).length, 4);
+        CHECK_FALSE(cache.Fetch(memory, 0).may_fault);
+
+        cache.Clear();
+        CHECK_EQ(cache.Fetch(memory, 0).opcode, InstructionData::NATIVE_HOOK);
+
+        cache.SetHook(0, false);
+        CHECK_EQ(cache.Fetch(memory, 0).opcode, InstructionData::ADD);
+    }
+
+    SUBCASE("Fusion")
+    {
+        memory[Address(10)] = InstructionData::EQ;
+        memory[Address(11)] = 0x8001;
+        memory[Address(12)] = 0x8000;
+        memory[Address(13)] = 0x0005;
+        memory[Address(14)] = InstructionData::JT;
+        memory[Address(15)] = 0x8001;
+        memory[Address(16)] = 0x0064;
+        memory[Address(17)] = InstructionData::HALT;
+
+        DecodeCache cache;
+        CHECK_EQ(cache.Fetch(memory, 10).fusion, SuperinstructionData::EQ_JT);
+        CHECK_EQ(cache.Fetch(memory, 10).span, 7);
+        CHECK_EQ(cache.Fetch(memory, 14).fusion, SuperinstructionData::NONE);
+        CHECK_EQ(cache.Fetch(memory, 14).span, 3);
+
+        SUBCASE("Overwritten opcode")
+        {
+            memory[Address(14)] = InstructionData::JMP;
+            cache.Invalidate(14);
+            CHECK_EQ(cache.Fetch(memory, 10).fusion, SuperinstructionData::NONE);
+        }
+
+        SUBCASE("Operand that may fault")
+        {
+            memory[Address(15)] = 0x8008;
+            cache.Invalidate(15);
+            CHECK_EQ(cache.Fetch(memory, 10).fusion, SuperinstructionData::NONE);
+        }
+
+        SUBCASE("Unrelated write")
+        {
+            cache.Invalidate(17);
+            CHECK_EQ(cache.Fetch(memory, 10).fusion, SuperinstructionData::EQ_JT);
+        }
+    }
+}
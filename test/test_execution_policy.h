@@ -0,0 +1,106 @@
+#include "doctest/doctest.h"
+#include "output_sink.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <sstream>
+#include <string>
+#include <utility>
+
+TEST_CASE("UncheckedVirtualMachine")
+{
+    SUBCASE("Addresses wrap around")
+    {
+        // rmem a 100; wmem a 'W'; rmem b 50; out b; rmem c 101; jmp c; out 'X'; halt
+        // 30: out 'Y'; halt
+        // 100: 0x8032 (50); 0x801e (30)
+        std::array<raw_word_t, 102> program {15, 0x8000, 100, 16, 0x8000, 'W', 15, 0x8001, 50, 19,
+                                             0x8001, 15, 0x8002, 101, 6, 0x8002, 19, 'X', 0};
+        program[30] = 19;
+        program[31] = 'Y';
+        program[100] = 0x8032;
+        program[101] = 0x801e;
+
+        UncheckedVirtualMachine vm;
+        CaptureSink output;
+        vm.SetOutput(output);
+        vm.LoadMemory(program);
+        vm.Run();
+
+        CHECK_EQ(output.text(), "WY");
+        CHECK_EQ(std::as_const(vm).memory()[Address(50)].to_int(), 'W');
+        CHECK_EQ(vm.instr_ptr().get().to_int(), 32);
+    }
+
+    SUBCASE("Same as checked on a valid program")
+    {
+        // set a 10; 3: call 20; add a a 32767; jt a 3; out b; halt
+        // 20: add b b 7; mult c b b; push c; pop d; wmem 200 d; rmem e 200; mod f e 13; ret
+        std::array<raw_word_t, 43> program {1, 0x8000, 10, 17, 20, 9, 0x8000, 0x8000, 32767, 7,
+                                            0x8000, 3, 19, 0x8001, 0};
+        const std::array<raw_word_t, 23> subroutine {9, 0x8001, 0x8001, 7, 10, 0x8002, 0x8001, 0x8001, 2, 0x8002,
+                                                     3, 0x8003, 16, 200, 0x8003, 15, 0x8004, 200, 11, 0x8005,
+                                                     0x8004, 13, 18};
+        std::ranges::copy(subroutine, program.begin() + 20);
+
+        const auto state_of = [&](auto&& vm) {
+            CaptureSink output;
+            vm.SetOutput(output);
+            vm.LoadMemory(program);
+            vm.Run();
+            std::ostringstream os;
+            vm.Print(os);
+            return std::string(output.text()) + os.str();
+        };
+
+        const std::string checked = state_of(VirtualMachine{});
+        CHECK(checked.starts_with("F"));
+        CHECK_NE(checked.find("ERROR    : 0"), std::string::npos);
+        CHECK_EQ(state_of(UncheckedVirtualMachine{}), checked);
+    }
+}
+
+TEST_CASE("VirtualMachine raises errors on bad operands")
+{
+    const auto flags_after = [](auto const& program) {
+        VirtualMachine vm;
+        vm.LoadMemory(program);
+        vm.Run();
+        CHECK_FALSE(vm.IsRunning());
+        std::ostringstream os;
+        vm.Print(os);
+        return os.str();
+    };
+
+    SUBCASE("Invalid register")
+    {
+        const std::array<raw_word_t, 3> program = {1, 0x8008, 1}; // set 0x8008 1
+        const std::string state = flags_after(program);
+        CHECK_NE(state.find("ERROR    : 1"), std::string::npos);
+        CHECK_NE(state.find("BAD_INT  : 1"), std::string::npos);
+    }
+
+    SUBCASE("Invalid address")
+    {
+        const std::array<raw_word_t, 3> program = {15, 0x8000, 0x8009}; // rmem a 0x8009
+        const std::string state = flags_after(program);
+        CHECK_NE(state.find("ERROR    : 1"), std::string::npos);
+        CHECK_NE(state.find("BAD_INT  : 1"), std::string::npos);
+    }
+
+    SUBCASE("Invalid jump target")
+    {
+        const std::array<raw_word_t, 2> program = {6, 0x800a}; // jmp 0x800a
+        const std::string state = flags_after(program);
+        CHECK_NE(state.find("ERROR    : 1"), std::string::npos);
+        CHECK_NE(state.find("BAD_INT  : 1"), std::string::npos);
+    }
+
+    SUBCASE("Literal destination")
+    {
+        const std::array<raw_word_t, 3> program = {1, 5, 1}; // set 5 1
+        const std::string state = flags_after(program);
+        CHECK_NE(state.find("ERROR    : 1"), std::string::npos);
+        CHECK_NE(state.find("W_ON_LIT : 1"), std::string::npos);
+    }
+}
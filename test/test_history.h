@@ -0,0 +1,143 @@
+#include "doctest/doctest.h"
+#include "debugger.h"
+#include "history.h"
+#include "output_sink.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+struct MachineState
+{
+    raw_word_t instr_ptr;
+    std::array<raw_word_t, InstructionData::num_registers> registers;
+    std::vector<raw_word_t> stack;
+    raw_word_t memory_100;
+
+    bool operator==(MachineState const&) const = default;
+};
+
+MachineState StateOf(VirtualMachine const& vm)
+{
+    MachineState state {vm.instr_ptr().get().to_int(), {}, {}, vm.memory()[Address(100)].to_int()};
+    for(std::size_t i=0; i < state.registers.size(); ++i) state.registers[i] = vm.registers()[i].to_int();
+    for(Word const& word: vm.stack()) state.stack.push_back(word.to_int());
+    return state;
+}
+
+}
+
+TEST_CASE("VirtualMachine::TravelTo")
+{
+    // in a; push a; call 10; pop b; halt; 10: wmem 100 a; add c a 1; in d; ret
+    const std::array<raw_word_t, 20> program = {20, 0x8000, 2, 0x8000, 17, 10, 3, 0x8001, 0, 0,
+                                                16, 100, 0x8000, 9, 0x8002, 0x8000, 1, 20, 0x8003, 18};
+    VirtualMachine vm;
+    CaptureSink output;
+    vm.SetOutput(output);
+    vm.LoadMemory(program);
+    vm.AppendScript("xy\n");
+    vm.SetScriptEnd(ScriptEnd::HALT);
+    vm.Start();
+
+    History<VirtualMachine> history(3);
+    vm.SetHistory(&history);
+
+    std::vector<MachineState> states = {StateOf(vm)};
+    while(vm.IsRunning())
+    {
+        vm.Step();
+        if(vm.IsRunning()) states.push_back(StateOf(vm));
+    }
+    REQUIRE_EQ(history.now(), 8);
+    REQUIRE_EQ(states.size(), 9);
+    CHECK_EQ(history.num_checkpoints(), 3);
+    CHECK_EQ(states.back().registers[3], 'y');
+
+    SUBCASE("Any recorded step, in any order")
+    {
+        for(std::uint64_t step: {3, 0, 8, 5, 6, 2, 7, 1, 4})
+        {
+            REQUIRE(vm.TravelTo(step));
+            CHECK_EQ(history.now(), step);
+            CHECK(vm.IsRunning());
+            CHECK_EQ(StateOf(vm), states[step]);
+        }
+        CHECK_FALSE(vm.TravelTo(9));
+    }
+
+    SUBCASE("Running forward again reads the same input")
+    {
+        REQUIRE(vm.TravelTo(1));
+        while(vm.IsRunning()) vm.Step();
+        CHECK_EQ(history.now(), 8);
+        CHECK_EQ(StateOf(vm).registers, states.back().registers);
+
+        REQUIRE(vm.TravelTo(0));
+        REQUIRE(vm.TravelTo(5));
+        vm.Step();
+        CHECK_EQ(StateOf(vm), states[6]);
+    }
+
+    SUBCASE("Memory stays bounded")
+    {
+        History<VirtualMachine> bounded(2, 4);
+        REQUIRE(vm.TravelTo(0));
+        vm.SetHistory(&bounded);
+        while(vm.IsRunning()) vm.Step();
+
+        CHECK_EQ(bounded.now(), 8);
+        CHECK_EQ(bounded.oldest(), 4);
+        CHECK_FALSE(vm.TravelTo(3));
+        REQUIRE(vm.TravelTo(4));
+        CHECK_EQ(StateOf(vm), states[4]);
+        vm.SetHistory(nullptr);
+    }
+}
+
+TEST_CASE("Debugger reverse execution")
+{
+    // set a 3; 3: add a a 32767; jt a 3; halt
+    const std::array<raw_word_t, 11> program = {1, 0x8000, 3, 9, 0x8000, 0x8000, 32767, 7, 0x8000, 3, 0};
+    VirtualMachine vm;
+    vm.LoadMemory(program);
+    vm.Start();
+
+    std::istringstream commands;
+    std::ostringstream os;
+    Debugger debugger(vm, commands, os);
+
+    CHECK(debugger.Execute("rs"));
+    CHECK_NE(os.str().find("Not recording"), std::string::npos);
+
+    CHECK(debugger.Execute("record 2"));
+    CHECK(debugger.Execute("continue"));
+    CHECK_FALSE(vm.IsRunning());
+    REQUIRE(debugger.history());
+    CHECK_EQ(debugger.history()->now(), 7);
+
+    CHECK(debugger.Execute("break 7"));
+    CHECK(debugger.Execute("rc"));
+    CHECK_EQ(vm.instr_ptr().get().to_int(), 7);
+    CHECK_EQ(vm.registers()[0].to_int(), 0);
+    CHECK(debugger.Execute("reverse-continue"));
+    CHECK_EQ(vm.registers()[0].to_int(), 1);
+
+    CHECK(debugger.Execute("rs"));
+    CHECK_EQ(vm.instr_ptr().get().to_int(), 3);
+    CHECK_EQ(vm.registers()[0].to_int(), 2);
+    CHECK(debugger.Execute("c"));
+    CHECK_EQ(vm.instr_ptr().get().to_int(), 7);
+    CHECK_EQ(vm.registers()[0].to_int(), 1);
+
+    CHECK(debugger.Execute("rs 100"));
+    CHECK_NE(os.str().find("Reached the oldest recorded instruction"), std::string::npos);
+    CHECK_EQ(debugger.history()->now(), 0);
+    CHECK_EQ(vm.instr_ptr().get().to_int(), 0);
+
+    CHECK(debugger.Execute("record off"));
+    CHECK_FALSE(debugger.history());
+}
@@ -0,0 +1,70 @@
+#include "doctest/doctest.h"
+#include "image_cache.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <filesystem>
+#include <sstream>
+
+TEST_CASE("VirtualMachine::PauseOnInput")
+{
+    // out '>'; in a; out a; jmp 0
+    const std::array<raw_word_t, 8> program = {19, '>', 20, 0x8000, 19, 0x8000, 6, 0};
+    std::istringstream input("never read\n");
+    std::ostringstream output;
+    VirtualMachine vm;
+    vm.SetInput(input);
+    vm.SetOutput(output);
+    vm.LoadMemory(program);
+    vm.PauseOnInput(true);
+
+    vm.Run();
+    CHECK(vm.IsAwaitingInput());
+    CHECK_FALSE(vm.IsRunning());
+    CHECK_EQ(vm.instr_ptr(), Address(2));
+    CHECK_EQ(output.str(), ">");
+
+    vm.ProvideInput("hi");
+    vm.Resume();
+    CHECK(vm.IsAwaitingInput());
+    CHECK_EQ(output.str(), ">h>i>\n>");
+
+    vm.PauseOnInput(false);
+    CHECK(vm.IsRunning());
+    for(std::size_t i=0; i < 3; ++i) vm.Step();
+    vm.FlushOutput();
+    CHECK_EQ(output.str(), ">h>i>\n>n");
+}
+
+TEST_CASE("ImageCache")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "synacor_image_cache_test";
+    std::filesystem::remove_all(directory);
+    const ImageCache cache(directory);
+
+    const std::array<std::byte, 3> binary = {std::byte{1}, std::byte{2}, std::byte{3}};
+    const ImageCache::Key key = ImageCache::Hash(binary);
+    CHECK_NE(ImageCache::Extend(key, "north"), ImageCache::Extend(key, "south"));
+    CHECK_NE(ImageCache::Extend(ImageCache::Extend(key, "a"), "b"), ImageCache::Extend(key, "ab"));
+
+    // out 'x'; in a; halt
+    const std::array<raw_word_t, 5> program = {19, 'x', 20, 0x8000, 0};
+    std::ostringstream output;
+    VirtualMachine vm;
+    vm.SetOutput(output);
+    vm.LoadMemory(program);
+    vm.PauseOnInput(true);
+    vm.Run();
+    REQUIRE(vm.IsAwaitingInput());
+    cache.Store(key, vm, output.view());
+
+    CaptureSink replayed;
+    VirtualMachine restored;
+    CHECK_FALSE(cache.Restore(ImageCache::Extend(key, "missing"), restored, replayed));
+    REQUIRE(cache.Restore(key, restored, replayed));
+    CHECK_EQ(replayed.text(), "x");
+    CHECK_EQ(restored.instr_ptr(), Address(2));
+    CHECK(restored.IsRunning()); // Pausing is up to whoever restores it
+
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,107 @@
+#include "doctest/doctest.h"
+#include "call_stack.h"
+#include "jit_compiler.h"
+
+#if SYNACOR_JIT_AVAILABLE
+
+TEST_CASE("JitCompiler")
+{
+    Memory memory;
+    memory[Address(0)] = InstructionData::ADD;  // add a a 1
+    memory[Address(1)] = 0x8000;
+    memory[Address(2)] = 0x8000;
+    memory[Address(3)] = 0x0001;
+    memory[Address(4)] = InstructionData::MOD;  // mod b b c
+    memory[Address(5)] = 0x8001;
+    memory[Address(6)] = 0x8001;
+    memory[Address(7)] = 0x8002;
+    memory[Address(8)] = InstructionData::JMP;  // jmp 0
+    memory[Address(9)] = 0x0000;
+
+    DecodeCache cache;
+    JitCompiler jit;
+
+    std::uint16_t registers[InstructionData::num_registers] = {0x7FFF, 10, 4, 0, 0, 0, 0, 0};
+    CallStack stack;
+    JitContext context {
+        .registers = registers,
+        .memory_pages = memory.pages().table(),
+        .stack_top = reinterpret_cast<std::uint16_t**>(stack.top_location()),
+        .stack_begin = reinterpret_cast<std::uint16_t* const*>(stack.begin_location()),
+        .stack_end = reinterpret_cast<std::uint16_t**>(stack.end_location()),
+        .stack_capacity = reinterpret_cast<std::uint16_t* const*>(stack.capacity_location()),
+        .code_pages = cache.pages().table(),
+        .vm = nullptr,
+        .write_code = nullptr
+    };
+
+    REQUIRE(jit.Compile(cache, memory, 0, true));
+    const JitCompiler::Block block = jit.Find(0);
+    REQUIRE(block != nullptr);
+    CHECK_EQ(jit.num_blocks(), 1);
+
+    SUBCASE("Run")
+    {
+        CHECK_EQ(block(&context), 0);
+        CHECK_EQ(registers[0], 0);
+        CHECK_EQ(registers[1], 2);
+    }
+
+    SUBCASE("Side exit")
+    {
+        registers[2] = 0;
+        CHECK_EQ(block(&context), 4 | JitCompiler::side_exit);
+        CHECK_EQ(registers[0], 0);
+        CHECK_EQ(registers[1], 10);
+    }
+
+    SUBCASE("Invalidation")
+    {
+        jit.Invalidate(10);
+        CHECK_EQ(jit.Find(0), block);
+
+        jit.Invalidate(9);
+        CHECK_EQ(jit.Find(0), nullptr);
+        CHECK_EQ(jit.num_blocks(), 0);
+    }
+}
+
+TEST_CASE("JitCompiler pushes past the high-water mark")
+{
+    Memory memory;
+    memory[Address(0)] = InstructionData::PUSH; // push a
+    memory[Address(1)] = 0x8000;
+    memory[Address(2)] = InstructionData::PUSH; // push b
+    memory[Address(3)] = 0x8001;
+    memory[Address(4)] = InstructionData::HALT;
+
+    DecodeCache cache;
+    JitCompiler jit;
+
+    std::uint16_t registers[InstructionData::num_registers] = {1, 2, 0, 0, 0, 0, 0, 0};
+    CallStack stack;
+    REQUIRE(stack.Push(Word(7)));
+    stack.Pop();
+    JitContext context {
+        .registers = registers,
+        .memory_pages = memory.pages().table(),
+        .stack_top = reinterpret_cast<std::uint16_t**>(stack.top_location()),
+        .stack_begin = reinterpret_cast<std::uint16_t* const*>(stack.begin_location()),
+        .stack_end = reinterpret_cast<std::uint16_t**>(stack.end_location()),
+        .stack_capacity = reinterpret_cast<std::uint16_t* const*>(stack.capacity_location()),
+        .code_pages = cache.pages().table(),
+        .vm = nullptr,
+        .write_code = nullptr
+    };
+
+    REQUIRE(jit.Compile(cache, memory, 0, true));
+    CHECK_EQ(jit.Find(0)(&context), 4); // Not a side exit, though only one word was ever pushed
+    REQUIRE_EQ(stack.size(), 2);
+    CHECK_EQ(stack.top().to_int(), 2);
+    CHECK_EQ(stack.high_water_mark(), 2);
+
+    REQUIRE(stack.Push(Word(3)));
+    CHECK_EQ(stack.high_water_mark(), 3);
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "doctest/doctest.h"
+#include "machine_task.h"
+#include "output_sink.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+TEST_CASE("VirtualMachine::RunAsync")
+{
+    // out '>'; in a; eq b a 'q'; jt b 14; out a; jmp 0; halt
+    const std::array<raw_word_t, 15> program = {19, '>', 20, 0x8000, 4, 0x8001, 0x8000, 'q', 7, 0x8001, 14, 19, 0x8000, 6, 0};
+
+    SUBCASE("Single session")
+    {
+        VirtualMachine vm;
+        CaptureSink output;
+        vm.SetOutput(output);
+        vm.LoadMemory(program);
+
+        MachineTask task = vm.RunAsync();
+        CHECK_FALSE(task.done());
+        CHECK(vm.IsAwaitingInput());
+        CHECK_EQ(output.text(), ">");
+
+        task.resume(); // Nothing provided: suspends again
+        CHECK_FALSE(task.done());
+        CHECK_EQ(output.text(), ">");
+
+        vm.ProvideInput("hi");
+        task.resume();
+        CHECK_FALSE(task.done());
+        CHECK_EQ(output.text(), ">h>i>\n>");
+
+        vm.ProvideInput("q");
+        task.resume();
+        CHECK(task.done());
+        CHECK_FALSE(vm.IsRunning());
+    }
+
+    SUBCASE("Many sessions on one thread")
+    {
+        constexpr std::size_t num_sessions = 1000;
+        std::vector<std::unique_ptr<VirtualMachine>> vms;
+        std::vector<CaptureSink> outputs(num_sessions);
+        std::vector<MachineTask> tasks;
+        for(std::size_t i=0; i < num_sessions; ++i)
+        {
+            vms.push_back(std::make_unique<VirtualMachine>());
+            vms[i]->SetOutput(outputs[i]);
+            vms[i]->LoadMemory(program);
+            tasks.push_back(vms[i]->RunAsync());
+        }
+
+        for(std::size_t round=0; round < 3; ++round)
+        {
+            for(std::size_t i=0; i < num_sessions; ++i)
+            {
+                if(i % 3 == round) continue; // Sessions get their input out of step
+                vms[i]->ProvideInput(round == 2 ? "q" : std::to_string(i));
+                tasks[i].resume();
+            }
+        }
+
+        std::size_t done = 0;
+        for(std::size_t i=0; i < num_sessions; ++i) done += tasks[i].done();
+        CHECK_EQ(done, num_sessions - num_sessions / 3); // All but those skipped in the last round
+        CHECK_EQ(outputs[4].text(), ">4>\n>");
+        CHECK_EQ(outputs[5].text(), ">5>\n>5>\n>");
+    }
+}
@@ -0,0 +1,114 @@
+#include "doctest/doctest.h"
+#include "memoizer.h"
+#include "output_sink.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <sstream>
+#include <string>
+
+TEST_CASE("Memoizer")
+{
+    Memory memory;
+    memory[Address(10)] = InstructionData::ADD;  // add b a 1
+    memory[Address(11)] = 0x8001;
+    memory[Address(12)] = 0x8000;
+    memory[Address(13)] = 0x0001;
+    memory[Address(14)] = InstructionData::RET;
+    memory[Address(20)] = InstructionData::OUT;  // out a
+    memory[Address(21)] = 0x8000;
+    memory[Address(22)] = InstructionData::RET;
+
+    DecodeCache cache;
+    Memoizer memoizer;
+
+    Word registers[Memoizer::num_registers] = {5, 0, 7, 0, 0, 0, 0, 0};
+    const Address return_address = 2;
+    const std::size_t stack_size = 100;
+
+    SUBCASE("Pure")
+    {
+        CHECK_FALSE(memoizer.Call(cache, memory, 10, return_address, stack_size, registers));
+        registers[1] = 6;
+        memoizer.Return(stack_size, return_address, registers);
+
+        registers[1] = 0;
+        registers[2] = 8; // Not an input
+        CHECK(memoizer.Call(cache, memory, 10, return_address, stack_size, registers));
+        CHECK_EQ(registers[1].to_int(), 6);
+        CHECK_EQ(registers[2].to_int(), 8);
+
+        registers[0] = 6;
+        CHECK_FALSE(memoizer.Call(cache, memory, 10, return_address, stack_size, registers));
+
+        const auto stats = memoizer.statistics();
+        CHECK_EQ(stats.hits, 1);
+        CHECK_EQ(stats.misses, 2);
+        CHECK_EQ(stats.entries, 1);
+    }
+
+    SUBCASE("Popped return address")
+    {
+        CHECK_FALSE(memoizer.Call(cache, memory, 10, return_address, stack_size, registers));
+        memoizer.Pop(stack_size);
+        memoizer.Return(stack_size, return_address, registers);
+        CHECK_EQ(memoizer.statistics().entries, 0);
+    }
+
+    SUBCASE("Table full")
+    {
+        Memoizer small(0);
+        CHECK_FALSE(small.Call(cache, memory, 10, return_address, stack_size, registers));
+        small.Return(stack_size, return_address, registers);
+        CHECK_EQ(small.statistics().entries, 0);
+        CHECK_EQ(small.statistics().rejected, 1);
+    }
+
+    SUBCASE("Impure")
+    {
+        CHECK_FALSE(memoizer.Call(cache, memory, 20, return_address, stack_size, registers));
+        memoizer.Return(stack_size, return_address, registers);
+        CHECK_FALSE(memoizer.Call(cache, memory, 20, return_address, stack_size, registers));
+        CHECK_EQ(memoizer.statistics().misses, 0);
+    }
+}
+
+TEST_CASE("Memoizer with registers written on some paths only")
+{
+    // set a 1; set b 'X'; call 20; out b; set b 'Y'; call 20; out b; halt
+    // 20: jt a 26; set b 'Z'; 26: ret
+    const std::array<raw_word_t, 27> program = {1, 0x8000, 1, 1, 0x8001, 'X', 17, 20, 19, 0x8001,
+                                                1, 0x8001, 'Y', 17, 20, 19, 0x8001, 0, 0, 0,
+                                                7, 0x8000, 26, 1, 0x8001, 'Z', 18};
+    VirtualMachine vm;
+    CaptureSink output;
+    vm.SetOutput(output);
+    vm.EnableMemoization();
+    vm.LoadMemory(program);
+    vm.Run();
+
+    CHECK_EQ(output.text(), "XY");
+}
+
+TEST_CASE("Memoizer does not skip stack overflows")
+{
+    // call 20; push 0; call 20; halt
+    // 20: add b a 1; ret
+    const std::array<raw_word_t, 25> program = {17, 20, 2, 0, 17, 20, 0, 0, 0, 0,
+                                                0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                9, 0x8001, 0x8000, 1, 18};
+    const auto state_of = [&](bool const memoize) {
+        VirtualMachine vm;
+        if(memoize) vm.EnableMemoization();
+        vm.SetStackLimit(1);
+        vm.LoadMemory(program);
+        vm.Run();
+        std::ostringstream os;
+        vm.Print(os);
+        return os.str();
+    };
+
+    const std::string plain = state_of(false);
+    CHECK_NE(plain.find("STACK_OF : 1"), std::string::npos);
+    CHECK_EQ(state_of(true), plain);
+}
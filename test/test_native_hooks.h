@@ -0,0 +1,45 @@
+#include "doctest/doctest.h"
+#include "virtual_machine.h"
+
+#include <vector>
+
+TEST_CASE("Native hooks")
+{
+    std::vector<raw_word_t> program(16, 0);
+    program[0]  = InstructionData::CALL;  // call 10
+    program[1]  = 10;
+    program[2]  = InstructionData::ADD;   // add b a 1
+    program[3]  = 0x8001;
+    program[4]  = 0x8000;
+    program[5]  = 1;
+    program[6]  = InstructionData::HALT;
+    program[10] = InstructionData::SET;   // set a 100
+    program[11] = 0x8000;
+    program[12] = 100;
+    program[13] = InstructionData::RET;
+
+    VirtualMachine vm;
+    std::size_t num_calls = 0;
+    vm.RegisterHook(10, [&](VirtualMachine& hooked) {
+        ++num_calls;
+        hooked.registers()[0] = 200;
+    });
+    vm.LoadMemory(program);
+
+    SUBCASE("Hooked")
+    {
+        vm.Run();
+        CHECK_EQ(num_calls, 1);
+        CHECK_EQ(vm.registers()[0].to_int(), 200);
+        CHECK_EQ(vm.registers()[1].to_int(), 201);
+        CHECK(vm.stack().empty());
+    }
+
+    SUBCASE("Removed")
+    {
+        vm.RemoveHook(10);
+        vm.Run();
+        CHECK_EQ(num_calls, 0);
+        CHECK_EQ(vm.registers()[1].to_int(), 101);
+    }
+}
@@ -0,0 +1,65 @@
+#include "doctest/doctest.h"
+#include "output_sink.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+/**
+ * Keeps each batch apart, to see when the sink was flushed.
+ */
+class BatchSink final : public OutputSink
+{
+public:
+    ~BatchSink() override { Flush(); }
+    std::vector<std::string> batches;
+
+protected:
+    void Write(std::string_view const text) override { batches.emplace_back(text); }
+};
+}
+
+TEST_CASE("OutputSink")
+{
+    BatchSink sink;
+    for(std::size_t i=0; i < OutputSink::buffer_size; ++i) sink.Put('a');
+    CHECK(sink.batches.empty());
+
+    sink.Put("bc");
+    REQUIRE_EQ(sink.batches.size(), 1);
+    CHECK_EQ(sink.batches[0], std::string(OutputSink::buffer_size, 'a'));
+
+    sink.Flush();
+    sink.Flush();
+    REQUIRE_EQ(sink.batches.size(), 2);
+    CHECK_EQ(sink.batches[1], "bc");
+}
+
+TEST_CASE("VirtualMachine output flushing")
+{
+    // out 'a'; out 'b'; in a; out a; halt
+    const std::array<raw_word_t, 9> program = {19, 'a', 19, 'b', 20, 0x8000, 19, 0x8000, 0};
+    std::istringstream input("x\n");
+    BatchSink sink;
+    VirtualMachine vm;
+    vm.SetInput(input);
+    vm.SetOutput(sink);
+    vm.LoadMemory(program);
+    vm.Start();
+
+    vm.Step();
+    vm.Step();
+    CHECK(sink.batches.empty());
+
+    vm.Step(); // IN reads a new line
+    REQUIRE_EQ(sink.batches.size(), 1);
+    CHECK_EQ(sink.batches[0], "ab");
+
+    vm.Resume(); // HALT
+    REQUIRE_EQ(sink.batches.size(), 2);
+    CHECK_EQ(sink.batches[1], "x");
+}
@@ -0,0 +1,119 @@
+#include "doctest/doctest.h"
+#include "profiler.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <sstream>
+#include <string>
+
+TEST_CASE("ProfiledVirtualMachine")
+{
+    // set a 3; add a a 32767; jt a 3; halt
+    const std::array<raw_word_t, 11> program = {1, 0x8000, 3, 9, 0x8000, 0x8000, 32767, 7, 0x8000, 3, 0};
+
+    ProfiledVirtualMachine vm;
+    vm.LoadMemory(program);
+    vm.Run();
+    REQUIRE_FALSE(vm.IsRunning());
+
+    ExecutionProfile const& profile = vm.profile();
+    CHECK_EQ(profile.address_count(Address(0)), 1);
+    CHECK_EQ(profile.address_count(Address(3)), 3);
+    CHECK_EQ(profile.address_count(Address(7)), 3);
+    CHECK_EQ(profile.address_count(Address(10)), 1);
+    CHECK_EQ(profile.address_count(Address(1)), 0);
+    CHECK_EQ(profile.opcode_count(InstructionData::ADD), 3);
+    CHECK_EQ(profile.opcode_count(InstructionData::JT), 3);
+    CHECK_EQ(profile.opcode_count(InstructionData::OUT), 0);
+    CHECK_EQ(profile.total(), 8);
+
+    std::ostringstream dump;
+    profile.WriteDump(dump);
+    const std::string text = dump.str();
+    CHECK(text.starts_with("kind,key,opcode,count\n"));
+    CHECK_NE(text.find("address,3,ADD,3\n"), std::string::npos);
+    CHECK_NE(text.find("opcode,JT,JT,3\n"), std::string::npos);
+    CHECK_EQ(text.find("OUT"), std::string::npos);
+}
+
+TEST_CASE("CallGraph")
+{
+    const auto profile_of = [](auto const& program) {
+        ProfiledVirtualMachine vm;
+        vm.LoadMemory(program);
+        vm.Run();
+        return vm.profile().call_graph();
+    };
+    const auto stacks_of = [](CallGraph const& graph) {
+        std::ostringstream os;
+        graph.WriteCollapsedStacks(os);
+        return os.str();
+    };
+
+    SUBCASE("Nested calls")
+    {
+        // call 5; call 5; halt; 5: call 8; ret; 8: noop; ret
+        const std::array<raw_word_t, 10> program = {17, 5, 17, 5, 0, 17, 8, 18, 21, 18};
+        const CallGraph graph = profile_of(program);
+        CHECK_EQ(stacks_of(graph), "main 3\nmain;sub_0005 4\nmain;sub_0005;sub_0008 4\n");
+
+        const auto subroutines = graph.Subroutines();
+        REQUIRE_EQ(subroutines.size(), 2);
+        CHECK_EQ(subroutines[0].address, 5);
+        CHECK_EQ(subroutines[0].calls, 2);
+        CHECK_EQ(subroutines[0].inclusive, 8);
+        CHECK_EQ(subroutines[0].exclusive, 4);
+        CHECK_EQ(subroutines[1].address, 8);
+        CHECK_EQ(subroutines[1].inclusive, 4);
+        CHECK_EQ(subroutines[1].exclusive, 4);
+    }
+
+    SUBCASE("Recursion is counted once")
+    {
+        // call 3; halt; 3: jt a 12; set a 1; call 3; ret; 12: ret
+        const std::array<raw_word_t, 13> program = {17, 3, 0, 7, 0x8000, 12, 1, 0x8000, 1, 17, 3, 18, 18};
+        const CallGraph graph = profile_of(program);
+        CHECK_EQ(stacks_of(graph), "main 2\nmain;sub_0003 6\n");
+
+        const auto subroutines = graph.Subroutines();
+        REQUIRE_EQ(subroutines.size(), 1);
+        CHECK_EQ(subroutines[0].calls, 2);
+        CHECK_EQ(subroutines[0].inclusive, 6);
+        CHECK_EQ(subroutines[0].exclusive, 6);
+    }
+
+    SUBCASE("Deep recursion stays in one chain")
+    {
+        // call 3; halt; 3: add a a 1; eq b a 20000; jt b 16; call 3; 16: ret
+        const std::array<raw_word_t, 17> program = {17, 3, 0, 9, 0x8000, 0x8000, 1, 4, 0x8001, 0x8000, 20000, 7, 0x8001, 16, 17, 3, 18};
+        const CallGraph graph = profile_of(program);
+        CHECK_EQ(stacks_of(graph), "main 2\nmain;sub_0003 99999\n");
+
+        const auto subroutines = graph.Subroutines();
+        REQUIRE_EQ(subroutines.size(), 1);
+        CHECK_EQ(subroutines[0].calls, 20000);
+        CHECK_EQ(subroutines[0].inclusive, 99999);
+    }
+
+    SUBCASE("Mutual recursion is counted once")
+    {
+        // call 3; halt; 3: jt a 11; set a 1; call 12; 11: ret; 12: call 3; ret
+        const std::array<raw_word_t, 15> program = {17, 3, 0, 7, 0x8000, 11, 1, 0x8000, 1, 17, 12, 18, 17, 3, 18};
+        const CallGraph graph = profile_of(program);
+        CHECK_EQ(stacks_of(graph), "main 2\nmain;sub_0003 4\nmain;sub_0003;sub_000c 2\nmain;sub_0003;sub_000c;sub_0003 2\n");
+
+        const auto subroutines = graph.Subroutines();
+        REQUIRE_EQ(subroutines.size(), 2);
+        CHECK_EQ(subroutines[0].address, 3);
+        CHECK_EQ(subroutines[0].inclusive, 8);
+        CHECK_EQ(subroutines[1].address, 12);
+        CHECK_EQ(subroutines[1].inclusive, 4);
+    }
+
+    SUBCASE("RET as a jump stays in the subroutine")
+    {
+        // call 3; halt; 3: push 7; ret; halt; 7: ret
+        const std::array<raw_word_t, 8> program = {17, 3, 0, 2, 7, 18, 0, 18};
+        CHECK_EQ(stacks_of(profile_of(program)), "main 2\nmain;sub_0003 3\n");
+    }
+}
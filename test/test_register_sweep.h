@@ -0,0 +1,62 @@
+#include "doctest/doctest.h"
+#include "register_sweep.h"
+
+#include <vector>
+
+TEST_CASE("WorkStealingRanges")
+{
+    WorkStealingRanges ranges(10, 109, 4);
+    std::vector<int> seen(110, 0);
+
+    // Worker 0 drains its own range, then steals everything else
+    while(auto const candidate = ranges.Next(0))
+    {
+        ++seen[*candidate];
+    }
+
+    CHECK_EQ(std::count(seen.begin(), seen.begin() + 10, 0), 10);
+    CHECK_EQ(std::count(seen.begin() + 10, seen.end(), 1), 100);
+    CHECK_FALSE(ranges.Next(3));
+}
+
+TEST_CASE("RegisterSweep")
+{
+    std::vector<raw_word_t> program = {
+        InstructionData::EQ, 0x8000, 0x8007, 1234,  // eq a h 1234
+        InstructionData::JF, 0x8000, 9,             // jf a 9
+        InstructionData::OUT, 'Y',                  // out 'Y'
+        InstructionData::HALT
+    };
+
+    VirtualMachine base;
+    base.LoadMemory(program);
+    base.Start();
+
+    RegisterSweep::Options options;
+    options.first = 1;
+    options.last = 5000;
+    options.num_threads = 4;
+
+    SUBCASE("Output")
+    {
+        const auto result = RegisterSweep(base, OutputContains("Y"), options).Run();
+        REQUIRE(result.value);
+        CHECK_EQ(*result.value, 1234);
+        CHECK_EQ(result.output, "Y");
+    }
+
+    SUBCASE("Register")
+    {
+        const auto result = RegisterSweep(base, RegisterEqualsAt(4, 0, 1), options).Run();
+        REQUIRE(result.value);
+        CHECK_EQ(*result.value, 1234);
+    }
+
+    SUBCASE("Not found")
+    {
+        options.last = 1000;
+        const auto result = RegisterSweep(base, OutputContains("Y"), options).Run();
+        CHECK_FALSE(result.value);
+        CHECK_EQ(result.candidates, 1000);
+    }
+}
@@ -0,0 +1,68 @@
+#include "doctest/doctest.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <sstream>
+#include <string_view>
+
+TEST_CASE("VirtualMachine::AppendScript")
+{
+    // in a; out a; jmp 0
+    const std::array<raw_word_t, 6> program = {20, 0x8000, 19, 0x8000, 6, 0};
+    const std::string_view first = "ab\nc";
+    const std::string_view second = "d\n";
+
+    std::istringstream input("e\n");
+    std::ostringstream output;
+    VirtualMachine vm;
+    vm.SetInput(input);
+    vm.SetOutput(output);
+    vm.LoadMemory(program);
+    vm.AppendScript(first);
+    vm.AppendScript(second);
+
+    SUBCASE("Halt")
+    {
+        vm.SetScriptEnd(ScriptEnd::HALT);
+        vm.Run();
+        CHECK_EQ(output.str(), "ab\nc\nd\n"); // The last line of a script gets its newline
+        CHECK_FALSE(vm.IsRunning());
+        CHECK_FALSE(vm.IsAwaitingInput());
+        CHECK_EQ(vm.instr_ptr(), Address(0));
+    }
+
+    SUBCASE("Pause")
+    {
+        vm.SetScriptEnd(ScriptEnd::PAUSE);
+        vm.Run();
+        CHECK_EQ(output.str(), "ab\nc\nd\n");
+        CHECK(vm.IsAwaitingInput());
+        CHECK_FALSE(vm.HasPendingInput());
+    }
+
+    SUBCASE("Read stream")
+    {
+        vm.SetScriptEnd(ScriptEnd::READ_STREAM);
+        vm.Start();
+        for(std::size_t i=0; i < 3 * 9; ++i) vm.Step();
+        vm.FlushOutput();
+        CHECK_EQ(output.str(), "ab\nc\nd\ne\n");
+    }
+
+    SUBCASE("Buffer next line")
+    {
+        vm.SetScriptEnd(ScriptEnd::HALT);
+        vm.PauseOnInput(true);
+        vm.Run();
+        REQUIRE(vm.IsAwaitingInput());
+        CHECK_EQ(vm.BufferNextLine(), "ab");
+        CHECK(vm.IsRunning());
+        vm.Resume();
+        CHECK_EQ(vm.BufferNextLine(), "c");
+        vm.Resume();
+        CHECK_EQ(vm.BufferNextLine(), "d");
+        vm.Resume();
+        CHECK_FALSE(vm.BufferNextLine());
+        CHECK_EQ(output.str(), "ab\nc\nd\n");
+    }
+}
@@ -0,0 +1,85 @@
+#include "doctest/doctest.h"
+#include "shared_pages.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <sstream>
+#include <string>
+#include <utility>
+
+TEST_CASE("SharedPages")
+{
+    using Pages = SharedPages<std::array<int, 4>, 3>;
+
+    Pages pages;
+    CHECK_EQ(pages.num_private_pages(), 0); // All slots point to the same blank page
+    pages.mutable_page(1)[2] = 5;
+    CHECK_EQ(pages.num_private_pages(), 1);
+
+    Pages copy = pages;
+    CHECK(copy.SharesPage(pages, 0));
+    CHECK(copy.SharesPage(pages, 1));
+    CHECK_EQ(copy.page(1)[2], 5);
+    CHECK_EQ(pages.num_private_pages(), 0);
+
+    SUBCASE("Copy on write")
+    {
+        copy.mutable_page(1)[2] = 6;
+        CHECK_FALSE(copy.SharesPage(pages, 1));
+        CHECK_EQ(pages.page(1)[2], 5);
+        CHECK_EQ(copy.page(1)[2], 6);
+        CHECK_EQ(pages.num_private_pages(), 1);
+        CHECK_EQ(copy.num_private_pages(), 1);
+    }
+
+    SUBCASE("Share")
+    {
+        copy.mutable_page(1)[2] = 6;
+        pages.Share(copy, 1);
+        CHECK(pages.SharesPage(copy, 1));
+        CHECK_EQ(pages.page(1)[2], 6);
+    }
+}
+
+TEST_CASE("VirtualMachine::Fork")
+{
+    // out 'a'; wmem 100 'b'; rmem a 100; out a; halt
+    const std::array<raw_word_t, 10> program = {19, 'a', 16, 100, 'b', 15, 0x8000, 100, 19, 0x8000};
+    std::ostringstream parent_output;
+    VirtualMachine parent;
+    parent.SetOutput(parent_output);
+    parent.LoadMemory(program);
+    parent.Start();
+    parent.Step();
+
+    VirtualMachine child = parent.Fork();
+    CHECK(child.memory().pages().SharesPage(parent.memory().pages(), 0));
+
+    std::ostringstream child_output;
+    child.SetOutput(child_output);
+    child.Resume();
+
+    CHECK_EQ(child_output.str(), "b");
+    CHECK_EQ(std::as_const(child).memory()[Address(100)].to_int(), 'b');
+    CHECK_EQ(std::as_const(parent).memory()[Address(100)].to_int(), 0);
+    CHECK_FALSE(child.memory().pages().SharesPage(parent.memory().pages(), 0));
+    CHECK(child.memory().pages().SharesPage(parent.memory().pages(), 1));
+
+    parent.Resume();
+    CHECK_EQ(parent_output.str(), "ab");
+}
+
+TEST_CASE("Memory::hex_dump stops at the end of the address space")
+{
+    // jmp 32766, where memory is zero: halt
+    const std::array<raw_word_t, 2> program = {6, 32766};
+    VirtualMachine vm;
+    vm.LoadMemory(program);
+    vm.Run();
+
+    std::ostringstream os;
+    vm.Print(os);
+    const std::string text = os.str();
+    CHECK_NE(text.find("\n7ff8:"), std::string::npos);
+    CHECK_EQ(text.find("\n8000:"), std::string::npos);
+}
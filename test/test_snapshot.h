@@ -0,0 +1,108 @@
+#include "doctest/doctest.h"
+#include "snapshot.h"
+#include "virtual_machine.h"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("Snapshot")
+{
+    std::vector<raw_word_t> program(16, 0);
+    program[0]  = InstructionData::PUSH;  // push 7
+    program[1]  = 7;
+    program[2]  = InstructionData::IN;    // in a
+    program[3]  = 0x8000;
+    program[4]  = InstructionData::OUT;   // out a
+    program[5]  = 0x8000;
+    program[6]  = InstructionData::WMEM;  // wmem 15 a
+    program[7]  = 15;
+    program[8]  = 0x8000;
+    program[9]  = InstructionData::JMP;   // jmp 2
+    program[10] = 2;
+
+    std::istringstream input("abc\n");
+    std::ostringstream output;
+    VirtualMachine vm;
+    vm.SetInput(input);
+    vm.SetOutput(output);
+    vm.LoadMemory(program);
+    vm.Start();
+    for(std::size_t i=0; i < 6; ++i) vm.Step(); // Prints 'a', then reads 'b'
+
+    std::ostringstream saved;
+    vm.SaveSnapshot(saved);
+    const std::string bytes = saved.str();
+    std::vector<std::byte> snapshot(bytes.size());
+    std::memcpy(snapshot.data(), bytes.data(), bytes.size());
+
+    SUBCASE("Resume")
+    {
+        std::istringstream no_input("");
+        std::ostringstream resumed_output;
+        VirtualMachine resumed;
+        resumed.SetInput(no_input);
+        resumed.SetOutput(resumed_output);
+        REQUIRE(resumed.LoadSnapshot(snapshot));
+
+        CHECK_EQ(resumed.instr_ptr(), vm.instr_ptr());
+        CHECK_EQ(resumed.registers()[0].to_int(), 'b');
+        CHECK_EQ(std::as_const(resumed).memory()[Address(15)].to_int(), 'a');
+        REQUIRE_EQ(resumed.stack().size(), 1);
+        CHECK_EQ(resumed.stack().top().to_int(), 7);
+
+        for(std::size_t i=0; i < 12; ++i) resumed.Step();
+        CHECK_EQ(resumed_output.str(), "bc\n");
+    }
+
+    SUBCASE("Bad version")
+    {
+        snapshot[8] = std::byte{0xFF};
+        VirtualMachine resumed;
+        CHECK_FALSE(resumed.LoadSnapshot(snapshot));
+    }
+
+    SUBCASE("Truncated")
+    {
+        snapshot.pop_back();
+        VirtualMachine resumed;
+        CHECK_FALSE(resumed.LoadSnapshot(snapshot));
+    }
+}
+
+TEST_CASE("MappedFile")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "synacor_mapped_file_test";
+    std::filesystem::create_directories(directory);
+
+    SUBCASE("Regular file")
+    {
+        const std::filesystem::path path = directory / "file";
+        std::ofstream(path, std::ios::binary) << "abc";
+        const MappedFile file(path.c_str());
+        REQUIRE(file);
+        REQUIRE_EQ(file.data().size(), 3);
+        CHECK_EQ(static_cast<char>(file.data()[2]), 'c');
+    }
+
+    SUBCASE("Empty file")
+    {
+        const std::filesystem::path path = directory / "empty";
+        std::ofstream(path, std::ios::binary).flush();
+        const MappedFile file(path.c_str());
+        CHECK(file);
+        CHECK(file.data().empty());
+    }
+
+    SUBCASE("Not a file")
+    {
+        CHECK_FALSE(MappedFile(directory.c_str()));
+        CHECK_FALSE(MappedFile((directory / "missing").c_str()));
+    }
+
+    std::filesystem::remove_all(directory);
+}
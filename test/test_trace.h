@@ -0,0 +1,76 @@
+#include "doctest/doctest.h"
+#include "snapshot.h"
+#include "trace.h"
+#include "virtual_machine.h"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+TEST_CASE("VirtualMachine::ResumeTraced")
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "synacor_trace_test.trace";
+
+    // set a 5; wmem 100 a; push a; call 11; halt; 11: ret
+    const std::array<raw_word_t, 12> program = {1, 0x8000, 5, 16, 100, 0x8000, 2, 0x8000, 17, 11, 0, 18};
+
+    VirtualMachine vm;
+    vm.LoadMemory(program);
+    vm.Start();
+    {
+        TraceWriter trace(path.string().c_str(), 64); // A tiny ring, so that the machine has to wait for the writer
+        REQUIRE(trace);
+        vm.ResumeTraced(trace);
+        trace.Close();
+        CHECK(trace);
+        CHECK_EQ(trace.size(), 6);
+    }
+    CHECK_FALSE(vm.IsRunning());
+
+    const MappedFile file(path.string().c_str());
+    REQUIRE(file);
+    const auto bytes = file.data();
+    REQUIRE_EQ(bytes.size(), sizeof(TraceHeader) + 6 * sizeof(TraceRecord));
+
+    TraceHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    header = LittleEndian(header);
+    CHECK_EQ(header.magic, TraceHeader::expected_magic);
+    CHECK_EQ(header.record_size, sizeof(TraceRecord));
+
+    std::vector<TraceRecord> records(6);
+    std::memcpy(records.data(), bytes.data() + sizeof(header), records.size() * sizeof(TraceRecord));
+    for(std::size_t i=0; i < records.size(); ++i)
+    {
+        records[i] = LittleEndian(records[i]);
+        CHECK_EQ(records[i].step, i);
+    }
+
+    CHECK_EQ(records[0].opcode, InstructionData::SET);
+    CHECK_EQ(records[0].operands[0], 0x8000);
+    CHECK_EQ(records[0].operands[1], 5);
+    CHECK_EQ(records[0].destination_kind, TraceRecord::REGISTER);
+    CHECK_EQ(records[0].destination, 0);
+    CHECK_EQ(records[0].value, 5);
+
+    CHECK_EQ(records[1].instr_ptr, 3);
+    CHECK_EQ(records[1].destination_kind, TraceRecord::MEMORY);
+    CHECK_EQ(records[1].destination, 100);
+    CHECK_EQ(records[1].value, 5);
+
+    CHECK_EQ(records[2].destination_kind, TraceRecord::STACK);
+    CHECK_EQ(records[2].value, 5);
+    CHECK_EQ(records[2].stack_size, 1);
+
+    CHECK_EQ(records[3].opcode, InstructionData::CALL);
+    CHECK_EQ(records[3].value, 10); // Return address
+    CHECK_EQ(records[3].stack_size, 2);
+
+    CHECK_EQ(records[4].opcode, InstructionData::RET);
+    CHECK_EQ(records[4].destination_kind, TraceRecord::NONE);
+    CHECK_EQ(records[5].opcode, InstructionData::HALT);
+
+    std::filesystem::remove(path);
+}
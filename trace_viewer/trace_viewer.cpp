@@ -0,0 +1,152 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string_view>
+
+#include "instruction.h"
+#include "snapshot.h"
+#include "trace.h"
+
+void Help()
+{
+    std::cout << "          SYNACOR CHALLENGE TRACE VIEWER\n";
+    std::cout << "Prints the instructions recorded by synacor_vm --trace. Pass the trace file as the last argument.\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --from STEP      First step to print (default 0)\n";
+    std::cout << "  --count N        Number of steps to print (default: all)\n";
+    std::cout << "  --address ADDR   Only print the instructions at ADDR\n";
+    std::cout << std::endl;
+}
+
+/**
+ * @brief Prints an operand as the program wrote it: a register name, or a number.
+ */
+void PrintOperand(std::ostream& os, raw_word_t const operand)
+{
+    if(operand >= Word::max_word && operand < Word::max_word + InstructionData::num_registers)
+    {
+        os << static_cast<char>('a' + (operand - Word::max_word));
+    } else {
+        os << operand;
+    }
+}
+
+void PrintRecord(std::ostream& os, TraceRecord const& record)
+{
+    const auto opcode = static_cast<InstructionData::OpCode>(record.opcode);
+
+    std::ostringstream operands;
+    for(std::size_t i=0; i < InstructionData::NumOperands(opcode); ++i)
+    {
+        if(i != 0) operands << ' ';
+        PrintOperand(operands, record.operands[i]);
+    }
+
+    os << std::setw(12) << record.step << "  " << std::hex << std::setw(4) << std::setfill('0') << record.instr_ptr
+       << std::dec << std::setfill(' ') << "  " << std::setw(12) << std::left << InstructionData::InstructionName(opcode)
+       << std::setw(20) << operands.str() << std::right;
+
+    switch(record.destination_kind)
+    {
+        case TraceRecord::NONE:     break;
+        case TraceRecord::REGISTER: os << static_cast<char>('a' + record.destination) << " = " << record.value; break;
+        case TraceRecord::MEMORY:   os << '[' << record.destination << "] = " << record.value; break;
+        case TraceRecord::STACK:    os << "push " << record.value; break;
+        case TraceRecord::FAULT:    os << "fault"; break;
+    }
+    os << "  (stack " << record.stack_size << ")\n";
+}
+
+int main(int argc, char * argv[])
+{
+    if(argc == 1)
+    {
+        Help();
+        return EXIT_SUCCESS;
+    }
+
+    std::uint64_t from = 0;
+    std::optional<std::uint64_t> count;
+    std::optional<raw_word_t> address;
+
+    const auto number = [&](int const i) {
+        char* end;
+        const unsigned long long value = std::strtoull(argv[i], &end, 0);
+        if(*end != '\0')
+        {
+            Help();
+            std::exit(EXIT_FAILURE);
+        }
+        return value;
+    };
+
+    for(int i = 1; i < argc - 1; ++i)
+    {
+        const std::string_view option = argv[i];
+        const int num_values = argc - 2 - i;
+        if(option == "--from" && num_values >= 1)
+        {
+            from = number(++i);
+            continue;
+        }
+        if(option == "--count" && num_values >= 1)
+        {
+            count = number(++i);
+            continue;
+        }
+        if(option == "--address" && num_values >= 1)
+        {
+            address = static_cast<raw_word_t>(number(++i));
+            continue;
+        }
+
+        Help();
+        return EXIT_FAILURE;
+    }
+
+    char const * const path = argv[argc - 1];
+    const MappedFile file(path);
+    if(!file)
+    {
+        std::cerr << "Failed to open " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::span<std::byte const> bytes = file.data();
+    TraceHeader header;
+    if(bytes.size() < sizeof(header))
+    {
+        std::cerr << path << " is not a trace" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    header = LittleEndian(header);
+    if(header.magic != TraceHeader::expected_magic || header.version != TraceHeader::current_version || header.record_size != sizeof(TraceRecord))
+    {
+        std::cerr << path << " is not a trace, or was written by another version" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Records are numbered from zero, one per step, so the first one to print is found directly
+    const std::span<std::byte const> records = bytes.subspan(sizeof(header));
+    const std::uint64_t num_records = records.size() / sizeof(TraceRecord);
+    std::cout << num_records << " instructions\n";
+
+    std::uint64_t printed = 0;
+    for(std::uint64_t step = from; step < num_records && (!count || printed < *count); ++step)
+    {
+        TraceRecord record;
+        std::memcpy(&record, records.data() + step * sizeof(TraceRecord), sizeof(record));
+        record = LittleEndian(record);
+        if(address && record.instr_ptr != *address) continue;
+        PrintRecord(std::cout, record);
+        ++printed;
+    }
+    std::cout << std::flush;
+    return EXIT_SUCCESS;
+}